@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    BatchMain.cpp
+    Created: 23 Oct 2026 5:18:02pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "BatchRenderer.h"
+#include "CommandLine.h"
+#include "SimdKernels.h"
+
+namespace
+{
+    const char* usage =
+        "Usage: GranSynthBatch --presets <presets.json> --output <folder> [options] <files or folders>...\n"
+        "\n"
+        "Granulates every source with every preset, one WAV per pair.\n"
+        "\n"
+        "  --seconds <n>   length of presets that don't set their own (default 10)\n"
+        "  --threads <n>   worker threads (default: one per core)\n"
+        "  --bits <n>      16, 24 or 32 bit output (default 24)\n"
+        "  --trace <file>  writes a Chrome / Perfetto trace of every render to the file\n";
+
+    // every option in the usage above but --help takes a value
+    const juce::StringArray optionsWithValues { "--presets", "--output", "--seconds", "--threads", "--bits", "--trace" };
+}
+
+int main(int argc, char* argv[])
+{
+    return juce::ConsoleApplication::invokeCatchingFailures([&]
+    {
+        juce::ArgumentList args(argc, argv);
+        if (args.size() == 0 || args.containsOption("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        BatchRenderer::Settings settings;
+        auto presetFile = args.getExistingFileForOption("--presets");
+        settings.outputFolder = args.getFileForOption("--output");
+        if (args.containsOption("--seconds"))
+            settings.defaultSeconds = juce::jmax(0.01, args.getValueForOption("--seconds").getDoubleValue());
+        if (args.containsOption("--bits"))
+            settings.bitsPerSample = args.getValueForOption("--bits").getIntValue();
+        int numThreads = args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue() : 0;
+
+        TraceRecorder tracer;
+        if (args.containsOption("--trace"))
+        {
+            auto traceFile = args.getFileForOption("--trace");
+            if (! tracer.start(traceFile))
+                juce::ConsoleApplication::fail(traceFile.getFullPathName() + ": could not be written");
+            settings.tracer = &tracer;
+        }
+
+        std::vector<BatchRenderer::Preset> presets;
+        juce::String error;
+        if (! BatchRenderer::loadPresets(presetFile, presets, error))
+            juce::ConsoleApplication::fail(error);
+
+        juce::Array<juce::File> missing;
+        auto sources = CommandLine::findAudioFiles(args, optionsWithValues, missing);
+        for (auto& file : missing)
+            std::cerr << "Skipping " << file.getFullPathName() << ": not found" << std::endl;
+        if (sources.isEmpty())
+            juce::ConsoleApplication::fail("No source files to granulate");
+
+        std::vector<BatchRenderer::Job> jobs;
+        if (! BatchRenderer::makeJobs(sources, presets, settings, jobs, error))
+            juce::ConsoleApplication::fail(error);
+
+        auto folderResult = settings.outputFolder.createDirectory();
+        if (folderResult.failed())
+            juce::ConsoleApplication::fail(settings.outputFolder.getFullPathName() + ": " + folderResult.getErrorMessage());
+
+        WorkStealingScheduler scheduler(numThreads);
+        std::cout << jobs.size() << " renders (" << sources.size() << " sources x " << presets.size()
+                  << " presets) on " << scheduler.getNumWorkers() << " threads, "
+                  << SimdKernels::get().name << " grain kernels" << std::endl;
+
+        //progress lines come from the workers, one at a time
+        juce::CriticalSection printLock;
+        int numDone = 0;
+        double audioSeconds = 0.0;
+        auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+        auto result = BatchRenderer::run(jobs, settings, scheduler, [&](const BatchRenderer::Job& job, bool succeeded)
+        {
+            const juce::ScopedLock lock(printLock);
+            numDone++;
+            if (succeeded)
+                audioSeconds += job.seconds;
+            std::cout << "[" << numDone << "/" << jobs.size() << "] " << (succeeded ? "" : "FAILED ")
+                      << job.output.getFileName() << std::endl;
+        });
+
+        double elapsed = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        std::cout << result.succeeded << " of " << jobs.size() << " rendered in " << elapsed << " s ("
+                  << audioSeconds / juce::jmax(elapsed, 0.001) << "x real time)" << std::endl;
+
+        for (auto& message : result.errors)
+            std::cerr << message << std::endl;
+
+        return result.errors.isEmpty() ? 0 : 1;
+    });
+}
@@ -0,0 +1,232 @@
+/*
+  ==============================================================================
+
+    BatchRenderer.cpp
+    Created: 23 Oct 2026 4:40:21pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "BatchRenderer.h"
+
+namespace BatchRenderer
+{
+
+bool loadPresets(const juce::File& file, std::vector<Preset>& presets, juce::String& error)
+{
+    juce::var parsed;
+    auto parseResult = juce::JSON::parse(file.loadFileAsString(), parsed);
+    if (parseResult.failed())
+    {
+        error = file.getFileName() + ": " + parseResult.getErrorMessage();
+        return false;
+    }
+
+    auto* list = parsed.getArray();
+    if (list == nullptr || list->isEmpty())
+    {
+        error = file.getFileName() + ": expected a list of presets";
+        return false;
+    }
+
+    presets.clear();
+    for (const auto& object : *list)
+    {
+        //kept inside the ranges the app's sliders allow
+        Preset preset;
+        preset.name = object.getProperty("name", "preset" + juce::String((int)presets.size() + 1)).toString();
+        preset.grainSizeMs = juce::jlimit(10.0, 1000.0, (double)object.getProperty("grainSize", preset.grainSizeMs));
+        preset.overlap = juce::jlimit(0.0, 0.99, (double)object.getProperty("overlap", preset.overlap));
+        preset.grainsPerSecond = juce::jlimit(0.1, 250.0, (double)object.getProperty("grainsPerSecond", preset.grainsPerSecond));
+        preset.pitchShiftFactor = juce::jlimit(0.1f, 2.0f, (float)object.getProperty("pitch", preset.pitchShiftFactor));
+        preset.envelope.shape = object.getProperty("envelope", "trapezoid").toString() == "hann" ? GrainEnvelope::Shape::hann
+                                                                                              : GrainEnvelope::Shape::trapezoid;
+        preset.envelope.attackPercent = juce::jlimit(0.0f, 100.0f, (float)object.getProperty("attack", preset.envelope.attackPercent));
+        preset.envelope.releasePercent = juce::jlimit(0.0f, 100.0f, (float)object.getProperty("release", preset.envelope.releasePercent));
+        preset.interpolation = object.getProperty("interpolation", "linear").toString() == "cubic" ? GrainKernels::Interpolation::cubic
+                                                                                                  : GrainKernels::Interpolation::linear;
+        preset.loop.start = juce::jlimit(0.0f, 1.0f, (float)object.getProperty("loopStart", preset.loop.start));
+        preset.loop.end = juce::jlimit(0.0f, 1.0f, (float)object.getProperty("loopEnd", preset.loop.end));
+        preset.loop.crossfadeSeconds = juce::jlimit(0.0f, 0.5f, (float)object.getProperty("loopCrossfade", preset.loop.crossfadeSeconds * 1000.0f) / 1000.0f);
+        preset.seconds = juce::jmax(0.0, (double)object.getProperty("seconds", preset.seconds));
+        presets.push_back(preset);
+    }
+
+    return true;
+}
+
+bool makeJobs(const juce::Array<juce::File>& sources, const std::vector<Preset>& presets,
+              const Settings& settings, std::vector<Job>& jobs, juce::String& error)
+{
+    //output name in lower case, as case insensitive file systems see it, to the job writing it
+    std::map<juce::String, size_t> outputs;
+
+    jobs.clear();
+    for (auto& source : sources)
+    {
+        for (auto& preset : presets)
+        {
+            Job job;
+            job.source = source;
+            job.preset = preset;
+            job.seconds = preset.seconds > 0.0 ? preset.seconds : settings.defaultSeconds;
+            auto name = juce::File::createLegalFileName(source.getFileNameWithoutExtension() + "_" + preset.name);
+            job.output = settings.outputFolder.getChildFile(name + ".wav");
+
+            auto inserted = outputs.emplace(job.output.getFileName().toLowerCase(), jobs.size());
+            if (! inserted.second)
+            {
+                const auto& other = jobs[inserted.first->second];
+                error = job.output.getFileName() + " would be written by both " + other.source.getFullPathName()
+                      + " with preset \"" + other.preset.name + "\" and " + source.getFullPathName()
+                      + " with preset \"" + preset.name + "\", rename one of them";
+                return false;
+            }
+
+            jobs.push_back(job);
+        }
+    }
+
+    return true;
+}
+
+bool render(const Job& job, SampleArena::Ptr source, const Settings& settings, juce::String& error)
+{
+    if (source == nullptr || source->getNumRegions() == 0 || source->getRegion(0).length == 0)
+    {
+        error = job.source.getFileName() + ": could not be decoded";
+        return false;
+    }
+
+    //the engine plays the source unresampled, so the output keeps its rate
+    double sampleRate = source->getRegion(0).sampleRate > 0.0 ? source->getRegion(0).sampleRate : 44100.0;
+    const auto& preset = job.preset;
+
+    GranSynth synth(source);
+    synth.prepareToPlay(sampleRate, settings.blockSize);
+    int grainSize = juce::jmax(1, (int)(preset.grainSizeMs / 1000.0 * sampleRate));
+    synth.setGrainsParams(grainSize,
+                          (int)(preset.overlap * grainSize),
+                          juce::jmax(1, (int)(sampleRate / preset.grainsPerSecond)),
+                          preset.pitchShiftFactor);
+    synth.setEnvelopeParams(preset.envelope.shape, preset.envelope.attackPercent, preset.envelope.releasePercent);
+    synth.setInterpolation(preset.interpolation);
+    synth.setLoopSeams(LoopSeams::build(source, preset.loop));
+    synth.setTracer(settings.tracer);
+    TraceRecorder::Span jobSpan(settings.tracer, "batch job", (int)(job.seconds * 1000.0));
+
+    //written next to the output and moved into place once complete, so a failed render leaves nothing behind
+    auto tempFile = job.output.withFileExtension("tmp");
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    {
+        auto stream = std::make_unique<juce::FileOutputStream>(tempFile);
+        if (! stream->openedOk())
+        {
+            error = tempFile.getFullPathName() + ": " + stream->getStatus().getErrorMessage();
+            return false;
+        }
+
+        stream->setPosition(0);
+        stream->truncate();
+
+        juce::WavAudioFormat wavFormat;
+        writer.reset(wavFormat.createWriterFor(stream.get(), sampleRate, 2, settings.bitsPerSample, {}, 0));
+        if (writer == nullptr)
+        {
+            error = job.output.getFileName() + ": no writer for " + juce::String(settings.bitsPerSample) + " bit WAV";
+            stream.reset();
+            tempFile.deleteFile();
+            return false;
+        }
+
+        stream.release(); // owned by the writer now
+    }
+
+    juce::AudioBuffer<float> block(2, settings.blockSize);
+    auto totalSamples = (juce::int64)(job.seconds * sampleRate);
+    for (juce::int64 done = 0; done < totalSamples;)
+    {
+        int numSamples = (int)juce::jmin((juce::int64)settings.blockSize, totalSamples - done);
+        TraceRecorder::Span blockSpan(settings.tracer, "batch block", numSamples);
+        block.setSize(2, numSamples, false, false, true);
+        block.clear();
+        synth.processBlock(block);
+
+        if (! writer->writeFromAudioSampleBuffer(block, 0, numSamples))
+        {
+            error = job.output.getFileName() + ": write failed";
+            writer.reset();
+            tempFile.deleteFile();
+            return false;
+        }
+
+        done += numSamples;
+    }
+
+    //the writer finishes the header when it goes
+    writer.reset();
+    if (! tempFile.moveFileTo(job.output))
+    {
+        error = job.output.getFullPathName() + ": could not be replaced";
+        tempFile.deleteFile();
+        return false;
+    }
+
+    return true;
+}
+
+Result run(const std::vector<Job>& jobs, const Settings& settings, WorkStealingScheduler& scheduler,
+           std::function<void(const Job&, bool succeeded)> onJobDone)
+{
+    Result result;
+    juce::CriticalSection resultLock;
+
+    //jobs grouped by source, in the order they first appear
+    juce::StringArray sourcePaths;
+    std::vector<std::vector<size_t>> jobsBySource;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        auto path = jobs[i].source.getFullPathName();
+        int sourceIndex = sourcePaths.indexOf(path);
+        if (sourceIndex < 0)
+        {
+            sourceIndex = sourcePaths.size();
+            sourcePaths.add(path);
+            jobsBySource.emplace_back();
+        }
+        jobsBySource[(size_t)sourceIndex].push_back(i);
+    }
+
+    //every source is decoded once; its renders are queued by the worker that decoded it and stolen by the idle ones
+    for (auto& sourceJobs : jobsBySource)
+    {
+        scheduler.submit([&, sourceJobs]
+        {
+            auto arena = SampleArena::loadFiles({ jobs[sourceJobs.front()].source });
+            for (auto jobIndex : sourceJobs)
+            {
+                scheduler.submit([&, arena, jobIndex]
+                {
+                    juce::String error;
+                    bool succeeded = render(jobs[jobIndex], arena, settings, error);
+                    {
+                        const juce::ScopedLock lock(resultLock);
+                        if (succeeded)
+                            result.succeeded++;
+                        else
+                            result.errors.add(error);
+                    }
+
+                    if (onJobDone != nullptr)
+                        onJobDone(jobs[jobIndex], succeeded);
+                });
+            }
+        });
+    }
+
+    scheduler.waitUntilDone();
+    return result;
+}
+
+}
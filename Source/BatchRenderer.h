@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    BatchRenderer.h
+    Created: 23 Oct 2026 4:40:21pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "GranSynth.h"
+#include "WorkStealingScheduler.h"
+
+
+// Offline granulation of many source files with many presets, for building
+// sound design libraries without the app. Every file is decoded once by one
+// task, which then submits a render task per preset; renders stream straight
+// to disk a block at a time, so memory stays flat however long the outputs.
+namespace BatchRenderer
+{
+    // The same controls as the standalone app, in the same units
+    struct Preset
+    {
+        juce::String name;
+        double grainSizeMs = 100.0;
+        double overlap = 0.0;      // fraction of the grain size
+        double grainsPerSecond = 25.0;
+        float pitchShiftFactor = 1.0f;
+        GrainEnvelope::Parameters envelope;
+        GrainKernels::Interpolation interpolation = GrainKernels::Interpolation::linear;
+        LoopSeams::Settings loop;  // the whole file with a short crossfade unless the preset narrows it
+        double seconds = 0.0;      // 0 uses the batch's default length
+    };
+
+    struct Settings
+    {
+        juce::File outputFolder;
+        double defaultSeconds = 10.0;
+        int blockSize = 512;
+        int bitsPerSample = 24;
+        TraceRecorder* tracer = nullptr; // records every job's blocks when set
+    };
+
+    // One output file: a source, a preset and a length
+    struct Job
+    {
+        juce::File source;
+        Preset preset;
+        double seconds = 0.0;
+        juce::File output;
+    };
+
+    // Reads an array of preset objects, e.g. [{ "name": "cloud", "grainSize": 80, "overlap": 0.5 }].
+    // Missing fields keep their defaults; returns false with a message if the file can't be used.
+    bool loadPresets(const juce::File& file, std::vector<Preset>& presets, juce::String& error);
+
+    // Every source x preset, named <source>_<preset>.wav in the output folder. Returns false with a
+    // message if two jobs would write the same file, e.g. two sources with the same name in different
+    // folders or two presets with the same name, rather than letting one render overwrite the other.
+    bool makeJobs(const juce::Array<juce::File>& sources, const std::vector<Preset>& presets,
+                  const Settings& settings, std::vector<Job>& jobs, juce::String& error);
+
+    // Renders one job from an already decoded source, writing through a temporary file
+    bool render(const Job& job, SampleArena::Ptr source, const Settings& settings, juce::String& error);
+
+    struct Result
+    {
+        int succeeded = 0;
+        juce::StringArray errors;
+    };
+
+    // Runs every job on the scheduler and waits for them all. onJobDone is
+    // called from the worker threads as each output is finished.
+    Result run(const std::vector<Job>& jobs, const Settings& settings, WorkStealingScheduler& scheduler,
+               std::function<void(const Job&, bool succeeded)> onJobDone = {});
+}
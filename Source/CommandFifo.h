@@ -0,0 +1,51 @@
+/*
+  ==============================================================================
+
+    CommandFifo.h
+    Created: 23 Oct 2026 2:36:10pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Fixed size single producer / single consumer queue of plain command values.
+// The message thread pushes, the audio thread drains everything queued at the
+// top of each block, so engine state is only ever changed between renders and
+// the callback takes no locks. Anything that owns memory travels as a pointer
+// and ownership goes with the command.
+template <typename Command, int capacity>
+class CommandFifo
+{
+public:
+
+    // Producer side, returns false and drops the command when the queue is full
+    bool push(const Command& command) noexcept
+    {
+        const auto scope = fifo.write(1);
+        if (scope.blockSize1 == 0)
+            return false;
+
+        commands[(size_t)scope.startIndex1] = command;
+        return true;
+    }
+
+    // Consumer side, hands every queued command to the handler in the order it was pushed
+    template <typename Handler>
+    void drain(Handler&& handler)
+    {
+        const auto scope = fifo.read(fifo.getNumReady());
+        for (int i = 0; i < scope.blockSize1; i++)
+            handler(commands[(size_t)(scope.startIndex1 + i)]);
+        for (int i = 0; i < scope.blockSize2; i++)
+            handler(commands[(size_t)(scope.startIndex2 + i)]);
+    }
+
+private:
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<Command, capacity> commands {};
+};
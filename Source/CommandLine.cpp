@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    CommandLine.cpp
+    Created: 26 Oct 2026 3:41:27pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "CommandLine.h"
+#include "SampleArena.h"
+
+juce::Array<juce::File> CommandLine::findAudioFiles(const juce::ArgumentList& args, const juce::StringArray& optionsWithValues,
+                                                    juce::Array<juce::File>& missing)
+{
+    juce::Array<juce::File> files;
+    for (int i = 0; i < args.size(); i++)
+    {
+        const auto& argument = args[i];
+        if (argument.isOption())
+        {
+            //a value given with = is part of the option, otherwise it is the next argument
+            if (! argument.text.contains("=") && optionsWithValues.contains(argument.text))
+                i++;
+            continue;
+        }
+
+        auto file = argument.resolveAsFile();
+        if (file.isDirectory())
+            files.addArray(SampleArena::findAudioFiles(file));
+        else if (file.existsAsFile())
+            files.add(file);
+        else
+            missing.add(file);
+    }
+
+    return files;
+}
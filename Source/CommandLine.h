@@ -0,0 +1,23 @@
+/*
+  ==============================================================================
+
+    CommandLine.h
+    Created: 26 Oct 2026 3:41:27pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Argument handling shared by the console tools
+namespace CommandLine
+{
+    // The files a command line names, folders expanded to the audio files directly inside them.
+    // Only the options in optionsWithValues take one, as --option=value or as the next argument;
+    // every other option is a flag. Paths that don't exist go to missing
+    juce::Array<juce::File> findAudioFiles(const juce::ArgumentList& args, const juce::StringArray& optionsWithValues,
+                                           juce::Array<juce::File>& missing);
+}
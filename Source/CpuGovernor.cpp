@@ -0,0 +1,119 @@
+/*
+  ==============================================================================
+
+    CpuGovernor.cpp
+    Created: 22 Oct 2026 3:27:51pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "CpuGovernor.h"
+
+void CpuGovernor::prepare(double newSampleRate, int newMaximumVoices)
+{
+    sampleRate = newSampleRate;
+    maximumVoices = juce::jmax(1, newMaximumVoices);
+    load = 0.0f;
+    reset();
+}
+
+void CpuGovernor::setMode(Mode newMode) noexcept
+{
+    if (newMode == mode)
+        return;
+
+    mode = newMode;
+    reset();
+}
+
+void CpuGovernor::reset() noexcept
+{
+    grainCap = unlimited;
+    voiceCap = maximumVoices;
+    linearInterpolation = false;
+    cooldown = 0;
+    calmBlocks = 0;
+}
+
+void CpuGovernor::beginBlock() noexcept
+{
+    blockStartTicks = juce::Time::getHighResolutionTicks();
+}
+
+void CpuGovernor::endBlock(int numSamples, int activeGrains) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - blockStartTicks);
+    auto blockLoad = (float)(elapsed * sampleRate / numSamples);
+
+    //rises quickly so an overload is caught within a block or two, falls slowly so one light block proves nothing
+    float smoothed = load;
+    smoothed += (blockLoad - smoothed) * (blockLoad > smoothed ? 0.5f : 0.05f);
+    load = smoothed;
+
+    if (mode == Mode::off)
+        return;
+
+    if (cooldown > 0)
+        cooldown--;
+
+    if (smoothed > highLoad || blockLoad > 1.0f)
+    {
+        calmBlocks = 0;
+        if (cooldown == 0)
+        {
+            stepDown(activeGrains);
+            cooldown = cooldownBlocks;
+        }
+
+        //a missed deadline is already audible, no new voices until things settle
+        if (blockLoad > 1.0f)
+            voiceCap = juce::jmax(1, voiceCap - 1);
+    }
+    else if (smoothed < lowLoad)
+    {
+        if (++calmBlocks >= recoveryBlocks)
+        {
+            stepUp(activeGrains);
+            calmBlocks = 0;
+        }
+    }
+    else
+    {
+        calmBlocks = 0;
+    }
+}
+
+void CpuGovernor::stepDown(int activeGrains) noexcept
+{
+    if (mode == Mode::grainsAndInterpolation && ! linearInterpolation)
+    {
+        linearInterpolation = true;
+        return;
+    }
+
+    grainCap = juce::jmax(minimumGrains, juce::jmin(grainCap, activeGrains) * 3 / 4);
+}
+
+void CpuGovernor::stepUp(int activeGrains) noexcept
+{
+    //undo in reverse order: voices, then grains, then interpolation
+    if (voiceCap < maximumVoices)
+    {
+        voiceCap++;
+    }
+    else if (grainCap != unlimited)
+    {
+        //once the cap is well clear of what is playing it no longer limits anything
+        grainCap += juce::jmax(1, grainCap / 8);
+        if (grainCap >= 2 * juce::jmax(minimumGrains, activeGrains))
+            grainCap = unlimited;
+    }
+    else
+    {
+        linearInterpolation = false;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    CpuGovernor.h
+    Created: 22 Oct 2026 3:27:51pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Keeps rendering inside its share of the block deadline. The time taken by
+// each block is smoothed into a load figure; above the high mark the governor
+// steps down at once, below the low mark it waits a while before stepping back
+// up, one notch at a time. Stepping down first drops to linear interpolation
+// if allowed, then caps the number of concurrent grains, and turns away new
+// voices once a deadline is actually missed.
+class CpuGovernor
+{
+public:
+
+    enum class Mode
+    {
+        off = 0,
+        grains,               // only thin the cloud
+        grainsAndInterpolation // fall back to linear interpolation first
+    };
+
+    static constexpr int unlimited = std::numeric_limits<int>::max();
+
+    void prepare(double sampleRate, int maximumVoices);
+    void setMode(Mode newMode) noexcept;
+
+    // Brackets the rendering of one block on the audio thread
+    void beginBlock() noexcept;
+    void endBlock(int numSamples, int activeGrains) noexcept;
+
+    int getGrainCap() const noexcept { return grainCap; }
+    int getVoiceCap() const noexcept { return voiceCap; }
+    bool shouldUseLinearInterpolation() const noexcept { return linearInterpolation; }
+
+    // Smoothed render time as a fraction of the block's duration
+    float getLoad() const noexcept { return load; }
+
+private:
+
+    void stepDown(int activeGrains) noexcept;
+    void stepUp(int activeGrains) noexcept;
+    void reset() noexcept;
+
+    static constexpr float highLoad = 0.7f;
+    static constexpr float lowLoad = 0.4f;
+    static constexpr int cooldownBlocks = 8;   // lets a cut show up in the measurement before the next one
+    static constexpr int recoveryBlocks = 64;  // calm blocks needed for each step back up
+    static constexpr int minimumGrains = 4;
+
+    Mode mode = Mode::grains;
+    double sampleRate = 44100.0;
+    int maximumVoices = 1;
+    juce::int64 blockStartTicks = 0;
+    std::atomic<float> load { 0.0f };
+    int grainCap = unlimited;
+    int voiceCap = 1;
+    bool linearInterpolation = false;
+    int cooldown = 0;
+    int calmBlocks = 0;
+};
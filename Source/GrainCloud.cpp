@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    GrainCloud.cpp
+    Created: 24 Oct 2026 3:47:52pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "GrainCloud.h"
+#include "GrainKernels.h"
+
+void GrainCloud::reserve(int newCapacity)
+{
+    //thirteen arrays cut from one block, each one a whole number of cache lines
+    capacity = (juce::jmax(1, newCapacity) + laneWidth - 1) / laneWidth * laneWidth;
+    size_t arrayBytes = (size_t)capacity * sizeof(float);
+    storage.allocate(arrayBytes * 13 + 64, true);
+
+    auto address = reinterpret_cast<juce::pointer_sized_uint>(storage.get());
+    char* next = storage.get() + ((64 - address % 64) % 64);
+    auto take = [&](auto*& array)
+    {
+        array = reinterpret_cast<std::remove_reference_t<decltype(array)>>(next);
+        next += arrayBytes;
+    };
+
+    take(lanes.index);
+    take(lanes.fraction);
+    take(lanes.step);
+    take(lanes.stepFraction);
+    take(lanes.attack);
+    take(lanes.attackSlope);
+    take(lanes.release);
+    take(lanes.releaseSlope);
+    take(lanes.gainLeft);
+    take(lanes.gainRight);
+    take(lanes.gainMono);
+    take(lanes.delay);
+    take(lanes.remaining);
+    numGrains = 0;
+}
+
+void GrainCloud::clear() noexcept
+{
+    //padding lanes have to stay silent, so the cleared ones are zeroed rather than just forgotten
+    int used = (numGrains + laneWidth - 1) / laneWidth * laneWidth;
+    std::fill(lanes.delay, lanes.delay + used, 0);
+    std::fill(lanes.remaining, lanes.remaining + used, 0);
+    numGrains = 0;
+}
+
+bool GrainCloud::add(int sourceIndex, int length, float pitch, const GrainEnvelope::Parameters& envelopeParams,
+                     int startDelay, float pan, float level) noexcept
+{
+    if (numGrains >= capacity || length <= 0)
+        return false;
+
+    int g = numGrains++;
+    shape = envelopeParams.shape;
+    lanes.index[g] = sourceIndex;
+    lanes.fraction[g] = 0.0f;
+    lanes.step[g] = (int)pitch;
+    lanes.stepFraction[g] = pitch - (float)(int)pitch;
+    float gains[2];
+    GrainKernels::setChannelGains(gains, pan, level); //the same gains as a Grain
+    lanes.gainLeft[g] = gains[0];
+    lanes.gainRight[g] = gains[1];
+    lanes.gainMono[g] = GrainKernels::getMonoGain(gains);
+    lanes.delay[g] = startDelay;
+    lanes.remaining[g] = length;
+
+    if (shape == GrainEnvelope::Shape::hann)
+    {
+        //sin^2 over the grain, a one-sample grain stays at the silent edge like GrainEnvelope's
+        lanes.attack[g] = -0.5f;
+        lanes.attackSlope[g] = length > 1 ? 1.0f / (float)(length - 1) : 0.0f;
+        lanes.release[g] = 0.0f;
+        lanes.releaseSlope[g] = 0.0f;
+        return true;
+    }
+
+    //the trapezoid is the lower of a rising and a falling ramp, capped at 1
+    int attackSamples = 0, releaseSamples = 0;
+    GrainEnvelope::getTrapezoidLengths(envelopeParams, length, attackSamples, releaseSamples);
+    lanes.attack[g] = attackSamples > 0 ? 0.0f : 1.0f;
+    lanes.attackSlope[g] = attackSamples > 0 ? 1.0f / (float)attackSamples : 0.0f;
+    lanes.release[g] = releaseSamples > 0 ? (float)length / (float)releaseSamples : 1.0f;
+    lanes.releaseSlope[g] = releaseSamples > 0 ? -1.0f / (float)releaseSamples : 0.0f;
+    return true;
+}
+
+void GrainCloud::render(const float* source, juce::AudioBuffer<float>& output, int numSamples) noexcept
+{
+    if (numGrains == 0 || numSamples <= 0)
+        return;
+
+    //mono output takes the same level as every other grain path, not the left channel's
+    float* right = output.getNumChannels() > 1 ? output.getWritePointer(1) : nullptr;
+    auto renderedLanes = lanes;
+    if (right == nullptr)
+        renderedLanes.gainLeft = lanes.gainMono;
+    SimdKernels::get().renderLanes(source, renderedLanes, numGrains, shape == GrainEnvelope::Shape::hann,
+                                   output.getWritePointer(0), right, numSamples);
+
+    //finished grains are squeezed out, the rest keep their order
+    int kept = 0;
+    for (int g = 0; g < numGrains; g++)
+    {
+        if (lanes.remaining[g] <= 0)
+            continue;
+
+        if (kept != g)
+        {
+            lanes.index[kept] = lanes.index[g];
+            lanes.fraction[kept] = lanes.fraction[g];
+            lanes.step[kept] = lanes.step[g];
+            lanes.stepFraction[kept] = lanes.stepFraction[g];
+            lanes.attack[kept] = lanes.attack[g];
+            lanes.attackSlope[kept] = lanes.attackSlope[g];
+            lanes.release[kept] = lanes.release[g];
+            lanes.releaseSlope[kept] = lanes.releaseSlope[g];
+            lanes.gainLeft[kept] = lanes.gainLeft[g];
+            lanes.gainRight[kept] = lanes.gainRight[g];
+            lanes.gainMono[kept] = lanes.gainMono[g];
+            lanes.delay[kept] = lanes.delay[g];
+            lanes.remaining[kept] = lanes.remaining[g];
+        }
+        kept++;
+    }
+
+    for (int g = kept; g < numGrains; g++)
+    {
+        lanes.delay[g] = 0;
+        lanes.remaining[g] = 0;
+    }
+    numGrains = kept;
+}
+
+int GrainCloud::getGrainPositions(int* positions, int maxPositions) const noexcept
+{
+    int numPositions = 0;
+    for (int g = 0; g < numGrains && numPositions < maxPositions; g++)
+        if (lanes.delay[g] <= 0)
+            positions[numPositions++] = lanes.index[g];
+    return numPositions;
+}
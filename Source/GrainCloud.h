@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    GrainCloud.h
+    Created: 24 Oct 2026 3:47:52pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "GrainEnvelope.h"
+#include "SimdKernels.h"
+
+
+// Short grains kept as a structure of arrays for dense clouds. A Grain is
+// rendered a span at a time; the cloud advances all of its grains together,
+// one output sample at a time, 8 or 16 grains per instruction, which is
+// faster once many short grains overlap. It takes float32 file grains with
+// linear interpolation, all read from one arena and all with one envelope
+// shape; anything else stays a Grain.
+class GrainCloud
+{
+public:
+
+    // Grains longer than this are cheaper to render as spans
+    static constexpr int maxGrainLength = 2048;
+    // Grains already sounding in a voice before new short ones join the cloud
+    static constexpr int minDensity = 16;
+
+    // Allocates room for this many grains, none are ever added past it
+    void reserve(int capacity);
+    // Drops every grain
+    void clear() noexcept;
+
+    // Whether a grain with this envelope could join the grains already here
+    bool accepts(GrainEnvelope::Shape newShape) const noexcept { return numGrains == 0 || newShape == shape; }
+
+    // Adds a grain reading the arena's float samples from sourceIndex on, for
+    // length output samples; the caller keeps the whole read inside the file.
+    // Returns false when every slot is taken.
+    bool add(int sourceIndex, int length, float pitch, const GrainEnvelope::Parameters& envelopeParams,
+             int startDelay, float pan, float level = 1.0f) noexcept;
+
+    // Adds the next numSamples of every grain to the first one or two channels
+    // of the buffer, then drops the grains that have finished
+    void render(const float* source, juce::AudioBuffer<float>& output, int numSamples) noexcept;
+
+    int getNumGrains() const noexcept { return numGrains; }
+    // Arena positions of the grains already sounding, returns how many were written
+    int getGrainPositions(int* positions, int maxPositions) const noexcept;
+
+private:
+
+    static constexpr int laneWidth = 16; // the widest vector the kernels use
+
+    juce::HeapBlock<char> storage;
+    SimdKernels::GrainLanes lanes;
+    int capacity = 0;
+    int numGrains = 0;
+    GrainEnvelope::Shape shape = GrainEnvelope::Shape::trapezoid;
+};
@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    GrainCorpus.cpp
+    Created: 20 Oct 2026 9:48:30am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "GrainCorpus.h"
+
+static float frequencyToNote(float frequency)
+{
+    return 69.0f + 12.0f * std::log2(frequency / 440.0f);
+}
+
+GrainCorpus::Target GrainCorpus::Target::fromNote(float midiNote, float velocity)
+{
+    Target target;
+    target.features[pitch] = midiNote / 127.0f;
+    target.features[loudness] = velocity;
+    target.features[brightness] = (48.0f + 60.0f * velocity) / 127.0f;
+    target.features[noisiness] = 0.0f;
+    return target;
+}
+
+GrainCorpus::Ptr GrainCorpus::build(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    return build(buffer.getNumChannels() > 0 ? buffer.getReadPointer(0) : nullptr,
+                 buffer.getNumChannels() > 0 ? buffer.getNumSamples() : 0, sampleRate);
+}
+
+GrainCorpus::Ptr GrainCorpus::build(const float* data, int numSamples, double sampleRate)
+{
+    GrainCorpus::Ptr corpus = new GrainCorpus();
+    corpus->analyse([data](int position, int count, float* dest) { std::copy(data + position, data + position + count, dest); },
+                    0, numSamples, sampleRate);
+    corpus->finish();
+    return corpus;
+}
+
+GrainCorpus::Ptr GrainCorpus::build(const SampleArena& arena)
+{
+    GrainCorpus::Ptr corpus = new GrainCorpus();
+    auto read = [&arena](int position, int count, float* dest) { arena.readSamples(dest, position, count); };
+    for (int r = 0; r < arena.getNumRegions(); r++)
+    {
+        const auto& region = arena.getRegion(r);
+        corpus->analyse(read, region.offset, region.length, region.sampleRate);
+    }
+    corpus->finish();
+    return corpus;
+}
+
+void GrainCorpus::finish()
+{
+    splitAxes.resize(frames.size());
+    buildTree(0, (int)frames.size());
+}
+
+void GrainCorpus::analyse(const Reader& read, int start, int numSamples, double sampleRate)
+{
+    if (numSamples <= 0 || sampleRate <= 0)
+        return;
+
+    //autocorrelation is taken from a zero padded transform so it does not wrap
+    juce::dsp::FFT spectrumFft(frameOrder);
+    juce::dsp::FFT correlationFft(frameOrder + 1);
+    juce::dsp::WindowingFunction<float> window((size_t)frameSize, juce::dsp::WindowingFunction<float>::hann, false);
+
+    std::vector<float> spectrum((size_t)frameSize * 2);
+    std::vector<float> correlation((size_t)frameSize * 4);
+
+    const int numBins = frameSize / 2;
+    const float binWidth = (float)(sampleRate / frameSize);
+    const int minLag = (int)(sampleRate / 1000.0);  //pitch range 1 kHz..
+    const int maxLag = (int)(sampleRate / 50.0);    //..50 Hz
+
+    std::vector<float> frameSamples((size_t)frameSize);
+    for (int frameStart = 0; frameStart + frameSize <= numSamples; frameStart += hopSize)
+    {
+        read(start + frameStart, frameSize, frameSamples.data());
+        auto frameData = frameSamples.data();
+
+        float sumSquares = 0.0f;
+        for (int i = 0; i < frameSize; i++)
+            sumSquares += frameData[i] * frameData[i];
+
+        float decibels = 10.0f * std::log10(sumSquares / frameSize + 1.0e-12f);
+        if (decibels < -60.0f)
+            continue; //silence never makes a useful grain
+
+        //centroid and flatness from the magnitude spectrum
+        std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+        std::copy(frameData, frameData + frameSize, spectrum.begin());
+        window.multiplyWithWindowingTable(spectrum.data(), (size_t)frameSize);
+        spectrumFft.performFrequencyOnlyForwardTransform(spectrum.data(), true);
+
+        double weightedSum = 0.0, magnitudeSum = 0.0, logSum = 0.0;
+        for (int bin = 1; bin < numBins; bin++)
+        {
+            double magnitude = spectrum[(size_t)bin] + 1.0e-9;
+            weightedSum += magnitude * bin * binWidth;
+            magnitudeSum += magnitude;
+            logSum += std::log(magnitude);
+        }
+        float centroid = (float)(weightedSum / magnitudeSum);
+        float flatness = (float)(std::exp(logSum / (numBins - 1)) / (magnitudeSum / (numBins - 1)));
+
+        //pitch from the strongest autocorrelation peak in range
+        std::fill(correlation.begin(), correlation.end(), 0.0f);
+        std::copy(frameData, frameData + frameSize, correlation.begin());
+        correlationFft.performRealOnlyForwardTransform(correlation.data(), true);
+        for (size_t bin = 0; bin < correlation.size(); bin += 2)
+        {
+            correlation[bin] = correlation[bin] * correlation[bin] + correlation[bin + 1] * correlation[bin + 1];
+            correlation[bin + 1] = 0.0f;
+        }
+        correlationFft.performRealOnlyInverseTransform(correlation.data());
+
+        float note = -1.0f;
+        int bestLag = 0;
+        for (int lag = minLag; lag <= juce::jmin(maxLag, frameSize - 2); lag++)
+        {
+            if (correlation[(size_t)lag] > correlation[(size_t)lag - 1] && correlation[(size_t)lag] >= correlation[(size_t)lag + 1]
+                && (bestLag == 0 || correlation[(size_t)lag] > correlation[(size_t)bestLag]))
+                bestLag = lag;
+        }
+        if (bestLag > 0 && correlation[(size_t)bestLag] > 0.5f * correlation[0])
+        {
+            //parabolic interpolation around the peak
+            float left = correlation[(size_t)bestLag - 1], centre = correlation[(size_t)bestLag], right = correlation[(size_t)bestLag + 1];
+            float denominator = left - 2.0f * centre + right;
+            float offset = denominator != 0.0f ? 0.5f * (left - right) / denominator : 0.0f;
+            note = frequencyToNote((float)(sampleRate / (bestLag + offset)));
+        }
+
+        Frame frame;
+        frame.startSample = start + frameStart;
+        frame.note = note;
+        float centroidNote = frequencyToNote(juce::jmax(centroid, 8.0f));
+        frame.features[pitch] = (note >= 0.0f ? note : centroidNote) / 127.0f;
+        frame.features[loudness] = juce::jlimit(0.0f, 1.0f, (decibels + 60.0f) / 60.0f);
+        frame.features[brightness] = centroidNote / 127.0f;
+        frame.features[noisiness] = flatness;
+        frames.push_back(frame);
+    }
+}
+
+void GrainCorpus::buildTree(int begin, int end)
+{
+    if (end - begin <= 1)
+        return;
+
+    //split on the feature that varies most in this range
+    int axis = 0;
+    float widestSpread = -1.0f;
+    for (int f = 0; f < numFeatures; f++)
+    {
+        auto range = std::minmax_element(frames.begin() + begin, frames.begin() + end,
+                                         [f](const Frame& a, const Frame& b) { return a.features[f] < b.features[f]; });
+        float spread = range.second->features[f] - range.first->features[f];
+        if (spread > widestSpread)
+        {
+            widestSpread = spread;
+            axis = f;
+        }
+    }
+
+    int middle = (begin + end) / 2;
+    std::nth_element(frames.begin() + begin, frames.begin() + middle, frames.begin() + end,
+                     [axis](const Frame& a, const Frame& b) { return a.features[axis] < b.features[axis]; });
+    splitAxes[(size_t)middle] = (juce::uint8)axis;
+
+    buildTree(begin, middle);
+    buildTree(middle + 1, end);
+}
+
+void GrainCorpus::findNearest(const Target& target, Matches& matches) const noexcept
+{
+    float distances[maxMatches];
+    matches.size = 0;
+    search(0, (int)frames.size(), target, matches, distances);
+}
+
+void GrainCorpus::search(int begin, int end, const Target& target, Matches& matches, float* distances) const noexcept
+{
+    if (begin >= end)
+        return;
+
+    int middle = (begin + end) / 2;
+    const auto& frame = frames[(size_t)middle];
+
+    float distance = 0.0f;
+    for (int f = 0; f < numFeatures; f++)
+        distance += target.weights[f] * juce::square(target.features[f] - frame.features[f]);
+
+    //insertion into the sorted match list
+    if (matches.size < maxMatches || distance < distances[matches.size - 1])
+    {
+        int slot = juce::jmin(matches.size, maxMatches - 1);
+        while (slot > 0 && distances[slot - 1] > distance)
+        {
+            distances[slot] = distances[slot - 1];
+            matches.startSamples[slot] = matches.startSamples[slot - 1];
+            matches.pitchRatios[slot] = matches.pitchRatios[slot - 1];
+            slot--;
+        }
+        distances[slot] = distance;
+        matches.startSamples[slot] = frame.startSample;
+        matches.pitchRatios[slot] = frame.note < 0.0f ? 1.0f
+            : juce::jlimit(0.5f, 2.0f, std::exp2((target.features[pitch] * 127.0f - frame.note) / 12.0f));
+        matches.size = juce::jmin(matches.size + 1, maxMatches);
+    }
+
+    if (end - begin == 1)
+        return;
+
+    int axis = splitAxes[(size_t)middle];
+    float difference = target.features[axis] - frame.features[axis];
+    bool goLeft = difference < 0.0f;
+
+    search(goLeft ? begin : middle + 1, goLeft ? middle : end, target, matches, distances);
+
+    //the far side can only hold closer frames if the splitting plane is nearer than the worst match
+    if (matches.size < maxMatches || target.weights[axis] * difference * difference < distances[matches.size - 1])
+        search(goLeft ? middle + 1 : begin, goLeft ? end : middle, target, matches, distances);
+}
+
+void GrainCorpus::writeTo(juce::OutputStream& stream) const
+{
+    stream.writeInt((int)frames.size());
+    stream.write(frames.data(), frames.size() * sizeof(Frame));
+    stream.write(splitAxes.data(), splitAxes.size());
+}
+
+GrainCorpus::Ptr GrainCorpus::readFrom(juce::InputStream& stream, int totalSize)
+{
+    int numFrames = stream.readInt();
+    if (numFrames < 0 || (juce::int64)numFrames * (juce::int64)(sizeof(Frame) + 1) > stream.getNumBytesRemaining())
+        return nullptr;
+
+    //the tree is stored already built
+    GrainCorpus::Ptr corpus = new GrainCorpus();
+    corpus->frames.resize((size_t)numFrames);
+    corpus->splitAxes.resize((size_t)numFrames);
+    stream.read(corpus->frames.data(), numFrames * (int)sizeof(Frame));
+    stream.read(corpus->splitAxes.data(), numFrames);
+
+    for (auto axis : corpus->splitAxes)
+        if (axis >= numFeatures)
+            return nullptr;
+
+    for (auto& frame : corpus->frames)
+        if (! juce::isPositiveAndNotGreaterThan(frame.startSample, totalSize - frameSize))
+            return nullptr;
+
+    return corpus;
+}
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    GrainCorpus.h
+    Created: 20 Oct 2026 9:48:30am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+
+
+// A loaded file cut into analysed frames and stored in a KD-tree, so grains
+// can be chosen by what they sound like instead of where they are in the file.
+// Built off the audio thread; lookups are allocation free.
+class GrainCorpus : public juce::ReferenceCountedObject
+{
+public:
+
+    using Ptr = juce::ReferenceCountedObjectPtr<GrainCorpus>;
+
+    enum Feature
+    {
+        pitch = 0,  // midi note / 127, the spectral centroid's note for unpitched frames
+        loudness,   // -60..0 dB mapped to 0..1
+        brightness, // spectral centroid as midi note / 127
+        noisiness,  // spectral flatness
+        numFeatures
+    };
+
+    struct Target
+    {
+        float features[numFeatures] = {};
+        float weights[numFeatures] = { 1.0f, 0.5f, 0.1f, 0.1f };
+
+        // Pitch follows the note, loudness and brightness follow the velocity, tonal frames preferred
+        static Target fromNote(float midiNote, float velocity);
+    };
+
+    static constexpr int maxMatches = 8;
+
+    struct Matches
+    {
+        int startSamples[maxMatches];
+        float pitchRatios[maxMatches]; // playback rate that moves each frame's pitch onto the target
+        int size = 0;
+    };
+
+    static Ptr build(const juce::AudioBuffer<float>& buffer, double sampleRate);
+    static Ptr build(const float* data, int numSamples, double sampleRate);
+    // Every file of the arena at its own sample rate, no frame straddles two files; reads it
+    // a frame at a time, whatever its format, without a float copy of it
+    static Ptr build(const SampleArena& arena);
+
+    // The closest frames to the target, nearest first
+    void findNearest(const Target& target, Matches& matches) const noexcept;
+
+    int getNumFrames() const noexcept { return (int)frames.size(); }
+    int getFrameSize() const noexcept { return frameSize; }
+
+    // Native byte order, for the on-disk cache only; readFrom returns nullptr if the data is cut short
+    // or a frame does not lie inside an arena of totalSize samples
+    void writeTo(juce::OutputStream& stream) const;
+    static Ptr readFrom(juce::InputStream& stream, int totalSize);
+
+private:
+
+    struct Frame
+    {
+        int startSample;
+        float note; // detected pitch, or -1 if unpitched
+        float features[numFeatures];
+    };
+
+    // Widens count samples from position on into dest
+    using Reader = std::function<void(int position, int count, float* dest)>;
+
+    void analyse(const Reader& read, int start, int numSamples, double sampleRate);
+    void finish();
+    void buildTree(int begin, int end);
+    void search(int begin, int end, const Target& target, Matches& matches, float* distances) const noexcept;
+
+    static constexpr int frameOrder = 11;
+    static constexpr int frameSize = 1 << frameOrder;
+    static constexpr int hopSize = frameSize / 2;
+
+    std::vector<Frame> frames; // reordered so every range's middle element splits it
+    std::vector<juce::uint8> splitAxes;
+};
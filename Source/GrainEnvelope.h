@@ -0,0 +1,140 @@
+/*
+  ==============================================================================
+
+    GrainEnvelope.h
+    Created: 19 Oct 2026 10:12:05am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Envelope generator that advances one sample at a time while the grain is
+// rendered, so grains never need a windowed copy of their audio.
+class GrainEnvelope
+{
+public:
+
+    enum class Shape
+    {
+        trapezoid = 0, // linear attack / sustain / release
+        hann           // raised cosine
+    };
+
+    struct Parameters
+    {
+        Shape shape = Shape::trapezoid;
+        float attackPercent = 1.0f;   // percentage of the grain length
+        float releasePercent = 1.0f;
+    };
+
+    void start(const Parameters& params, int lengthInSamples)
+    {
+        shape = params.shape;
+
+        if (shape == Shape::hann)
+        {
+            //cos(w*n) is produced by the recurrence c[n+1] = 2cos(w)*c[n] - c[n-1]
+            //a one-sample grain gets w = 0 and stays silent
+            double w = lengthInSamples > 1 ? juce::MathConstants<double>::twoPi / (lengthInSamples - 1) : 0.0;
+            cosCoefficient = 2.0 * std::cos(w);
+            cosCurrent = 1.0;
+            cosPrevious = std::cos(w);
+            return;
+        }
+
+        getTrapezoidLengths(params, lengthInSamples, attackSamples, releaseSamples);
+        sustainSamples = lengthInSamples - attackSamples - releaseSamples;
+
+        segment = -1;
+        nextSegment();
+    }
+
+    // Attack and release of a trapezoid over a grain this long, the sustain is what is left
+    static void getTrapezoidLengths(const Parameters& params, int lengthInSamples, int& attackSamples, int& releaseSamples)
+    {
+        attackSamples = juce::jlimit(0, lengthInSamples,
+                                     (int)std::ceil(lengthInSamples * params.attackPercent * 0.01f));
+        releaseSamples = juce::jlimit(0, lengthInSamples - attackSamples,
+                                      (int)std::floor(lengthInSamples * params.releasePercent * 0.01f));
+    }
+
+    inline float getNextSample() noexcept
+    {
+        return shape == Shape::hann ? getNextHannSample() : getNextTrapezoidSample();
+    }
+
+    inline float getNextHannSample() noexcept
+    {
+        double value = 0.5 * (1.0 - cosCurrent);
+        double next = cosCoefficient * cosCurrent - cosPrevious;
+        cosPrevious = cosCurrent;
+        cosCurrent = next;
+        return (float)value;
+    }
+
+    inline float getNextTrapezoidSample() noexcept
+    {
+        float value = level;
+        level += increment;
+
+        if (--samplesUntilNextSegment <= 0)
+            nextSegment();
+
+        return value;
+    }
+
+private:
+
+    void nextSegment() noexcept
+    {
+        //skip over empty segments, e.g. a 0% attack
+        for (;;)
+        {
+            segment++;
+
+            if (segment == 0 && attackSamples > 0)
+            {
+                level = 0.0f;
+                increment = 1.0f / attackSamples;
+                samplesUntilNextSegment = attackSamples;
+                return;
+            }
+            if (segment == 1 && sustainSamples > 0)
+            {
+                level = 1.0f;
+                increment = 0.0f;
+                samplesUntilNextSegment = sustainSamples;
+                return;
+            }
+            if (segment == 2 && releaseSamples > 0)
+            {
+                level = 1.0f;
+                increment = -1.0f / releaseSamples;
+                samplesUntilNextSegment = releaseSamples;
+                return;
+            }
+            if (segment >= 3)
+            {
+                level = 0.0f;
+                increment = 0.0f;
+                samplesUntilNextSegment = std::numeric_limits<int>::max();
+                return;
+            }
+        }
+    }
+
+    Shape shape = Shape::trapezoid;
+
+    //hann state
+    double cosCoefficient = 0.0, cosCurrent = 1.0, cosPrevious = 1.0;
+
+    //trapezoid state
+    int attackSamples = 0, sustainSamples = 0, releaseSamples = 0;
+    int segment = 0;
+    int samplesUntilNextSegment = 0;
+    float level = 0.0f, increment = 0.0f;
+};
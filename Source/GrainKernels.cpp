@@ -0,0 +1,261 @@
+/*
+  ==============================================================================
+
+    GrainKernels.cpp
+    Created: 19 Oct 2026 2:40:17pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "GrainKernels.h"
+#include "SimdKernels.h"
+
+namespace GrainKernels
+{
+
+struct LinearInterpolator
+{
+    static constexpr int samplesBefore = 0, samplesAfter = 1;
+
+    static inline float read(const float* source, double position) noexcept
+    {
+        int index = (int)position;
+        float fraction = (float)(position - index);
+        return source[index] + fraction * (source[index + 1] - source[index]);
+    }
+};
+
+struct CubicInterpolator
+{
+    static constexpr int samplesBefore = 1, samplesAfter = 2;
+
+    //4-point, 3rd-order Hermite
+    static inline float read(const float* source, double position) noexcept
+    {
+        int index = (int)position;
+        float x = (float)(position - index);
+        float ym1 = source[index - 1], y0 = source[index], y1 = source[index + 1], y2 = source[index + 2];
+
+        float c1 = 0.5f * (y1 - ym1);
+        float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+        float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+        return ((c3 * x + c2) * x + c1) * x + y0;
+    }
+};
+
+template <GrainEnvelope::Shape shape>
+static inline float nextEnvelopeSample(GrainEnvelope& envelope) noexcept
+{
+    if constexpr (shape == GrainEnvelope::Shape::hann)
+        return envelope.getNextHannSample();
+    else
+        return envelope.getNextTrapezoidSample();
+}
+
+// The envelope and the resampled source are produced a chunk at a time, then
+// accumulated with the vector kernels picked for this CPU. 16 bit sources are
+// widened a chunk at a time too, just the stretch the chunk reads.
+static constexpr int chunkSize = 64;
+static constexpr int decodedChunkSize = 512;
+
+template <SampleArena::Format format>
+static inline void decode(const SimdKernels::KernelSet& simd, float* dest, const void* source,
+                          int startSample, int numSamples) noexcept
+{
+    if constexpr (format == SampleArena::Format::int16)
+        simd.decodeInt16(dest, static_cast<const juce::int16*>(source) + startSample, numSamples);
+    else
+        simd.decodeHalf(dest, static_cast<const juce::uint16*>(source) + startSample, numSamples);
+}
+
+template <typename Interpolator>
+static inline void resample(const SimdKernels::KernelSet& simd, float* dest, const float* source,
+                            double position, double increment, int numSamples) noexcept
+{
+    if constexpr (std::is_same_v<Interpolator, LinearInterpolator>)
+    {
+        simd.interpolateLinear(dest, source, position, increment, numSamples);
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; i++)
+            dest[i] = Interpolator::read(source, position + i * increment);
+    }
+}
+
+// Live input rings are read in place too. Only a chunk that straddles the end
+// of the ring is copied out first, in two pieces.
+template <typename Interpolator, bool unityPitch>
+static inline const float* readFromRing(const SimdKernels::KernelSet& simd, const GrainState& grain, const float* ring,
+                                        float* sampleChunk, int numSamples) noexcept
+{
+    int size = grain.ringMask + 1;
+    int first = (int)grain.readPosition - (unityPitch ? 0 : Interpolator::samplesBefore);
+    int count = unityPitch ? numSamples
+              : (int)(grain.readPosition + (numSamples - 1) * grain.increment) + Interpolator::samplesAfter + 2 - first;
+
+    if (first >= 0 && first + count <= size)
+    {
+        if constexpr (unityPitch)
+            return ring + first;
+
+        resample<Interpolator>(simd, sampleChunk, ring, grain.readPosition, grain.increment, numSamples);
+        return sampleChunk;
+    }
+
+    alignas(64) float unwrapped[decodedChunkSize];
+    float* dest = unityPitch ? sampleChunk : unwrapped;
+    int start = first & grain.ringMask;
+    int beforeWrap = juce::jmin(count, size - start);
+    std::copy(ring + start, ring + start + beforeWrap, dest);
+    std::copy(ring, ring + (count - beforeWrap), dest + beforeWrap);
+
+    if constexpr (! unityPitch)
+        resample<Interpolator>(simd, sampleChunk, unwrapped, grain.readPosition - first, grain.increment, numSamples);
+    return sampleChunk;
+}
+
+template <SampleArena::Format format, typename Interpolator, GrainEnvelope::Shape shape, int numChannels, bool unityPitch>
+static void renderGrain(GrainState& grain, float* const* output, int numSamples)
+{
+    const auto& simd = SimdKernels::get();
+    auto& envelope = grain.envelope;
+    alignas(64) float envelopeChunk[chunkSize];
+    alignas(64) float sampleChunk[chunkSize];
+
+    //high pitches read further per chunk, so their chunks get shorter to fit the decode buffer
+    int maxChunk = chunkSize;
+    if constexpr (! unityPitch)
+        if (format != SampleArena::Format::float32 || grain.ringMask != 0)
+            maxChunk = juce::jlimit(1, chunkSize, (int)((decodedChunkSize - 6) / grain.increment) + 1);
+
+    for (int done = 0, n = 0; done < numSamples; done += n)
+    {
+        n = juce::jmin(maxChunk, numSamples - done);
+
+        for (int i = 0; i < n; i++)
+            envelopeChunk[i] = nextEnvelopeSample<shape>(envelope);
+
+        const float* read = sampleChunk;
+        if constexpr (format == SampleArena::Format::float32)
+        {
+            const float* source = static_cast<const float*>(grain.source);
+            if (grain.ringMask != 0)
+                read = readFromRing<Interpolator, unityPitch>(simd, grain, source, sampleChunk, n);
+            else if constexpr (unityPitch)
+                read = source + (int)grain.readPosition; //a plain multiply-accumulate straight from the file
+            else
+                resample<Interpolator>(simd, sampleChunk, source, grain.readPosition, grain.increment, n);
+        }
+        else if constexpr (unityPitch)
+        {
+            decode<format>(simd, sampleChunk, grain.source, (int)grain.readPosition, n);
+        }
+        else
+        {
+            //one spare sample covers rounding differences between the absolute and relative positions
+            alignas(64) float decodedChunk[decodedChunkSize];
+            int first = (int)grain.readPosition - Interpolator::samplesBefore;
+            int last = (int)(grain.readPosition + (n - 1) * grain.increment) + Interpolator::samplesAfter + 1;
+            decode<format>(simd, decodedChunk, grain.source, first, last - first + 1);
+            resample<Interpolator>(simd, sampleChunk, decodedChunk, grain.readPosition - first, grain.increment, n);
+        }
+
+        if constexpr (numChannels > 1)
+        {
+            if (grain.gains[0] == 1.0f && grain.gains[1] == 1.0f)
+            {
+                simd.multiplyAdd(output[0] + done, read, envelopeChunk, n);
+                simd.multiplyAdd(output[1] + done, read, envelopeChunk, n);
+            }
+            else
+            {
+                //panned grains fold the channel gain into the envelope
+                alignas(64) float channelEnvelope[chunkSize];
+                for (int channel = 0; channel < 2; channel++)
+                {
+                    for (int i = 0; i < n; i++)
+                        channelEnvelope[i] = envelopeChunk[i] * grain.gains[channel];
+                    simd.multiplyAdd(output[channel] + done, read, channelEnvelope, n);
+                }
+            }
+        }
+        else
+        {
+            float monoGain = getMonoGain(grain.gains);
+            if (monoGain == 1.0f)
+                simd.multiplyAdd(output[0] + done, read, envelopeChunk, n);
+            else
+            {
+                alignas(64) float monoEnvelope[chunkSize];
+                for (int i = 0; i < n; i++)
+                    monoEnvelope[i] = envelopeChunk[i] * monoGain;
+                simd.multiplyAdd(output[0] + done, read, monoEnvelope, n);
+            }
+        }
+
+        grain.readPosition += n * grain.increment;
+        if (grain.ringMask != 0 && grain.readPosition >= grain.ringMask + 1)
+            grain.readPosition -= grain.ringMask + 1;
+    }
+
+    grain.samplesRemaining -= numSamples;
+}
+
+//==============================================================================
+
+// key layout: format * 8 + interpolation * 4 + shape * 2 + unityPitch
+// table layout: [key / 4][(key % 4) * 2 + (numChannels - 1)]
+template <SampleArena::Format format, typename Interpolator, GrainEnvelope::Shape shape, bool unityPitch>
+static constexpr RenderFunction kernelsFor(int numChannels)
+{
+    return numChannels == 1 ? &renderGrain<format, Interpolator, shape, 1, unityPitch>
+                            : &renderGrain<format, Interpolator, shape, 2, unityPitch>;
+}
+
+template <SampleArena::Format format, typename Interpolator>
+static constexpr std::array<RenderFunction, 8> kernelsFor()
+{
+    using Shape = GrainEnvelope::Shape;
+    return {{
+        kernelsFor<format, Interpolator, Shape::trapezoid, false>(1), kernelsFor<format, Interpolator, Shape::trapezoid, false>(2),
+        kernelsFor<format, Interpolator, Shape::trapezoid, true>(1),  kernelsFor<format, Interpolator, Shape::trapezoid, true>(2),
+        kernelsFor<format, Interpolator, Shape::hann, false>(1),      kernelsFor<format, Interpolator, Shape::hann, false>(2),
+        kernelsFor<format, Interpolator, Shape::hann, true>(1),       kernelsFor<format, Interpolator, Shape::hann, true>(2)
+    }};
+}
+
+static const std::array<std::array<RenderFunction, 8>, 6> kernelTable
+{{
+    kernelsFor<SampleArena::Format::float32, LinearInterpolator>(),
+    kernelsFor<SampleArena::Format::float32, CubicInterpolator>(),
+    kernelsFor<SampleArena::Format::int16, LinearInterpolator>(),
+    kernelsFor<SampleArena::Format::int16, CubicInterpolator>(),
+    kernelsFor<SampleArena::Format::half, LinearInterpolator>(),
+    kernelsFor<SampleArena::Format::half, CubicInterpolator>()
+}};
+
+int getKernelKey(SampleArena::Format format, Interpolation interpolation,
+                 GrainEnvelope::Shape shape, bool unityPitch) noexcept
+{
+    return (int)format * 8 + (int)interpolation * 4 + (int)shape * 2 + (unityPitch ? 1 : 0);
+}
+
+RenderFunction getRenderFunction(int kernelKey, int numChannels) noexcept
+{
+    jassert(numChannels == 1 || numChannels == 2);
+    return kernelTable[(size_t)(kernelKey / 4)][(size_t)((kernelKey % 4) * 2 + numChannels - 1)];
+}
+
+int getSamplesBefore(Interpolation interpolation) noexcept
+{
+    return interpolation == Interpolation::cubic ? CubicInterpolator::samplesBefore : LinearInterpolator::samplesBefore;
+}
+
+int getSamplesAfter(Interpolation interpolation) noexcept
+{
+    return interpolation == Interpolation::cubic ? CubicInterpolator::samplesAfter : LinearInterpolator::samplesAfter;
+}
+
+}
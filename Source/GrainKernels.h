@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    GrainKernels.h
+    Created: 19 Oct 2026 2:40:17pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "GrainEnvelope.h"
+#include "SampleArena.h"
+
+
+// Playback state of one grain, advanced by the render kernels.
+struct GrainState
+{
+    const void* source = nullptr; //the file the grain reads from, in the arena's format
+    double readPosition = 0.0; //the position inside the file
+    int ringMask = 0;          //size - 1 of the live input ring the source wraps around, 0 for a file
+    double increment = 1.0;    //the pitch shift factor
+    int samplesRemaining = 0;
+    int startDelay = 0;        //samples to wait before the grain starts sounding
+    int kernelKey = 0;
+    float gains[2] = { 1.0f, 1.0f }; //left and right, mono output uses GrainKernels::getMonoGain
+    GrainEnvelope envelope;
+};
+
+
+// Grain renderers specialised at compile time on sample format, interpolation,
+// envelope shape, output channel count and unity pitch. GranSynth looks up the
+// function once per block, so the per-sample loops contain no runtime choices.
+namespace GrainKernels
+{
+    enum class Interpolation
+    {
+        linear = 0,
+        cubic
+    };
+
+    // Adds numSamples of the grain into the output channels and advances its state
+    using RenderFunction = void (*)(GrainState& grain, float* const* output, int numSamples);
+
+    // Everything except the channel count, which is only known per block
+    int getKernelKey(SampleArena::Format format, Interpolation interpolation,
+                     GrainEnvelope::Shape shape, bool unityPitch) noexcept;
+    RenderFunction getRenderFunction(int kernelKey, int numChannels) noexcept;
+
+    // Source samples the interpolator reads before and after the read position
+    int getSamplesBefore(Interpolation interpolation) noexcept;
+    int getSamplesAfter(Interpolation interpolation) noexcept;
+
+    // A grain's left and right gains: its pan by the balance law, centred grains at full level, times its level
+    inline void setChannelGains(float* channelGains, float pan, float level = 1.0f) noexcept
+    {
+        channelGains[0] = juce::jmin(1.0f, 1.0f - pan) * level;
+        channelGains[1] = juce::jmin(1.0f, 1.0f + pan) * level;
+    }
+
+    // The level of a grain on mono output, the same for spans, clouds, cached and spectral grains:
+    // the louder of its channel gains, so panning alone never changes it
+    inline float getMonoGain(const float* channelGains) noexcept { return juce::jmax(channelGains[0], channelGains[1]); }
+}
@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    GrainPositionFifo.h
+    Created: 23 Oct 2026 10:18:52am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Where the grains are playing, handed from the audio thread to the editor.
+// The audio thread pushes the arena positions of the sounding grains once per
+// block and the editor pulls whatever arrived since its last frame. Single
+// producer, single consumer, preallocated; a full FIFO just drops positions.
+class GrainPositionFifo
+{
+public:
+
+    static constexpr int capacity = 4096;
+
+    // Audio thread
+    void push(const int* positions, int numPositions) noexcept
+    {
+        const auto scope = fifo.write(juce::jmin(numPositions, fifo.getFreeSpace()));
+        std::copy(positions, positions + scope.blockSize1, buffer.begin() + scope.startIndex1);
+        std::copy(positions + scope.blockSize1, positions + scope.blockSize1 + scope.blockSize2, buffer.begin() + scope.startIndex2);
+    }
+
+    // Message thread, returns how many positions were copied
+    int pull(int* positions, int maxPositions) noexcept
+    {
+        const auto scope = fifo.read(juce::jmin(maxPositions, fifo.getNumReady()));
+        std::copy(buffer.begin() + scope.startIndex1, buffer.begin() + scope.startIndex1 + scope.blockSize1, positions);
+        std::copy(buffer.begin() + scope.startIndex2, buffer.begin() + scope.startIndex2 + scope.blockSize2, positions + scope.blockSize1);
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+private:
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<int, capacity> buffer {};
+};
@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    GrainRenderCache.cpp
+    Created: 27 Oct 2026 10:38:50am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "GrainRenderCache.h"
+#include "GranSynth.h"
+
+bool GrainRenderCache::Key::operator== (const Key& other) const noexcept
+{
+    return arena == other.arena && region == other.region && start == other.start && length == other.length
+        && pitch == other.pitch && envelope.shape == other.envelope.shape
+        && envelope.attackPercent == other.envelope.attackPercent
+        && envelope.releasePercent == other.envelope.releasePercent && interpolation == other.interpolation;
+}
+
+juce::uint64 GrainRenderCache::Key::hash() const noexcept
+{
+    auto bitsOf = [](float value) { juce::uint32 bits; std::memcpy(&bits, &value, sizeof(bits)); return (juce::uint64)bits; };
+    juce::uint64 fields[] = { (juce::uint64)(juce::pointer_sized_uint)arena, (juce::uint64)region, (juce::uint64)(juce::uint32)start,
+                              (juce::uint64)length, bitsOf(pitch), (juce::uint64)envelope.shape, bitsOf(envelope.attackPercent),
+                              bitsOf(envelope.releasePercent), (juce::uint64)interpolation };
+
+    //FNV-1a over the fields, then mixed so neighbouring starts land far apart in the index
+    juce::uint64 h = 14695981039346656037ull;
+    for (auto field : fields)
+        h = (h ^ field) * 1099511628211ull;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+GrainRenderCache::GrainRenderCache()
+    : juce::Thread("Grain renderer")
+{
+}
+
+GrainRenderCache::~GrainRenderCache()
+{
+    stopThread(-1);
+}
+
+void GrainRenderCache::prepare(int newMaxEntries, size_t newMaxBytes)
+{
+    stopThread(-1);
+    requests.drain([](Request& request) { request.arena = nullptr; });
+
+    {
+        const juce::SpinLock::ScopedLockType lock(indexLock);
+        maxEntries = juce::jmax(1, newMaxEntries);
+        maxBytes = newMaxBytes;
+        bytes = 0;
+        entries.clear();
+        entries.reserve((size_t)maxEntries);
+        index.assign((size_t)juce::nextPowerOfTwo(2 * maxEntries), 0);
+    }
+
+    evicted.clear();
+    evicted.reserve((size_t)maxEntries);
+    seen.assign(index.size(), 0);
+    numSeen = 0;
+    purgedFor = nullptr;
+    startThread();
+}
+
+GrainRenderCache::Entry::Ptr GrainRenderCache::find(const Key& key) noexcept
+{
+    const juce::SpinLock::ScopedTryLockType lock(indexLock);
+    if (! lock.isLocked())
+        return nullptr;
+
+    auto* entry = findEntry(key, key.hash());
+    if (entry == nullptr)
+        return nullptr;
+
+    entry->lastPlayed.store(++clock, std::memory_order_relaxed);
+    return entry;
+}
+
+void GrainRenderCache::request(const Key& key, const SampleArena::Ptr& arena) noexcept
+{
+    requests.push({ key, arena });
+}
+
+GrainRenderCache::Entry* GrainRenderCache::findEntry(const Key& key, juce::uint64 hash) const noexcept
+{
+    if (index.empty())
+        return nullptr;
+
+    auto mask = index.size() - 1;
+    for (auto slot = (size_t)hash & mask; index[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const auto& entry = entries[(size_t)index[slot] - 1];
+        if (entry->hash == hash && entry->key == key)
+            return entry.get();
+    }
+    return nullptr;
+}
+
+void GrainRenderCache::run()
+{
+    while (! threadShouldExit())
+    {
+        auto arena = currentArena.load(std::memory_order_acquire);
+        if (arena != purgedFor)
+        {
+            purge(arena);
+            purgedFor = arena;
+        }
+
+        //the arena goes with the request, so a swapped-out sample is freed here rather than on the audio thread
+        requests.drain([this](Request& request)
+        {
+            render(request);
+            request.arena = nullptr;
+        });
+
+        evicted.erase(std::remove_if(evicted.begin(), evicted.end(),
+                                     [](const Entry::Ptr& entry) { return entry->getReferenceCount() == 1; }),
+                      evicted.end());
+        wait(10);
+    }
+}
+
+void GrainRenderCache::render(const Request& request)
+{
+    const auto& key = request.key;
+    auto hash = key.hash();
+    if (request.arena == nullptr || request.arena.get() != currentArena.load(std::memory_order_acquire)
+        || findEntry(key, hash) != nullptr || ! juce::isPositiveAndBelow(key.region, request.arena->getNumRegions()))
+        return;
+
+    //a grain is only worth keeping once it comes round again
+    auto numBits = (juce::uint64)seen.size() * 64;
+    juce::uint64 bits[] = { hash & (numBits - 1), (hash >> 32) & (numBits - 1) };
+    auto isSet = [this](juce::uint64 bit) { return (seen[(size_t)(bit / 64)] & (1ull << (bit % 64))) != 0; };
+    if (! (isSet(bits[0]) && isSet(bits[1])))
+    {
+        if (++numSeen > (int)(numBits / 8))
+        {
+            std::fill(seen.begin(), seen.end(), 0);
+            numSeen = 0;
+        }
+        for (auto bit : bits)
+            seen[(size_t)(bit / 64)] |= 1ull << (bit % 64);
+        return;
+    }
+
+    const auto& region = request.arena->getRegion(key.region);
+    int start = key.start;
+    int length = Grain::fitToFile(region.length, start, key.length, key.pitch, key.interpolation);
+    if (length <= 0 || (size_t)length * sizeof(float) > maxBytes)
+        return;
+
+    Entry::Ptr entry = new Entry();
+    entry->key = key;
+    entry->hash = hash;
+    entry->arena = request.arena;
+    entry->arenaStart = region.offset + start;
+    entry->samples.assign((size_t)length, 0.0f);
+
+    //the same grain the voice would play, rendered alone into one channel
+    int kernelKey = GrainKernels::getKernelKey(request.arena->getFormat(), key.interpolation, key.envelope.shape, key.pitch == 1.0f);
+    Grain grain(request.arena->getRegionData(key.region), region.length, key.start, key.length, key.pitch,
+                key.envelope, key.interpolation, 0, kernelKey);
+    float* channel = entry->samples.data();
+    juce::AudioBuffer<float> buffer(&channel, 1, length);
+    grain.processGrain(GrainKernels::getRenderFunction(kernelKey, 1), buffer);
+
+    insert(entry);
+}
+
+void GrainRenderCache::insert(Entry::Ptr entry)
+{
+    size_t entryBytes = (size_t)entry->getLength() * sizeof(float);
+
+    //least recently played first, counted back from now so the clock can wrap
+    auto now = clock.load(std::memory_order_relaxed);
+    const juce::SpinLock::ScopedLockType lock(indexLock);
+    while (! entries.empty() && ((int)entries.size() >= maxEntries || bytes + entryBytes > maxBytes))
+    {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries.size(); i++)
+            if (now - entries[i]->lastPlayed.load(std::memory_order_relaxed) > now - entries[oldest]->lastPlayed.load(std::memory_order_relaxed))
+                oldest = i;
+
+        bytes -= (size_t)entries[oldest]->getLength() * sizeof(float);
+        evicted.push_back(std::move(entries[oldest]));
+        entries[oldest] = std::move(entries.back());
+        entries.pop_back();
+    }
+
+    entry->lastPlayed.store(now, std::memory_order_relaxed);
+    bytes += entryBytes;
+    entries.push_back(std::move(entry));
+    rebuildIndex();
+}
+
+void GrainRenderCache::purge(const SampleArena* arena)
+{
+    //evicted like any other entry, the old arena goes once no grain plays them
+    const juce::SpinLock::ScopedLockType lock(indexLock);
+    for (size_t i = 0; i < entries.size();)
+    {
+        if (entries[i]->arena.get() == arena)
+        {
+            i++;
+            continue;
+        }
+        bytes -= (size_t)entries[i]->getLength() * sizeof(float);
+        evicted.push_back(std::move(entries[i]));
+        entries[i] = std::move(entries.back());
+        entries.pop_back();
+    }
+    rebuildIndex();
+}
+
+void GrainRenderCache::rebuildIndex()
+{
+    std::fill(index.begin(), index.end(), 0);
+    auto mask = index.size() - 1;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        auto slot = (size_t)entries[i]->hash & mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & mask;
+        index[slot] = (int)i + 1;
+    }
+}
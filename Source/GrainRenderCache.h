@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+    GrainRenderCache.h
+    Created: 27 Oct 2026 10:38:50am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+#include "GrainEnvelope.h"
+#include "GrainKernels.h"
+#include "CommandFifo.h"
+
+
+// Rendered file grains, kept so a patch playing the same grain over and over
+// (a repeated note over a static region, say) mixes a finished waveform
+// instead of resampling and windowing it again. Grains are keyed by what
+// decides their samples: file, start, length, pitch, envelope and
+// interpolation. The audio thread looks grains up and asks for the ones it
+// missed; a background thread renders those seen twice, mono and at full
+// level, and evicts the least recently played once the cache is full. Lookups
+// only try-lock the index, a busy index is a miss. Entries are shared, so a
+// grain evicted while it plays keeps its waveform, and the background thread
+// frees it once the last grain is done with it. Only grains of the arena set
+// last are kept, a sample swap purges the rest and lets their arena go.
+class GrainRenderCache : private juce::Thread
+{
+public:
+
+    static constexpr int maxGrainLength = 16384;
+
+    struct Key
+    {
+        const SampleArena* arena = nullptr;
+        int region = 0;
+        int start = 0; // in the region, before it is fitted to the file
+        int length = 0;
+        float pitch = 1.0f;
+        GrainEnvelope::Parameters envelope;
+        GrainKernels::Interpolation interpolation = GrainKernels::Interpolation::linear;
+
+        bool operator== (const Key& other) const noexcept;
+        juce::uint64 hash() const noexcept;
+    };
+
+    class Entry : public juce::ReferenceCountedObject
+    {
+    public:
+
+        using Ptr = juce::ReferenceCountedObjectPtr<Entry>;
+
+        const float* getSamples() const noexcept { return samples.data(); }
+        int getLength() const noexcept { return (int)samples.size(); }
+        // Where the grain starts reading in the arena, and how fast
+        int getArenaStart() const noexcept { return arenaStart; }
+        float getPitch() const noexcept { return key.pitch; }
+
+    private:
+
+        friend class GrainRenderCache;
+
+        Key key;
+        juce::uint64 hash = 0;
+        SampleArena::Ptr arena; // so the key's arena can't be freed and another one take its address
+        std::vector<float> samples;
+        int arenaStart = 0;
+        std::atomic<juce::uint32> lastPlayed { 0 };
+    };
+
+    GrainRenderCache();
+    ~GrainRenderCache() override;
+
+    // Drops every entry, sizes the index and starts the render thread
+    void prepare(int maxEntries = 4096, size_t maxBytes = 64 << 20);
+
+    // Audio thread: the grain rendered for key, or null
+    Entry::Ptr find(const Key& key) noexcept;
+    // Audio thread: asks for a grain that was not found; grains missed only once are never rendered
+    void request(const Key& key, const SampleArena::Ptr& arena) noexcept;
+    // Audio thread: the arena new notes play; the background thread drops the entries of any other
+    void setArena(const SampleArena* arena) noexcept { currentArena.store(arena, std::memory_order_release); }
+
+private:
+
+    struct Request
+    {
+        Key key;
+        SampleArena::Ptr arena;
+    };
+
+    void run() override;
+    void render(const Request& request);
+    // Makes room for and publishes a new entry, background thread only
+    void insert(Entry::Ptr entry);
+    // Moves the entries of every arena but this one out of the index, background thread only
+    void purge(const SampleArena* arena);
+    void rebuildIndex();
+    Entry* findEntry(const Key& key, juce::uint64 hash) const noexcept;
+
+    juce::SpinLock indexLock; // the background thread holds it while it changes the entries, the audio thread only tries it
+    std::vector<Entry::Ptr> entries;
+    std::vector<int> index; // open addressing into entries, entry + 1 or 0 where empty
+    int maxEntries = 0;
+    size_t maxBytes = 0;
+    size_t bytes = 0;
+    std::atomic<juce::uint32> clock { 0 };
+    std::atomic<const SampleArena*> currentArena { nullptr };
+
+    // background thread only
+    std::vector<Entry::Ptr> evicted; // until no grain plays them any more
+    std::vector<juce::uint64> seen;  // Bloom filter of the grains missed once, cleared as it fills up
+    int numSeen = 0;
+    const SampleArena* purgedFor = nullptr;
+
+    CommandFifo<Request, 1024> requests;
+
+    JUCE_DECLARE_NON_COPYABLE (GrainRenderCache)
+};
@@ -9,46 +9,65 @@
 */
 
 #include "GranSynth.h"
+#include "SimdKernels.h"
 
 
-Grain::Grain(const juce::AudioBuffer<float>& filebuffer, int startSample,
- int grainSize, float newpitchshiftfactor)
+Grain::Grain(const void* sourceData, int sourceLength, int startSample,
+ int grainSize, float newpitchshiftfactor, const GrainEnvelope::Parameters& envelopeParams,
+ GrainKernels::Interpolation interpolation, int startDelay, int kernelKey, float pan, float level,
+ const LoopSeams::Seam* loop)
 {
-    size = grainSize;
-    currentPosition = 0;
-    pitchShiftFactor = newpitchshiftfactor;
-
-    grainAudioData.setSize(1, size);
-    grainAudioData.clear();
-    
-    float *sample = grainAudioData.getWritePointer(0);
-    int copiedNumSamples = 0;
-    
-    //interpolation
-    for (int i = 0; i < size; i++)
+    if (loop != nullptr && loop->contains(startSample))
     {
-        if(std::ceil(startSample + i * pitchShiftFactor) > filebuffer.getNumSamples()-1) break;
-        
-        //get the decimal part of pitchShiftFactor, which is the ratio
-        float decimalPart = std::abs(pitchShiftFactor - std::floor(pitchShiftFactor));
-        float sample1 = filebuffer.getSample(0, std::floor(startSample+ i*pitchShiftFactor));
-        float sample2 = filebuffer.getSample(0, std::ceil(startSample+ i*pitchShiftFactor));
-
-        float interpolateSample = sample1 * decimalPart + sample2 * (1-decimalPart);
-        sample[i] = interpolateSample;
-        copiedNumSamples++;
-        
+        looping = true;
+        seam = *loop;
+        fileSource = sourceData;
+        state.source = sourceData;
+        state.readPosition = startSample;
+        state.increment = newpitchshiftfactor;
+        if (startSample >= seam.getFadeStart())
+            crossSeam();
+        start(grainSize, envelopeParams, startDelay, kernelKey, pan, level);
+        return;
     }
     
-//    std::vector<float> window = createHanningWindow(size); //window can be in the constructor
-//    
-//    for (int i = 0; i < size; ++i){
-//        sample[i] = sample[i] * window[i];
-//    }
-    
-    grainAudioData.applyGainRamp(0, 0, ceil(size*0.01), 0, 1);
-    grainAudioData.applyGainRamp(0, floor(copiedNumSamples*0.99), floor(copiedNumSamples*0.01), 1, 0);
-    
+    int length = fitToFile(sourceLength, startSample, grainSize, newpitchshiftfactor, interpolation);
+    state.source = sourceData;
+    state.readPosition = startSample;
+    state.increment = newpitchshiftfactor;
+    start(length, envelopeParams, startDelay, kernelKey, pan, level);
+}
+
+int Grain::fitToFile(int sourceLength, int& startSample, int grainSize, float pitchShiftFactor,
+                     GrainKernels::Interpolation interpolation)
+{
+    //keep the interpolator's neighbouring samples inside the file, stopping early rather than reading past the end
+    startSample = juce::jmax(startSample, GrainKernels::getSamplesBefore(interpolation));
+    int lastReadableSample = sourceLength - 1 - GrainKernels::getSamplesAfter(interpolation);
+    int samplesInFile = startSample > lastReadableSample ? 0
+                      : (int)std::floor((lastReadableSample - startSample) / pitchShiftFactor) + 1;
+    return juce::jmin(grainSize, samplesInFile);
+}
+
+Grain::Grain(const LiveInputBuffer& liveInput, juce::int64 startPosition,
+ int grainSize, float newpitchshiftfactor, const GrainEnvelope::Parameters& envelopeParams,
+ int startDelay, int kernelKey, float pan, float level)
+{
+    //the caller keeps the grain clear of the write position, the kernel handles the wrap
+    state.source = liveInput.getData();
+    state.ringMask = liveInput.getSize() - 1;
+    state.readPosition = (double)(startPosition & state.ringMask);
+    state.increment = newpitchshiftfactor;
+    start(grainSize, envelopeParams, startDelay, kernelKey, pan, level);
+}
+
+void Grain::start(int length, const GrainEnvelope::Parameters& envelopeParams, int startDelay, int kernelKey, float pan, float level)
+{
+    state.samplesRemaining = length;
+    state.startDelay = startDelay;
+    state.kernelKey = kernelKey;
+    GrainKernels::setChannelGains(state.gains, pan, level);
+    state.envelope.start(envelopeParams, state.samplesRemaining);
 }
 
 Grain::~Grain()
@@ -56,23 +75,60 @@ Grain::~Grain()
 
 }
 
-void Grain::processGrain(juce::AudioBuffer<float>& outputBuffer, int
-  startSampleInOutput, float gain) //playback
+void Grain::processGrain(GrainKernels::RenderFunction render,
+ juce::AudioBuffer<float>& outputBuffer) //playback
 {
-    if (currentPosition >= size-1)
+    int numSamples = outputBuffer.getNumSamples();
+    int offset = juce::jmin(state.startDelay, numSamples);
+    state.startDelay -= offset;
+    
+    int samplesToRender = juce::jmin(state.samplesRemaining, numSamples - offset);
+    if (samplesToRender <= 0)
+        return;
+    
+    float* output[2] = { outputBuffer.getWritePointer(0, offset),
+                         outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer(1, offset) : nullptr };
+    if (! looping)
+    {
+        render(state, output, samplesToRender);
         return;
+    }
     
-    auto outputIndex = outputBuffer.getWritePointer(0, startSampleInOutput); //output it directly to the system buffer
-    auto grainReadPtr = grainAudioData.getReadPointer(0, currentPosition);
-   
-    outputIndex[0] += grainReadPtr[0];
+    //rendered up to each seam boundary and moved across it, the kernels never see the loop
+    for (int done = 0; done < samplesToRender;)
+    {
+        double boundary = inSeam ? LoopSeams::padding + seam.fade : seam.getFadeStart();
+        int n = juce::jmin(samplesToRender - done, (int)std::ceil((boundary - state.readPosition) / state.increment));
+        if (n > 0)
+        {
+            float* part[2] = { output[0] + done, output[1] != nullptr ? output[1] + done : nullptr };
+            render(state, part, n);
+            done += n;
+        }
+        if (state.readPosition >= boundary)
+            crossSeam();
+    }
+}
 
-    currentPosition++; //iterate current position
+void Grain::crossSeam()
+{
+    //both sides hold the same audio around the boundary, only the source and the position change
+    if (inSeam)
+    {
+        state.source = fileSource;
+        state.readPosition += seam.getResumePosition() - (LoopSeams::padding + seam.fade);
+    }
+    else
+    {
+        state.source = seam.data;
+        state.readPosition += LoopSeams::padding - seam.getFadeStart();
+    }
+    inSeam = ! inSeam;
 }
 
 bool Grain::isFinished()
 {
-    if (currentPosition >= size-1)
+    if (state.samplesRemaining <= 0)
     {
         return true;
     }
@@ -89,9 +145,85 @@ bool Grain::isFinished()
 
 
 GranSynth::GranSynth(juce::AudioBuffer<float>& openedFileBuffer)
+    : GranSynth(SampleArena::fromBuffer(openedFileBuffer))
+{
+}
+
+GranSynth::GranSynth(SampleArena::Ptr sampleArena)
+    : arena(sampleArena)
+{
+    jassert(arena != nullptr);
+    modulation.prepare(44100.0, 512);
+}
+
+GranSynth::GranSynth(SampleArena::Ptr sampleArena, double noteFrequency, float velocity)
+    : GranSynth(sampleArena)
+{
+    frequency = noteFrequency;
+    notePitch = (float)(noteFrequency / juce::MidiMessage::getMidiNoteInHertz(rootNote));
+    gain = velocity;
+}
+
+void GranSynth::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    fileBuffer.setSize(1, openedFileBuffer.getNumSamples());
-    fileBuffer.copyFrom(0, 0, openedFileBuffer, 0, 0, openedFileBuffer.getNumSamples());
+    modulation.prepare(sampleRate, samplesPerBlock);
+    amplitudeEnvelope.setSampleRate(sampleRate);
+    maxBlockSize = juce::jmax(1, samplesPerBlock);
+    if (sharedScratch == nullptr)
+        ownScratch.prepare(getBlockScratchBytes(maxBlockSize) + SpectralGrains::getScratchBytes());
+    spectralGrains.prepare(maxBlockSize);
+    grains.clear(); //they may point into a live input ring that has just been reallocated
+    grainCloud.clear();
+    cachedGrains.clear();
+}
+
+size_t GranSynth::getBlockScratchBytes(int samplesPerBlock)
+{
+    //the grain mix of each output channel
+    return 2 * ScratchArena::bytesFor<float>(samplesPerBlock);
+}
+
+void GranSynth::setScratchArena(ScratchArena* newScratch){
+    
+    sharedScratch = newScratch;
+    
+}
+
+void GranSynth::reserveGrains(int capacity)
+{
+    grainCapacity = juce::jmax(1, capacity);
+    grains.reserve((size_t)grainCapacity);
+    grainCloud.reserve(grainCapacity);
+    cachedGrains.reserve((size_t)grainCapacity);
+}
+
+void GranSynth::startVoice(SampleArena::Ptr newArena, double newFrequency, float velocity)
+{
+    jassert(newArena != nullptr);
+    grains.clear();
+    grainCloud.clear();
+    cachedGrains.clear();
+    spectralGrains.reset();
+    replaceShared(arena, newArena.get());
+    frequency = newFrequency;
+    notePitch = (float)(newFrequency / juce::MidiMessage::getMidiNoteInHertz(rootNote));
+    gain = velocity;
+    
+    //back to the state of a freshly constructed voice, settings are left for the caller
+    replaceShared(sampleIndex, (SampleIndex*)nullptr);
+    replaceShared(corpus, (GrainCorpus*)nullptr);
+    corpusMatchesNeedUpdate = true;
+    nextCorpusMatch = 0;
+    sourceFile = 0;
+    randomSourcePerGrain = false;
+    envelopeEngaged = false;
+    released = false;
+    retired = false;
+    silentSamples = 0;
+    lastPeak = 0.0f;
+    startSampleInFile = 0;
+    samplesUntilNextGrain = 0;
+    outputCounter = 0;
 }
 
 GranSynth::~GranSynth()
@@ -101,59 +233,527 @@ GranSynth::~GranSynth()
 
 void GranSynth::processBlock(juce::AudioBuffer<float>& bufferToFill)
 {
-    DBG("grain size "<<grainSize<<" overlap "<< grainOverlap <<" spacing "<<grainSpacing);
-    juce::AudioBuffer<float> tempOutBuffer(1, bufferToFill.getNumSamples());
+    auto& scratch = sharedScratch != nullptr ? *sharedScratch : ownScratch;
+    if (sharedScratch == nullptr)
+        ownScratch.reset();
+    
+    int numSamples = bufferToFill.getNumSamples();
+    int numChannels = juce::jmin(2, bufferToFill.getNumChannels());
+    int chunkSize = juce::jmin(numSamples, maxBlockSize);
+    if (numChannels == 0 || chunkSize == 0)
+        return;
+    
+    float* temp[2] = { scratch.allocate<float>(chunkSize), numChannels > 1 ? scratch.allocate<float>(chunkSize) : nullptr };
+    if (temp[0] == nullptr || (numChannels > 1 && temp[1] == nullptr))
+        return;
+    
+    //blocks longer than prepared for go through the same scratch a prepared-size piece at a time
+    for (int start = 0; start < numSamples; start += chunkSize)
+    {
+        int n = juce::jmin(chunkSize, numSamples - start);
+        float* output[2] = { bufferToFill.getWritePointer(0, start),
+                             numChannels > 1 ? bufferToFill.getWritePointer(1, start) : nullptr };
+        juce::AudioBuffer<float> outputChunk(output, numChannels, n);
+        juce::AudioBuffer<float> tempOutBuffer(temp, numChannels, n);
+        renderBlock(outputChunk, tempOutBuffer);
+    }
+}
+
+void GranSynth::renderBlock(juce::AudioBuffer<float>& bufferToFill, juce::AudioBuffer<float>& tempOutBuffer)
+{
+    //live grains need no file, the arena may be empty
+    bool live = grainSource == GrainSource::liveInput && liveInput != nullptr && liveInput->getSize() > 0;
+    int numFiles = arena->getNumRegions();
+    int fileIndex = juce::jlimit(0, juce::jmax(0, numFiles - 1), sourceFile);
+    int fileLength = numFiles > 0 ? arena->getRegion(fileIndex).length : 0;
+    if (retired || (! live && fileLength == 0))
+        return;
+    
+    int numSamples = bufferToFill.getNumSamples();
+    int numChannels = tempOutBuffer.getNumChannels();
     tempOutBuffer.clear();
     
-    for (int i = 0; i < tempOutBuffer.getNumSamples(); i++)
+    //pick the specialised kernel once for the whole block
+    float basePitch = pitchShiftFactor * notePitch;
+    auto sourceFormat = live ? SampleArena::Format::float32 : arena->getFormat();
+    int kernelKey = GrainKernels::getKernelKey(sourceFormat, interpolation, envelopeParams.shape, basePitch == 1.0f);
+    auto blockRender = GrainKernels::getRenderFunction(kernelKey, numChannels);
+    bool cloudFormat = sourceFormat == SampleArena::Format::float32 && interpolation == GrainKernels::Interpolation::linear;
+    const LoopSeams* loops = ! live && loopSeams != nullptr && loopSeams->isFor(arena.get()) ? loopSeams.get() : nullptr;
+    const LoopSeams::Seam* fileLoop = loops != nullptr ? &loops->getSeam(fileIndex) : nullptr;
+    
+    if (corpusMatchesNeedUpdate && corpus != nullptr)
     {
-//        loop and delete grains
-        for(int j = 0; j < grains.size(); j++)
+        corpus->findNearest(corpusTarget, corpusMatches);
+        corpusMatchesNeedUpdate = false;
+    }
+    bool useCorpus = grainSource == GrainSource::corpus && corpus != nullptr && corpusMatches.size > 0;
+    
+    //control points for the whole block, read back only when a grain is spawned; the lfos and the
+    //envelope run on while nothing is routed, so switching a slot on mid note doesn't restart them
+    bool modulated = modulation.isActive();
+    modulation.process(numSamples);
+    
+    auto kernelKeyFor = [&](float grainPitch)
+    {
+        return grainPitch == basePitch ? kernelKey
+             : GrainKernels::getKernelKey(sourceFormat, interpolation, envelopeParams.shape, grainPitch == 1.0f);
+    };
+    
+    //spawn this block's grains, each one waits for the next grain spacing boundary
+    auto spawnStart = tracer != nullptr ? TraceRecorder::now() : 0;
+    int grainsBeforeSpawn = getNumGrains();
+    for (int i = 0; i < numSamples; i++)
+    {
+        //the file position runs round the loop, past its end it carries on where the crossfade leaves off
+        if (fileLoop != nullptr && fileLoop->end > 0)
         {
-            if(grains[j].isFinished())
-                grains.erase(grains.begin() + j);
+            if (! fileLoop->contains(startSampleInFile))
+                startSampleInFile = startSampleInFile >= fileLoop->end ? fileLoop->getResumePosition() : fileLoop->start;
         }
-        //playback
-        for (auto &g: grains)
+        else if (! live && startSampleInFile > (fileLength - 2)){
+            startSampleInFile = 0;
+            samplesUntilNextGrain = 0;
+        }
+        if (samplesUntilNextGrain <= 0 && getNumGrains() >= juce::jmin(maxGrains, grainCapacity))
+            samplesUntilNextGrain = juce::jmax(1, grainSize - grainOverlap); //over the CPU budget, this grain is dropped
+        if (samplesUntilNextGrain <= 0)
         {
-            if ((g.getCurrentPosition() > 0) || (outputCounter % grainSpacing == 0))
+            auto nextBoundary = (outputCounter + i + grainSpacing - 1) / grainSpacing * grainSpacing;
+            int startDelay = (int)(nextBoundary - outputCounter);
+            int grainFile = fileIndex;
+            int grainStart = startSampleInFile;
+            float grainPitch = basePitch;
+            int thisGrainSize = grainSize;
+            float interval = (float)(grainSize - grainOverlap);
+            float grainPan = 0.0f;
+            float pitchModulation = 1.0f;
+            float positionOffset = 0.0f;
+            
+            if (modulated)
             {
-
-                g.processGrain(tempOutBuffer, i, gain);
-//                if(outputCounter % grainSpacing == 0) DBG("whole number hit "<<outputCounter<<" with filereadposition at "<< startSampleInFile<<" grain size "<<grains.size());
+                using Mod = ModulationEngine;
+                if (modulation.isModulated(Mod::grainSize))
+                    thisGrainSize = juce::jmax(1, juce::roundToInt(grainSize * std::exp2(2.0f * modulation.getValue(Mod::grainSize, i))));
+                if (modulation.isModulated(Mod::density))
+                    interval /= std::exp2(2.0f * modulation.getValue(Mod::density, i));
+                if (modulation.isModulated(Mod::position))
+                    positionOffset = modulation.getValue(Mod::position, i);
+                if (modulation.isModulated(Mod::pitch))
+                    pitchModulation = std::exp2(modulation.getValue(Mod::pitch, i));
+                if (modulation.isModulated(Mod::pan))
+                    grainPan = juce::jlimit(-1.0f, 1.0f, modulation.getValue(Mod::pan, i));
+            }
+            
+            if (live)
+            {
+                grainPitch *= pitchModulation;
+                for (int s = 0; s < unison.streams; s++)
+                {
+                    if (s > 0 && getNumGrains() >= juce::jmin(maxGrains, grainCapacity))
+                        break;
+                    const auto& stream = unisonStreams[(size_t)s];
+                    float streamPitch = grainPitch * stream.pitch;
+                    spawnLiveGrain(startDelay, thisGrainSize, streamPitch, positionOffset, stream.offset,
+                                   juce::jlimit(-1.0f, 1.0f, grainPan + stream.pan), stream.level, kernelKeyFor(streamPitch));
+                }
+            }
+            else
+            {
+                if (randomSourcePerGrain)
+                {
+                    grainFile = random.nextInt(numFiles);
+                    grainStart = startSampleInFile % juce::jmax(1, arena->getRegion(grainFile).length);
+                }
+                if (useCorpus)
+                {
+                    //cycle through the matching frames, tuned onto the note; the corpus spans every file
+                    int match = nextCorpusMatch++ % corpusMatches.size;
+                    int matchFile = arena->findRegion(corpusMatches.startSamples[match]);
+                    if (matchFile >= 0)
+                    {
+                        grainFile = matchFile;
+                        grainStart = corpusMatches.startSamples[match] - arena->getRegion(grainFile).offset;
+                        grainPitch = pitchShiftFactor * corpusMatches.pitchRatios[match];
+                    }
+                }
+                
+                const auto& region = arena->getRegion(grainFile);
+                if (positionOffset != 0.0f && region.length > 0)
+                {
+                    grainStart += juce::roundToInt(positionOffset * region.length);
+                    grainStart = ((grainStart % region.length) + region.length) % region.length;
+                }
+                grainPitch *= pitchModulation;
+                
+                if (sampleIndex != nullptr)
+                {
+                    //the index covers the whole arena, ignore snaps that land in another file
+                    int snapped = sampleIndex->snap(snapMode, region.offset + grainStart) - region.offset;
+                    if (juce::isPositiveAndBelow(snapped, region.length))
+                        grainStart = snapped;
+                }
+                
+                const LoopSeams::Seam* grainLoop = loops != nullptr ? &loops->getSeam(grainFile) : nullptr;
+                bool inLoop = grainLoop != nullptr && grainLoop->contains(grainStart);
+                
+                //unison streams read the same file together; like a dense cloud their short grains are rendered side by side
+                for (int s = 0; s < unison.streams; s++)
+                {
+                    if (s > 0 && getNumGrains() >= juce::jmin(maxGrains, grainCapacity))
+                        break;
+                    const auto& stream = unisonStreams[(size_t)s];
+                    float streamPitch = grainPitch * stream.pitch;
+                    float streamPan = juce::jlimit(-1.0f, 1.0f, grainPan + stream.pan);
+                    int streamStart = grainStart;
+                    if (stream.offset != 0 && region.length > 0)
+                    {
+                        //spread streams stay inside the loop the grain started in
+                        int first = inLoop ? grainLoop->start : 0;
+                        int length = inLoop ? grainLoop->end - grainLoop->start : region.length;
+                        streamStart = first + (((grainStart - first + stream.offset) % length) + length) % length;
+                    }
+                    
+                    //grains reaching a seam stay out of the cloud and the cache
+                    bool reachesSeam = grainLoop != nullptr && grainLoop->wraps(streamStart, (double)thisGrainSize * streamPitch);
+                    bool joinsCloud = cloudFormat && thisGrainSize <= GrainCloud::maxGrainLength
+                                   && (getNumGrains() >= GrainCloud::minDensity || unison.streams > 1)
+                                   && grainCloud.accepts(envelopeParams.shape) && ! reachesSeam;
+                    
+                    //a grain that has come round before is mixed from the cache, one that missed is asked for
+                    GrainRenderCache::Entry::Ptr cached;
+                    if (renderCache != nullptr && grainMode == GrainMode::time && ! reachesSeam
+                        && thisGrainSize <= GrainRenderCache::maxGrainLength)
+                    {
+                        GrainRenderCache::Key key { arena.get(), grainFile, streamStart, thisGrainSize, streamPitch,
+                                                    envelopeParams, interpolation };
+                        cached = renderCache->find(key);
+                        if (cached == nullptr)
+                            renderCache->request(key, arena);
+                    }
+                    
+                    if (grainMode == GrainMode::spectral)
+                        spectralGrains.addFileGrain(*arena, region.offset + streamStart, region.offset + region.length,
+                                                    thisGrainSize, streamPitch, streamPan, stream.level, startDelay);
+                    else if (cached != nullptr)
+                    {
+                        cachedGrains.push_back({ std::move(cached), 0, startDelay });
+                        GrainKernels::setChannelGains(cachedGrains.back().gains, streamPan, stream.level);
+                    }
+                    else if (joinsCloud)
+                    {
+                        int length = Grain::fitToFile(region.length, streamStart, thisGrainSize, streamPitch, interpolation);
+                        grainCloud.add(region.offset + streamStart, length, streamPitch, envelopeParams, startDelay, streamPan, stream.level);
+                    }
+                    else
+                        grains.emplace_back(arena->getRegionData(grainFile), region.length, streamStart, thisGrainSize, streamPitch,
+                                            envelopeParams, interpolation, startDelay, kernelKeyFor(streamPitch), streamPan, stream.level, grainLoop);
+                }
             }
+            samplesUntilNextGrain = juce::jmax(1, juce::roundToInt(interval));
         }
-        outputCounter++;
+        samplesUntilNextGrain--;
+        startSampleInFile++;
     }
+    if (tracer != nullptr && getNumGrains() > grainsBeforeSpawn)
+        tracer->addSpan("grain spawn", spawnStart, TraceRecorder::now(), getNumGrains() - grainsBeforeSpawn);
     
-    auto tempOutBufferReadPtr = tempOutBuffer.getReadPointer(0);
-    auto* channelData = bufferToFill.getWritePointer(0);
-    
-    for (int i = 0; i < bufferToFill.getNumSamples(); i++)
+    //playback, grains spawned under older settings keep their own kernel
+    for (auto& g : grains)
+    {
+        auto render = g.getKernelKey() == kernelKey ? blockRender
+                                                    : GrainKernels::getRenderFunction(g.getKernelKey(), numChannels);
+        g.processGrain(render, tempOutBuffer);
+    }
+    for (auto& c : cachedGrains)
     {
-        if (tempOutBufferReadPtr[i] > 0.99)
-            channelData[i] += 0.99 * gain;
-        else
-            channelData[i] += tempOutBufferReadPtr[i] * gain;
+        int offset = juce::jmin(c.startDelay, numSamples);
+        c.startDelay -= offset;
+        int samplesToMix = juce::jmin(c.entry->getLength() - c.position, numSamples - offset);
+        for (int channel = 0; channel < numChannels && samplesToMix > 0; channel++)
+            juce::FloatVectorOperations::addWithMultiply(tempOutBuffer.getWritePointer(channel, offset), c.entry->getSamples() + c.position,
+                                                         numChannels > 1 ? c.gains[channel] : GrainKernels::getMonoGain(c.gains), samplesToMix);
+        c.position += juce::jmax(0, samplesToMix);
+    }
+    grainCloud.render(static_cast<const float*>(arena->getStorage()), tempOutBuffer, numSamples);
+    spectralGrains.render(tempOutBuffer, numSamples, sharedScratch != nullptr ? *sharedScratch : ownScratch);
     
-        if (startSampleInFile > (fileBuffer.getNumSamples() - 2)){
-            startSampleInFile = 0;
-        }
-        if ((startSampleInFile % (grainSize - grainOverlap)) == 0)
+    //delete finished grains
+    grains.erase(std::remove_if(grains.begin(), grains.end(), [](Grain& g) { return g.isFinished(); }),
+                 grains.end());
+    cachedGrains.erase(std::remove_if(cachedGrains.begin(), cachedGrains.end(),
+                                      [](const CachedGrain& c) { return c.position >= c.entry->getLength(); }),
+                       cachedGrains.end());
+    outputCounter += numSamples;
+    
+    if (envelopeEngaged)
+    {
+        amplitudeEnvelope.applyEnvelopeToBuffer(tempOutBuffer, 0, numSamples);
+        
+        float peak = 0.0f;
+        for (int channel = 0; channel < numChannels; channel++)
+            peak = juce::jmax(peak, tempOutBuffer.getMagnitude(channel, 0, numSamples));
+        lastPeak = peak * gain;
+        
+        //a released voice is done once its output stays below the threshold for a whole grain period
+        if (released)
         {
-            Grain newGrain(fileBuffer, startSampleInFile, grainSize, pitchShiftFactor);
-            grains.push_back(newGrain);
-//            DBG("new grain added at "<< startSampleInFile);
+            silentSamples = lastPeak < silenceThreshold ? silentSamples + numSamples : 0;
+            if (! amplitudeEnvelope.isActive() || silentSamples > juce::jmax(grainSpacing, grainSize - grainOverlap))
+            {
+                retired = true;
+                grains.clear();
+                grainCloud.clear();
+                cachedGrains.clear();
+                spectralGrains.reset();
+            }
         }
-        startSampleInFile++;
     }
+    
+    for (int channel = 0; channel < numChannels; channel++)
+        SimdKernels::get().addClipped(bufferToFill.getWritePointer(channel), tempOutBuffer.getReadPointer(channel),
+                                      0.99f, gain, numSamples);
+}
+
+void GranSynth::spawnLiveGrain(int startDelay, int length, float pitch, float positionOffset, int delayOffset, float pan, float level, int kernelKey)
+{
+    //reads stay an interpolator span behind the newest input and clear of the next block overwriting the oldest;
+    //position modulation moves the delay across the whole ring
+    int minimumAge = GrainKernels::getSamplesAfter(interpolation) + 1;
+    int maximumAge = liveInput->getSize() - liveInput->getMaximumBlockSize() - GrainKernels::getSamplesBefore(interpolation) - 1;
+    int delay = juce::jlimit(minimumAge, maximumAge, liveDelay - delayOffset - juce::roundToInt(positionOffset * maximumAge));
+    bool frozen = liveInput->isFrozen();
+    
+    //a spectral grain reads its whole frame when it starts, so all of it has to be in the ring by then
+    if (grainMode == GrainMode::spectral)
+    {
+        delay = juce::jlimit(juce::jmin(SpectralGrains::getSizeFor(length), maximumAge), maximumAge, delay);
+        auto startPosition = liveInput->getBlockStart() + (frozen ? 0 : startDelay) - delay;
+        spectralGrains.addLiveGrain(*liveInput, startPosition, length, pitch, pan, level, startDelay);
+        return;
+    }
+    
+    //the input moves on one sample per sample unless frozen, a grain reading faster or slower drifts
+    //towards one of the limits, so it is cut short before it gets there
+    double drift = (frozen ? 0.0 : 1.0) - pitch;
+    if (drift < 0.0)
+        length = juce::jmin(length, (int)((delay - minimumAge) / -drift) + 1);
+    else if (drift > 0.0)
+        length = juce::jmin(length, (int)((maximumAge - delay) / drift) + 1);
+    
+    auto startPosition = liveInput->getBlockStart() + (frozen ? 0 : startDelay) - delay;
+    grains.emplace_back(*liveInput, startPosition, length, pitch, envelopeParams, startDelay, kernelKey, pan, level);
+}
+
+int GranSynth::getGrainPositions(int* positions, int maxPositions) const
+{
+    //live grains have no place in the file overview, grains still waiting to start are left out too
+    auto storage = static_cast<const char*>(arena->getStorage());
+    int bytesPerSample = SampleArena::getBytesPerSample(arena->getFormat());
+    int numPositions = 0;
+    
+    for (auto& g : grains)
+    {
+        const auto& state = g.getState();
+        if (numPositions == maxPositions)
+            break;
+        if (state.ringMask != 0 || state.startDelay > 0 || g.isInSeam())
+            continue;
+        
+        auto sourceOffset = (static_cast<const char*>(state.source) - storage) / bytesPerSample;
+        positions[numPositions++] = (int)sourceOffset + (int)state.readPosition;
+    }
+    
+    for (auto& c : cachedGrains)
+    {
+        if (numPositions == maxPositions)
+            break;
+        if (c.startDelay == 0)
+            positions[numPositions++] = c.entry->getArenaStart() + (int)((float)c.position * c.entry->getPitch());
+    }
+    
+    return numPositions + grainCloud.getGrainPositions(positions + numPositions, maxPositions - numPositions);
 }
 
 void GranSynth::setGrainsParams(int newGrainSize, int newGrainOverlap, int newGrainSpacing, float newPitchShiftFactor){
     
-    grainSize = newGrainSize;
-    grainOverlap = newGrainOverlap;
-    grainSpacing = newGrainSpacing;
+    setGrainParameters(newGrainSize, newGrainOverlap, newGrainSpacing);
     pitchShiftFactor = newPitchShiftFactor;
     
 }
+
+void GranSynth::setGrainParameters(int newGrainSize, int newGrainOverlap, int newGrainSpacing){
+    
+    //an overlap of the whole grain or more would leave no time between grains, the densest is one per sample
+    grainSize = juce::jmax(1, newGrainSize);
+    grainOverlap = juce::jlimit(0, grainSize - 1, newGrainOverlap);
+    grainSpacing = juce::jmax(1, newGrainSpacing);
+    
+}
+
+void GranSynth::setEnvelopeParams(GrainEnvelope::Shape newShape, float newAttackPercent, float newReleasePercent){
+    
+    envelopeParams.shape = newShape;
+    envelopeParams.attackPercent = newAttackPercent;
+    envelopeParams.releasePercent = newReleasePercent;
+    
+}
+
+void GranSynth::setInterpolation(GrainKernels::Interpolation newInterpolation){
+    
+    interpolation = newInterpolation;
+    
+}
+
+void GranSynth::setSampleIndex(SampleIndex::Ptr newSampleIndex){
+    
+    replaceShared(sampleIndex, newSampleIndex.get());
+    
+}
+
+void GranSynth::setSnapMode(SampleIndex::SnapMode newSnapMode){
+    
+    snapMode = newSnapMode;
+    
+}
+
+void GranSynth::setGrainSource(GrainSource newGrainSource){
+    
+    grainSource = newGrainSource;
+    
+}
+
+void GranSynth::setGrainMode(GrainMode newGrainMode){
+    
+    grainMode = newGrainMode;
+    
+}
+
+void GranSynth::setSpectralParams(const SpectralGrains::Parameters& newParameters){
+    
+    spectralGrains.setParameters(newParameters);
+    
+}
+
+void GranSynth::setUnison(const Unison& newUnison){
+    
+    if (newUnison.streams == unison.streams && newUnison.detuneCents == unison.detuneCents
+        && newUnison.positionSpread == unison.positionSpread && newUnison.stereoSpread == unison.stereoSpread)
+        return;
+    
+    unison = newUnison;
+    unison.streams = juce::jlimit(1, maxUnisonStreams, unison.streams);
+    
+    //evenly spaced from -1 to 1; pans are rotated by half the streams, so sharp and flat streams sit on both sides
+    auto spreadOf = [this](int s) { return unison.streams > 1 ? 2.0f * (float)s / (float)(unison.streams - 1) - 1.0f : 0.0f; };
+    for (int s = 0; s < unison.streams; s++)
+    {
+        auto& stream = unisonStreams[(size_t)s];
+        stream.pitch = std::exp2(spreadOf(s) * unison.detuneCents / 1200.0f);
+        stream.offset = juce::roundToInt(spreadOf(s) * (float)unison.positionSpread);
+        stream.pan = spreadOf((s + unison.streams / 2) % unison.streams) * juce::jlimit(0.0f, 1.0f, unison.stereoSpread);
+        stream.level = 1.0f / std::sqrt((float)unison.streams);
+    }
+    
+}
+
+void GranSynth::setTracer(TraceRecorder* newTracer){
+    
+    tracer = newTracer;
+    
+}
+
+void GranSynth::setRenderCache(GrainRenderCache* newRenderCache){
+    
+    renderCache = newRenderCache;
+    
+}
+
+void GranSynth::setReleaseQueue(ReleaseQueue* newReleaseQueue){
+    
+    releaseQueue = newReleaseQueue;
+    
+}
+
+void GranSynth::setCorpus(GrainCorpus::Ptr newCorpus){
+    
+    replaceShared(corpus, newCorpus.get());
+    corpusMatchesNeedUpdate = true;
+    
+}
+
+void GranSynth::setLoopSeams(LoopSeams::Ptr newLoopSeams){
+    
+    //looped grains read the old seams, they can't outlive them
+    if (newLoopSeams != loopSeams)
+        grains.clear();
+    replaceShared(loopSeams, newLoopSeams.get());
+    
+}
+
+void GranSynth::setCorpusTarget(float midiNote, float velocity){
+    
+    corpusTarget = GrainCorpus::Target::fromNote(midiNote, velocity);
+    corpusMatchesNeedUpdate = true;
+    
+}
+
+void GranSynth::setModulationParams(const ModulationEngine::Parameters& newParameters){
+    
+    modulation.setParameters(newParameters);
+    
+}
+
+void GranSynth::startNote(float midiNote, float velocity){
+    
+    setCorpusTarget(midiNote, velocity);
+    modulation.noteOn(midiNote, velocity);
+    amplitudeEnvelope.reset();
+    amplitudeEnvelope.noteOn();
+    envelopeEngaged = true;
+    
+}
+
+void GranSynth::setAmplitudeEnvelope(const juce::ADSR::Parameters& newParameters){
+    
+    amplitudeEnvelope.setParameters(newParameters);
+    
+}
+
+void GranSynth::setReleased(){
+    
+    released = true;
+    amplitudeEnvelope.noteOff();
+    modulation.noteOff();
+    
+}
+
+void GranSynth::setSourceFile(int newSourceFile){
+    
+    sourceFile = newSourceFile;
+    
+}
+
+void GranSynth::setRandomSourcePerGrain(bool shouldPickPerGrain){
+    
+    randomSourcePerGrain = shouldPickPerGrain;
+    
+}
+
+void GranSynth::setLiveInput(const LiveInputBuffer* newLiveInput){
+    
+    liveInput = newLiveInput;
+    
+}
+
+void GranSynth::setLiveDelay(int newLiveDelay){
+    
+    liveDelay = newLiveDelay;
+    
+}
+
+void GranSynth::setMaxGrains(int newMaxGrains){
+    
+    maxGrains = newMaxGrains;
+    
+}
@@ -10,6 +10,20 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "GrainEnvelope.h"
+#include "GrainKernels.h"
+#include "SampleIndex.h"
+#include "GrainCorpus.h"
+#include "SampleArena.h"
+#include "ModulationEngine.h"
+#include "LiveInputBuffer.h"
+#include "SpectralGrains.h"
+#include "GrainCloud.h"
+#include "ScratchArena.h"
+#include "LoopSeams.h"
+#include "TraceRecorder.h"
+#include "GrainRenderCache.h"
+#include "ReleaseQueue.h"
 #define PI 3.141592654
 
 
@@ -17,29 +31,40 @@ class Grain
 {
 public:
     
-    Grain(const juce::AudioBuffer<float>& fileBuffer, int startsample,
-          int grainSize, float pitchShiftFactor);
+    Grain(const void* sourceData, int sourceLength, int startsample,
+          int grainSize, float pitchShiftFactor,
+          const GrainEnvelope::Parameters& envelopeParams,
+          GrainKernels::Interpolation interpolation,
+          int startDelay, int kernelKey, float pan = 0.0f, float level = 1.0f,
+          const LoopSeams::Seam* loop = nullptr);
+    //reads the live input ring from a running position, wrapping around its end
+    Grain(const LiveInputBuffer& liveInput, juce::int64 startPosition,
+          int grainSize, float pitchShiftFactor,
+          const GrainEnvelope::Parameters& envelopeParams,
+          int startDelay, int kernelKey, float pan = 0.0f, float level = 1.0f);
     ~Grain();
-    void processGrain(juce::AudioBuffer<float>& systemBuffer,
-                      int startSampleInOutput, float gain);
-    int getCurrentPosition(){return currentPosition;}
+    //shortens a file grain so the interpolator never reads outside the file, moving its start clear of the beginning
+    static int fitToFile(int sourceLength, int& startSample, int grainSize, float pitchShiftFactor,
+                         GrainKernels::Interpolation interpolation);
+    //renders the part of the grain that falls inside this block
+    void processGrain(GrainKernels::RenderFunction render,
+                      juce::AudioBuffer<float>& systemBuffer);
+    int getKernelKey() const { return state.kernelKey; }
+    const GrainState& getState() const { return state; }
+    //true while the grain reads a loop's crossfade rather than its file
+    bool isInSeam() const { return inSeam; }
     bool isFinished();
     
-    inline std::vector<float> createHanningWindow(int size)
-    {
-        std::vector<float> window(size);
-        for (int i = 0; i < size; i++)
-        {
-            window[i] = 0.5f * (1 - std::cos(2*PI*i/(size - 1)));
-        }
-        return window;
-    }
-    
 private:
-    juce::AudioBuffer<float> grainAudioData;
-    int size;
-    float pitchShiftFactor;
-    int currentPosition = 0; //the position inside grain size
+    void start(int length, const GrainEnvelope::Parameters& envelopeParams, int startDelay, int kernelKey, float pan, float level);
+    void crossSeam();
+    
+    GrainState state;
+    //grains starting inside a loop play their whole length, wrapping through its seam
+    bool looping = false;
+    bool inSeam = false;
+    LoopSeams::Seam seam;
+    const void* fileSource = nullptr;
     // Add any other members if warranted
 };
 
@@ -53,12 +78,92 @@ class GranSynth
 {
 public:
     
+    enum class GrainSource
+    {
+        filePosition = 0, // grains follow a read position moving through the file
+        corpus,           // grains start on the corpus frames closest to the note
+        liveInput         // grains read the live input a delay behind what is coming in
+    };
+    
+    enum class GrainMode
+    {
+        time = 0, // grains resample their source
+        spectral  // grains are resynthesised from their spectrum under a Hann window, see SpectralGrains
+    };
+    
+    //streams of grains a voice spawns together, spread around the grain it would play alone, each one
+    //quieter so that together they sound about as loud as the single grain
+    struct Unison
+    {
+        int streams = 1;           //1 to maxUnisonStreams
+        float detuneCents = 0.0f;  //of the outermost streams, the others are spaced evenly in between
+        int positionSpread = 0;    //samples, likewise
+        float stereoSpread = 0.0f; //0 to 1 of the pan range
+    };
+    
+    static constexpr int maxUnisonStreams = 16;
+    //the note that plays a sample at its original pitch, A3 as the editor says
+    static constexpr int rootNote = 57;
+    
     GranSynth(juce::AudioBuffer<float>& audioFileBuffer);
+    GranSynth(SampleArena::Ptr sampleArena);
+    //a voice playing one note, its grains are pitched from rootNote
+    GranSynth(SampleArena::Ptr sampleArena, double frequency, float velocity);
     ~GranSynth();
     
+    //allocates everything processBlock needs for blocks up to samplesPerBlock, longer blocks are rendered in pieces
+    void prepareToPlay(double sampleRate, int samplesPerBlock);
+    //scratch a voice keeps for a whole block of up to samplesPerBlock, not counting what it hands back within the block
+    static size_t getBlockScratchBytes(int samplesPerBlock);
+    //working memory shared with other voices and reset by the owner at every block; without one the synth uses its own
+    void setScratchArena(ScratchArena* newScratch);
+    //preallocates room for this many grains, none are ever spawned past it
+    void reserveGrains(int capacity);
+    //makes a prepared voice play a new note, dropping whatever it was playing; never allocates
+    void startVoice(SampleArena::Ptr newArena, double newFrequency, float velocity);
     void releaseResources();
     void processBlock(juce::AudioBuffer<float>& outputBuffer);
     void setGrainsParams(int newGrainSize, int newGrainOverlap, int newGrainSpacing, float newPitchShiftFactor);
+    void setGrainParameters(int newGrainSize, int newGrainOverlap, int newGrainSpacing);
+    void setEnvelopeParams(GrainEnvelope::Shape newShape, float newAttackPercent, float newReleasePercent);
+    void setInterpolation(GrainKernels::Interpolation newInterpolation);
+    void setSampleIndex(SampleIndex::Ptr newSampleIndex);
+    void setSnapMode(SampleIndex::SnapMode newSnapMode);
+    void setGrainSource(GrainSource newGrainSource);
+    void setGrainMode(GrainMode newGrainMode);
+    void setSpectralParams(const SpectralGrains::Parameters& newParameters);
+    void setUnison(const Unison& newUnison);
+    //records a span for every block that spawns grains, null turns it off
+    void setTracer(TraceRecorder* newTracer);
+    //repeated time-domain file grains play from the cache once it has rendered them, null renders every grain
+    void setRenderCache(GrainRenderCache* newRenderCache);
+    //replaced arenas, indexes, corpora and seams are dropped by the queue's thread, null drops them on the spot
+    void setReleaseQueue(ReleaseQueue* newReleaseQueue);
+    void setCorpus(GrainCorpus::Ptr newCorpus);
+    //loops every file of the arena the seams were built for, dropping the grains playing
+    void setLoopSeams(LoopSeams::Ptr newLoopSeams);
+    void setCorpusTarget(float midiNote, float velocity);
+    void setModulationParams(const ModulationEngine::Parameters& newParameters);
+    //corpus target and modulation follow the note, and the amplitude envelope starts
+    void startNote(float midiNote, float velocity);
+    void setAmplitudeEnvelope(const juce::ADSR::Parameters& newParameters);
+    void setReleased();
+    //true once a released voice has gone silent, its grains are already dropped
+    bool shouldBeRemoved() const { return retired; }
+    double getFreq() const { return frequency; }
+    SampleArena::Ptr getArena() const { return arena; }
+    bool isReleased() const { return released; }
+    //peak of the last block's output after the amplitude envelope and gain, for picking a voice to steal
+    float getLastPeak() const { return lastPeak; }
+    void setSourceFile(int newSourceFile);
+    void setRandomSourcePerGrain(bool shouldPickPerGrain);
+    void setLiveInput(const LiveInputBuffer* newLiveInput);
+    void setLiveDelay(int newLiveDelay);
+    //grains that would go over the cap are skipped, thinning the cloud
+    void setMaxGrains(int newMaxGrains);
+    int getNumGrains() const { return (int)grains.size() + (int)cachedGrains.size() + grainCloud.getNumGrains() + spectralGrains.getNumGrains(); }
+    //arena positions of the file grains sounding at the end of the last block, returns how many were written
+    int getGrainPositions(int* positions, int maxPositions) const;
     
     void saveOutput(juce::AudioBuffer<float>& buffer)
     {
@@ -83,13 +188,85 @@ public:
     }
     
 private:
+    void renderBlock(juce::AudioBuffer<float>& bufferToFill, juce::AudioBuffer<float>& tempOutBuffer);
+    void spawnLiveGrain(int startDelay, int length, float pitch, float positionOffset, int delayOffset, float pan, float level, int kernelKey);
+    
+    //points ptr at newObject, the object it lets go of goes to the release queue if there is one
+    template <typename Object>
+    void replaceShared(juce::ReferenceCountedObjectPtr<Object>& ptr, Object* newObject)
+    {
+        if (ptr == newObject)
+            return;
+        if (releaseQueue != nullptr)
+            releaseQueue->retire(ptr);
+        ptr = newObject;
+    }
+    
+    struct UnisonStream
+    {
+        float pitch = 1.0f;
+        int offset = 0;
+        float pan = 0.0f;
+        float level = 1.0f; //1/sqrt(streams), so the streams together sound about as loud as one
+    };
+    
+    //a waveform from the render cache, mixed in as it is
+    struct CachedGrain
+    {
+        GrainRenderCache::Entry::Ptr entry;
+        int position = 0;
+        int startDelay = 0;
+        float gains[2] = { 1.0f, 1.0f };
+    };
+    
     int fileVar = 0;
-    juce::AudioBuffer<float> fileBuffer;
+    SampleArena::Ptr arena; //grains point straight into it, only replaced by startVoice once they are gone
+    int sourceFile = 0; //region of the arena this synth plays
+    bool randomSourcePerGrain = false;
+    juce::Random random;
     std::vector<Grain> grains; // Vector to manage grains
-    int grainSize, grainOverlap, grainSpacing;
-    float pitchShiftFactor;
+    GrainCloud grainCloud; //short grains of dense clouds and unison streams, rendered side by side
+    std::vector<CachedGrain> cachedGrains;
+    GrainRenderCache* renderCache = nullptr; //shared by the voices of an engine
+    ReleaseQueue* releaseQueue = nullptr; //owned by the engine, like the render cache
+    Unison unison;
+    std::array<UnisonStream, maxUnisonStreams> unisonStreams; //worked out from unison when it changes
+    int maxGrains = std::numeric_limits<int>::max();
+    int grainCapacity = std::numeric_limits<int>::max();
+    ScratchArena ownScratch; //sized in prepareToPlay unless a shared arena was set
+    ScratchArena* sharedScratch = nullptr;
+    TraceRecorder* tracer = nullptr;
+    int maxBlockSize = 512;
+    int grainSize = 2205, grainOverlap = 0, grainSpacing = 1;
+    float pitchShiftFactor = 1.0f;
+    double frequency = 0.0;
+    float notePitch = 1.0f; //playback rate of the note, corpus grains carry their own tuning instead
+    GrainEnvelope::Parameters envelopeParams;
+    GrainKernels::Interpolation interpolation = GrainKernels::Interpolation::linear;
+    SampleIndex::Ptr sampleIndex; //built in the background after loading, may still be null
+    SampleIndex::SnapMode snapMode = SampleIndex::SnapMode::off;
+    GrainSource grainSource = GrainSource::filePosition;
+    GrainMode grainMode = GrainMode::time;
+    SpectralGrains spectralGrains;
+    GrainCorpus::Ptr corpus; //built in the background after loading, may still be null
+    LoopSeams::Ptr loopSeams; //ignored unless built for this arena; grains point into it
+    GrainCorpus::Target corpusTarget = GrainCorpus::Target::fromNote(57.0f, 0.8f);
+    GrainCorpus::Matches corpusMatches;
+    bool corpusMatchesNeedUpdate = true;
+    int nextCorpusMatch = 0;
+    const LiveInputBuffer* liveInput = nullptr; //owned by whoever feeds it the input
+    int liveDelay = 4410; //samples behind the input
+    ModulationEngine modulation;
+    juce::ADSR amplitudeEnvelope;
+    bool envelopeEngaged = false; //only voices started by a note use the amplitude envelope
+    bool released = false;
+    bool retired = false;
+    int silentSamples = 0;
+    float lastPeak = 0.0f;
+    static constexpr float silenceThreshold = 1.0e-4f; // -80 dB
     int startSampleInFile = 0;
-    int outputCounter = 0;
+    int samplesUntilNextGrain = 0;
+    juce::int64 outputCounter = 0;
     float gain = 1;
     
 };
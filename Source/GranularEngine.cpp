@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    GranularEngine.cpp
+    Created: 23 Oct 2026 7:02:36pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "GranularEngine.h"
+
+GranularEngine::GranularEngine()
+    : emptyArena(SampleArena::fromBuffer({}))
+{
+}
+
+void GranularEngine::prepare(int maxBlockSize, double sampleRate, int newMaxGrains, int maxVoices)
+{
+    maxGrains = juce::jmax(1, newMaxGrains);
+    numActiveVoices = 0;
+
+    //room for every voice's block buffers at once, the spectral workspace is handed back by whichever voice used it
+    maxVoices = juce::jmax(1, maxVoices);
+    scratch.prepare((size_t)maxVoices * GranSynth::getBlockScratchBytes(maxBlockSize) + SpectralGrains::getScratchBytes());
+    grainCache.prepare();
+
+    //every voice can hold the whole grain budget, render shares it out between the ones sounding
+    voices.clear();
+    for (int i = 0; i < maxVoices; i++)
+    {
+        voices.push_back(std::make_unique<GranSynth>(emptyArena));
+        voices.back()->setScratchArena(&scratch);
+        voices.back()->setTracer(tracer);
+        voices.back()->setReleaseQueue(&releaseQueue);
+        voices.back()->prepareToPlay(sampleRate, maxBlockSize);
+        voices.back()->reserveGrains(maxGrains);
+    }
+}
+
+void GranularEngine::setSource(SampleArena::Ptr newArena, SampleIndex::Ptr newSampleIndex, GrainCorpus::Ptr newCorpus,
+                               LoopSeams::Ptr newLoopSeams)
+{
+    if (tracer != nullptr && newArena != arena)
+        tracer->addInstant("source swap", newArena != nullptr ? newArena->getNumRegions() : 0);
+    
+    //analysis finishing after a note started reaches the voices already playing the arena it was built for
+    if (newArena != nullptr && newSampleIndex != sampleIndex)
+        for (int v = 0; v < numActiveVoices; v++)
+            if (voices[(size_t)v]->getArena() == newArena)
+                voices[(size_t)v]->setSampleIndex(newSampleIndex);
+    
+    //the loader may already have let go of the old ones, they must not be freed here
+    if (newArena != arena)
+        releaseQueue.retire(arena);
+    if (newSampleIndex != sampleIndex)
+        releaseQueue.retire(sampleIndex);
+    if (newCorpus != corpus)
+        releaseQueue.retire(corpus);
+    if (newLoopSeams != loopSeams)
+        releaseQueue.retire(loopSeams);
+    
+    arena = newArena;
+    grainCache.setArena(arena.get());
+    sampleIndex = newSampleIndex;
+    corpus = newCorpus;
+    loopSeams = newLoopSeams;
+}
+
+void GranularEngine::setTracer(TraceRecorder* newTracer)
+{
+    tracer = newTracer;
+    for (auto& voice : voices)
+        voice->setTracer(tracer);
+}
+
+void GranularEngine::render(float* const* output, int numChannels, int numSamples, const Event* events, int numEvents)
+{
+    TraceRecorder::Span renderSpan(tracer, "engine render", numSamples);
+    scratch.reset();
+
+    for (int channel = 0; channel < numChannels; channel++)
+        juce::FloatVectorOperations::clear(output[channel], numSamples);
+
+    for (int i = 0; i < numEvents; i++)
+    {
+        TraceRecorder::Span eventSpan(tracer, events[i].type == Event::Type::noteOn ? "note on"
+                                            : events[i].type == Event::Type::noteOff ? "note off" : "all notes off", events[i].note);
+        switch (events[i].type)
+        {
+            case Event::Type::noteOn:
+                noteOn(events[i].note, events[i].velocity);
+                break;
+            case Event::Type::noteOff:
+                noteOff(events[i].note);
+                break;
+            case Event::Type::allNotesOff:
+                for (int v = 0; v < numActiveVoices; v++)
+                    voices[(size_t)v]->setReleased();
+                break;
+        }
+    }
+
+    //voices retire themselves once their release has gone silent, the rest keep their order
+    int kept = 0;
+    for (int v = 0; v < numActiveVoices; v++)
+        if (! voices[(size_t)v]->shouldBeRemoved())
+            std::swap(voices[(size_t)kept++], voices[(size_t)v]);
+    numActiveVoices = kept;
+
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    int voiceGrainCap = juce::jmax(1, juce::jmin(grainCap, maxGrains) / juce::jmax(1, numActiveVoices));
+
+    //refers to the host's channels, nothing is allocated for it
+    juce::AudioBuffer<float> buffer(output, numChannels, numSamples);
+
+    for (int v = 0; v < numActiveVoices; v++)
+    {
+        TraceRecorder::Span voiceSpan(tracer, "voice render", v);
+        auto& voice = *voices[(size_t)v];
+        voice.setMaxGrains(voiceGrainCap);
+        voice.setGrainParameters(parameters.grainSize, parameters.grainOverlap, parameters.grainSpacing);
+        voice.setAmplitudeEnvelope(parameters.amplitudeEnvelope);
+        voice.setEnvelopeParams(parameters.grainEnvelope.shape, parameters.grainEnvelope.attackPercent,
+                                parameters.grainEnvelope.releasePercent);
+        voice.setInterpolation(parameters.interpolation);
+        voice.setSnapMode(parameters.snapMode);
+        voice.setGrainSource(parameters.grainSource);
+        voice.setGrainMode(parameters.grainMode);
+        voice.setSpectralParams(parameters.spectral);
+        voice.setUnison(parameters.unison);
+        voice.setModulationParams(parameters.modulation);
+        voice.setLiveDelay(parameters.liveDelay);
+        voice.setRenderCache(parameters.cacheGrains ? &grainCache : nullptr);
+        voice.processBlock(buffer);
+    }
+}
+
+int GranularEngine::getNumGrains() const noexcept
+{
+    int numGrains = 0;
+    for (int v = 0; v < numActiveVoices; v++)
+        numGrains += voices[(size_t)v]->getNumGrains();
+    return numGrains;
+}
+
+int GranularEngine::getGrainPositions(int* positions, int maxPositions) const
+{
+    int numPositions = 0;
+    for (int v = 0; v < numActiveVoices && numPositions < maxPositions; v++)
+        numPositions += voices[(size_t)v]->getGrainPositions(positions + numPositions, maxPositions - numPositions);
+    return numPositions;
+}
+
+void GranularEngine::noteOn(int note, float velocity)
+{
+    // a note still in its release tail can be played again, that voice just finishes on its own
+    double frequency = juce::MidiMessage::getMidiNoteInHertz(note);
+    for (int v = 0; v < numActiveVoices; v++)
+        if (voices[(size_t)v]->getFreq() == frequency && ! voices[(size_t)v]->isReleased())
+            return;
+
+    // Live grains read the input, a voice can start before any file is loaded
+    auto noteArena = arena;
+    if (noteArena == nullptr && parameters.grainSource == GranSynth::GrainSource::liveInput)
+        noteArena = emptyArena;
+
+    if (noteArena == nullptr)
+        return;
+
+    // With every voice taken, the quietest one in its release tail makes way; held notes are never cut
+    if (numActiveVoices >= juce::jmin((int)voices.size(), voiceCap))
+    {
+        int quietest = -1;
+        for (int v = 0; v < numActiveVoices; v++)
+            if (voices[(size_t)v]->isReleased()
+                && (quietest < 0 || voices[(size_t)v]->getLastPeak() < voices[(size_t)quietest]->getLastPeak()))
+                quietest = v;
+
+        if (quietest < 0)
+            return;
+
+        if (tracer != nullptr)
+            tracer->addInstant("voice steal", quietest);
+
+        //the stolen voice moves to the end, where the new note starts, so the rest keep their order
+        std::rotate(voices.begin() + quietest, voices.begin() + quietest + 1, voices.begin() + numActiveVoices);
+        numActiveVoices--;
+    }
+
+    auto& voice = *voices[(size_t)numActiveVoices++];
+    voice.startVoice(noteArena, frequency, velocity);
+    voice.setGrainParameters(parameters.grainSize, parameters.grainOverlap, parameters.grainSpacing);
+    voice.setEnvelopeParams(parameters.grainEnvelope.shape, parameters.grainEnvelope.attackPercent,
+                            parameters.grainEnvelope.releasePercent);
+    voice.setInterpolation(parameters.interpolation);
+    voice.setSnapMode(parameters.snapMode);
+    voice.setGrainSource(parameters.grainSource);
+    voice.setGrainMode(parameters.grainMode);
+    voice.setSpectralParams(parameters.spectral);
+    voice.setUnison(parameters.unison);
+    voice.setModulationParams(parameters.modulation);
+    voice.setAmplitudeEnvelope(parameters.amplitudeEnvelope);
+    voice.startNote((float)note, velocity);
+    voice.setSampleIndex(sampleIndex);
+    voice.setCorpus(corpus);
+    voice.setLoopSeams(loopSeams);
+    voice.setLiveInput(liveInput);
+    voice.setLiveDelay(parameters.liveDelay);
+    voice.setRenderCache(parameters.cacheGrains ? &grainCache : nullptr);
+
+    if (parameters.sourceFileSelect == SourceFileSelect::byNote && noteArena->getNumRegions() > 0)
+        voice.setSourceFile(note % noteArena->getNumRegions());
+    else
+        voice.setSourceFile(parameters.sourceFile);
+    voice.setRandomSourcePerGrain(parameters.sourceFileSelect == SourceFileSelect::perGrain);
+}
+
+void GranularEngine::noteOff(int note)
+{
+    double frequency = juce::MidiMessage::getMidiNoteInHertz(note);
+    for (int v = 0; v < numActiveVoices; v++)
+        if (voices[(size_t)v]->getFreq() == frequency)
+            voices[(size_t)v]->setReleased();
+}
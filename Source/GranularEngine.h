@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    GranularEngine.h
+    Created: 23 Oct 2026 7:02:36pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "GranSynth.h"
+
+
+// The polyphonic engine behind the plugin, free of any plugin or GUI class so
+// other hosts can embed it: an offline renderer, a server, a test harness.
+// Every voice and grain slot is allocated in prepare; after that, render, the
+// note events and every setter run without allocating, on whatever thread
+// the host renders from. Temporary buffers all come from one scratch arena.
+// Repetitive patches can have their grains rendered once, by a background
+// thread, and mixed from the grain cache after that.
+class GranularEngine
+{
+public:
+
+    enum class SourceFileSelect
+    {
+        fixed = 0,
+        byNote,
+        perGrain
+    };
+
+    // Everything a host controls between renders, sizes in samples
+    struct Parameters
+    {
+        int grainSize = 2205;
+        int grainOverlap = 0;
+        int grainSpacing = 2205;
+        GrainEnvelope::Parameters grainEnvelope;
+        GrainKernels::Interpolation interpolation = GrainKernels::Interpolation::linear;
+        SampleIndex::SnapMode snapMode = SampleIndex::SnapMode::off;
+        GranSynth::GrainSource grainSource = GranSynth::GrainSource::filePosition;
+        GranSynth::GrainMode grainMode = GranSynth::GrainMode::time;
+        SpectralGrains::Parameters spectral;
+        GranSynth::Unison unison;
+        int sourceFile = 0;
+        SourceFileSelect sourceFileSelect = SourceFileSelect::fixed;
+        ModulationEngine::Parameters modulation;
+        juce::ADSR::Parameters amplitudeEnvelope;
+        int liveDelay = 4410;
+        bool cacheGrains = false; // repeated grains play back what the grain cache rendered
+    };
+
+    struct Event
+    {
+        enum class Type
+        {
+            noteOn = 0,
+            noteOff,
+            allNotesOff
+        };
+
+        Type type = Type::noteOn;
+        int note = 60;
+        float velocity = 1.0f;
+    };
+
+    GranularEngine();
+
+    // Allocates the voices, their grains and their buffers, dropping anything playing
+    void prepare(int maxBlockSize, double sampleRate, int maxGrains, int maxVoices);
+
+    // Applied to every voice from the next render on
+    void setParameters(const Parameters& newParameters) { parameters = newParameters; }
+    const Parameters& getParameters() const noexcept { return parameters; }
+
+    // What notes started from now on play; voices already sounding keep theirs, but pick up
+    // a sample index built for the arena they play once it arrives
+    void setSource(SampleArena::Ptr newArena, SampleIndex::Ptr newSampleIndex, GrainCorpus::Ptr newCorpus,
+                   LoopSeams::Ptr newLoopSeams = nullptr);
+
+    // Owned by the host and outliving the engine; records renders, voices, note events and source swaps
+    void setTracer(TraceRecorder* newTracer);
+
+    // Owned by the host, which writes it before every render
+    void setLiveInput(const LiveInputBuffer* newLiveInput) { liveInput = newLiveInput; }
+
+    // Limits below the prepared maximums, e.g. from a CPU governor; the grain cap is shared out between the voices
+    void setGrainCap(int newGrainCap) { grainCap = newGrainCap; }
+    void setVoiceCap(int newVoiceCap) { voiceCap = newVoiceCap; }
+
+    // Applies the events at the start of the block, then writes the voices over
+    // the first two of numChannels output channels; any further channels are cleared
+    void render(float* const* output, int numChannels, int numSamples, const Event* events, int numEvents);
+
+    // Silences every voice at once
+    void reset() noexcept { numActiveVoices = 0; }
+
+    // Sources and voices replaced on the audio thread leave their old arenas, indexes, corpora and
+    // seams to this, so the last reference is never dropped inside a render. Call it from one other
+    // thread every so often, e.g. a timer on the message thread
+    void releasePending() { releaseQueue.releasePending(); }
+
+    int getNumVoices() const noexcept { return numActiveVoices; }
+    int getNumGrains() const noexcept;
+    // Arena positions of the file grains that sounded in the last render, returns how many were written
+    int getGrainPositions(int* positions, int maxPositions) const;
+
+private:
+
+    void noteOn(int note, float velocity);
+    void noteOff(int note);
+
+    Parameters parameters;
+    SampleArena::Ptr arena;
+    SampleIndex::Ptr sampleIndex;
+    GrainCorpus::Ptr corpus;
+    LoopSeams::Ptr loopSeams;
+    SampleArena::Ptr emptyArena; // for live voices started before any file is loaded
+    const LiveInputBuffer* liveInput = nullptr;
+    TraceRecorder* tracer = nullptr;
+    ReleaseQueue releaseQueue; // outlives the voices, which retire into it
+
+    // the first numActiveVoices are sounding, in the order they started
+    std::vector<std::unique_ptr<GranSynth>> voices;
+    ScratchArena scratch; // every voice's working memory for the block, reset as each render starts
+    GrainRenderCache grainCache; // shared by the voices, its thread runs from prepare on
+    int numActiveVoices = 0;
+    int maxGrains = 0;
+    int grainCap = std::numeric_limits<int>::max();
+    int voiceCap = std::numeric_limits<int>::max();
+
+    JUCE_DECLARE_NON_COPYABLE (GranularEngine)
+};
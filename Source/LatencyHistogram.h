@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    LatencyHistogram.h
+    Created: 26 Oct 2026 3:47:21pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Block render times on a log scale, 16 buckets per doubling from 1 us to
+// about 16 s, so percentiles come back within 5% however long the run. The
+// maximum is kept exactly. Adding is a few instructions and never allocates.
+class LatencyHistogram
+{
+public:
+
+    void add(double microseconds) noexcept
+    {
+        int bucket = microseconds <= 1.0 ? 0 : (int)(std::log2(microseconds) * bucketsPerOctave);
+        counts[(size_t)juce::jmin(bucket, numBuckets - 1)]++;
+        total++;
+        maximum = juce::jmax(maximum, microseconds);
+    }
+
+    // The time under which this fraction of the blocks rendered, e.g. 0.999 for p99.9;
+    // reported as the upper edge of its bucket
+    double getPercentile(double fraction) const noexcept
+    {
+        if (total == 0)
+            return 0.0;
+
+        auto target = (juce::int64)std::ceil(juce::jlimit(0.0, 1.0, fraction) * (double)total);
+        juce::int64 seen = 0;
+        for (int bucket = 0; bucket < numBuckets; bucket++)
+        {
+            seen += counts[(size_t)bucket];
+            if (seen >= juce::jmax((juce::int64)1, target))
+                return juce::jmin(maximum, std::exp2((double)(bucket + 1) / bucketsPerOctave));
+        }
+        return maximum;
+    }
+
+    double getMaximum() const noexcept { return maximum; }
+    juce::int64 getCount() const noexcept { return total; }
+
+private:
+
+    static constexpr int bucketsPerOctave = 16;
+    static constexpr int numBuckets = 24 * bucketsPerOctave;
+
+    std::array<juce::int64, numBuckets> counts {};
+    juce::int64 total = 0;
+    double maximum = 0.0;
+};
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    LiveInputBuffer.cpp
+    Created: 22 Oct 2026 11:05:18am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "LiveInputBuffer.h"
+
+void LiveInputBuffer::prepare(double sampleRate, int newMaximumBlockSize, double seconds)
+{
+    //grains can reach back the whole length, plus the block that is being written
+    maximumBlockSize = juce::jmax(1, newMaximumBlockSize);
+    int newSize = juce::nextPowerOfTwo((int)(sampleRate * seconds) + maximumBlockSize);
+
+    if (newSize != size)
+    {
+        size = newSize;
+        buffer.allocate((size_t)size, true);
+    }
+    else
+    {
+        juce::FloatVectorOperations::clear(buffer.get(), size);
+    }
+
+    writePosition = 0;
+    blockStart = 0;
+}
+
+void LiveInputBuffer::write(const juce::AudioBuffer<float>& input, int numChannels, int startSample, int numSamples) noexcept
+{
+    auto position = writePosition.load();
+    blockStart = position;
+
+    if (frozen || size == 0 || numSamples <= 0)
+        return;
+
+    numChannels = juce::jmin(numChannels, input.getNumChannels());
+    float channelGain = numChannels > 0 ? 1.0f / numChannels : 0.0f;
+    int mask = size - 1;
+
+    //at most two runs, split where the ring wraps
+    for (int done = 0; done < numSamples;)
+    {
+        int index = (int)((position + done) & mask);
+        int run = juce::jmin(numSamples - done, size - index);
+        float* dest = buffer.get() + index;
+
+        if (numChannels == 0)
+            juce::FloatVectorOperations::clear(dest, run);
+        else
+            juce::FloatVectorOperations::copyWithMultiply(dest, input.getReadPointer(0, startSample + done), channelGain, run);
+
+        for (int channel = 1; channel < numChannels; channel++)
+            juce::FloatVectorOperations::addWithMultiply(dest, input.getReadPointer(channel, startSample + done), channelGain, run);
+
+        done += run;
+    }
+
+    writePosition = position + numSamples;
+}
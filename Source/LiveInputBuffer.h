@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    LiveInputBuffer.h
+    Created: 22 Oct 2026 11:05:18am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// The last few seconds of the audio input, mixed to mono into a preallocated
+// ring that grains read from in place. The ring is a power of two long, so
+// positions are kept as a running sample count and wrapped with a mask.
+// Written once per block on the audio thread before any voice renders.
+class LiveInputBuffer
+{
+public:
+
+    // Allocates the ring, not real-time safe
+    void prepare(double sampleRate, int maximumBlockSize, double seconds = 4.0);
+
+    // Appends the mono mix of the first numChannels channels, unless frozen
+    void write(const juce::AudioBuffer<float>& input, int numChannels, int startSample, int numSamples) noexcept;
+
+    // A frozen ring keeps what it holds and grains keep reading it
+    void setFrozen(bool shouldBeFrozen) noexcept { frozen = shouldBeFrozen; }
+    bool isFrozen() const noexcept { return frozen; }
+
+    const float* getData() const noexcept { return buffer.get(); }
+    int getSize() const noexcept { return size; }
+    int getMaximumBlockSize() const noexcept { return maximumBlockSize; }
+
+    // Position of the first sample written by the last block, or the write position while frozen
+    juce::int64 getBlockStart() const noexcept { return blockStart; }
+    juce::int64 getWritePosition() const noexcept { return writePosition; }
+
+private:
+
+    juce::HeapBlock<float> buffer;
+    int size = 0;
+    int maximumBlockSize = 0;
+    std::atomic<juce::int64> writePosition { 0 };
+    juce::int64 blockStart = 0;
+    std::atomic<bool> frozen { false };
+};
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    LoopSeams.cpp
+    Created: 25 Oct 2026 1:36:40pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "LoopSeams.h"
+
+LoopSeams::Ptr LoopSeams::build(SampleArena::Ptr arena, const Settings& settings)
+{
+    if (arena == nullptr)
+        return nullptr;
+
+    LoopSeams::Ptr loops = new LoopSeams();
+    loops->source = arena;
+    loops->settings = settings;
+
+    //loop points first, every crossfade is at most half its loop
+    int numRegions = arena->getNumRegions();
+    std::vector<int> lengths;
+    for (int r = 0; r < numRegions; r++)
+    {
+        const auto& region = arena->getRegion(r);
+        Seam seam;
+        if (region.length >= minLoopLength)
+        {
+            seam.start = juce::jlimit(0, region.length - minLoopLength, juce::roundToInt(settings.start * region.length));
+            seam.end = juce::jlimit(seam.start + minLoopLength, region.length, juce::roundToInt(settings.end * region.length));
+            seam.fade = juce::jlimit(0, (seam.end - seam.start) / 2, juce::roundToInt(settings.crossfadeSeconds * region.sampleRate));
+        }
+        loops->seams.push_back(seam); //files too short to loop get an empty one and are never wrapped
+        lengths.push_back(seam.fade + 2 * padding);
+    }
+
+    //equal power, the first and last crossfade samples match the file on either side
+    int maxLength = lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end());
+    juce::AudioBuffer<float> strips(juce::jmax(1, numRegions), maxLength);
+    strips.clear();
+    std::vector<float> file((size_t)maxLength * 2);
+
+    for (int r = 0; r < numRegions; r++)
+    {
+        const auto& region = arena->getRegion(r);
+        const auto& seam = loops->seams[(size_t)r];
+        float* strip = strips.getWritePointer(r);
+
+        auto read = [&](int first, float* dest, int count)
+        {
+            int from = juce::jmax(0, first), to = juce::jmin(region.length, first + count);
+            std::fill(dest, dest + count, 0.0f);
+            if (to > from)
+                arena->readSamples(dest + (from - first), region.offset + from, to - from);
+        };
+
+        float* tail = file.data();
+        float* head = file.data() + maxLength;
+        read(seam.getFadeStart() - padding, tail, seam.fade + padding);
+        read(seam.start, head, seam.fade + padding);
+
+        std::copy(tail, tail + padding, strip);
+        for (int k = 0; k < seam.fade; k++)
+        {
+            float angle = juce::MathConstants<float>::halfPi * ((float)k + 0.5f) / (float)seam.fade;
+            strip[padding + k] = tail[padding + k] * std::cos(angle) + head[k] * std::sin(angle);
+        }
+        std::copy(head + seam.fade, head + seam.fade + padding, strip + padding + seam.fade);
+    }
+
+    loops->crossfades = SampleArena::fromChannels(strips, lengths, arena->getFormat());
+    for (int r = 0; r < numRegions; r++)
+        loops->seams[(size_t)r].data = loops->crossfades->getRegionData(r);
+
+    return loops;
+}
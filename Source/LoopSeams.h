@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    LoopSeams.h
+    Created: 25 Oct 2026 1:36:40pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+
+
+// The loop of every file in an arena, with a crossfaded copy of each loop's
+// seam. A grain reads the file up to where the crossfade begins, reads the
+// seam copy through the crossfade, and carries on in the file just past the
+// loop start, so it wraps without a click and without the render kernels
+// checking any bounds. Seams are stored in the arena's format with real
+// samples padded on either side for the interpolators. Small enough to be
+// rebuilt whenever the loop points move.
+class LoopSeams : public juce::ReferenceCountedObject
+{
+public:
+
+    using Ptr = juce::ReferenceCountedObjectPtr<LoopSeams>;
+
+    // Shared by every file, start and end as fractions of the file's length
+    struct Settings
+    {
+        float start = 0.0f;
+        float end = 1.0f;
+        float crossfadeSeconds = 0.02f;
+
+        bool operator== (const Settings& other) const noexcept
+        {
+            return start == other.start && end == other.end && crossfadeSeconds == other.crossfadeSeconds;
+        }
+        bool operator!= (const Settings& other) const noexcept { return ! operator== (other); }
+    };
+
+    // One file's loop in samples from the start of the file. The fade samples
+    // before end are played crossfaded into the fade samples from start, after
+    // which playback continues at start + fade.
+    struct Seam
+    {
+        int start = 0;
+        int end = 0;
+        int fade = 0;
+        const void* data = nullptr; // padding samples before the crossfade, the crossfade, padding samples after
+
+        bool contains(int position) const noexcept { return position >= start && position < end; }
+        // Where the crossfade begins in the file
+        int getFadeStart() const noexcept { return end - fade; }
+        // Where playback goes on in the file once the crossfade is over
+        int getResumePosition() const noexcept { return start + fade; }
+        // Whether a grain starting at position and reading span samples of the file would reach the seam
+        bool wraps(int position, double span) const noexcept { return contains(position) && position + span + padding >= getFadeStart(); }
+    };
+
+    static constexpr int padding = 4; // covers what any interpolator reads either side
+    static constexpr int minLoopLength = 64;
+
+    static Ptr build(SampleArena::Ptr arena, const Settings& settings);
+
+    const Seam& getSeam(int region) const noexcept { return seams[(size_t)region]; }
+    bool isFor(const SampleArena* arena) const noexcept { return source.get() == arena; }
+    const Settings& getSettings() const noexcept { return settings; }
+
+private:
+
+    LoopSeams() = default;
+
+    SampleArena::Ptr source;
+    SampleArena::Ptr crossfades; // one region per file of the source
+    Settings settings;
+    std::vector<Seam> seams;
+};
@@ -1,4 +1,5 @@
 #include "MainComponent.h"
+#include "SimdKernels.h"
 //#include "GranSynth.h"
 
 //==============================================================================
@@ -8,6 +9,9 @@ MainComponent::MainComponent()
     // you add any child components.
     juce::AudioBuffer<float> temp(1, 512);
     granSynth.reset(new GranSynth(temp));
+    granSynth->setLiveInput(&liveInput);
+    granSynth->setReleaseQueue(&releaseQueue);
+    granSynth->reserveGrains(maxGrains);
 
     // Some platforms require permissions to open input channels so request that here
     if (juce::RuntimePermissions::isRequired (juce::RuntimePermissions::recordAudio)
@@ -22,7 +26,9 @@ MainComponent::MainComponent()
         setAudioChannels (2, 2);
     }
     
-    setSize (650, 200);
+    setSize (650, 400);
+    
+    addAndMakeVisible(waveformDisplay);
     
     // Setup for buttons
     addAndMakeVisible(openButton);
@@ -72,10 +78,51 @@ MainComponent::MainComponent()
     pitchShiftSlider.setDoubleClickReturnValue(true, 1);
     pitchShiftSlider.addListener(this);
     
+    addAndMakeVisible(attackSlider);
+    attackSlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    attackSlider.setTextBoxStyle(juce::Slider::TextEntryBoxPosition::TextBoxLeft, 1, 50, 20);
+    attackSlider.setNormalisableRange(juce::NormalisableRange<double>(0.0, 50.0, 0.1));
+    attackSlider.setValue(1.0);
+    attackSlider.setDoubleClickReturnValue(true, 1.0);
+    attackSlider.addListener(this);
+    
+    addAndMakeVisible(releaseSlider);
+    releaseSlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    releaseSlider.setTextBoxStyle(juce::Slider::TextEntryBoxPosition::TextBoxLeft, 1, 50, 20);
+    releaseSlider.setNormalisableRange(juce::NormalisableRange<double>(0.0, 50.0, 0.1));
+    releaseSlider.setValue(1.0);
+    releaseSlider.setDoubleClickReturnValue(true, 1.0);
+    releaseSlider.addListener(this);
+    
+    addAndMakeVisible(envelopeBox);
+    envelopeBox.addItemList({ "Trapezoid", "Hann" }, 1);
+    envelopeBox.setSelectedId(1, juce::dontSendNotification);
+    envelopeBox.onChange = [this] { sliderValueChanged(nullptr); };
+    
+    addAndMakeVisible(snapBox);
+    snapBox.addItemList({ "No Snap", "Zero Crossing", "Onset" }, 1);
+    snapBox.setSelectedId(1, juce::dontSendNotification);
+    snapBox.onChange = [this]
+    {
+        EngineCommand command;
+        command.type = EngineCommand::Type::snapMode;
+        command.snapMode = (SampleIndex::SnapMode)(snapBox.getSelectedId() - 1);
+        engineCommands.push(command);
+    };
+    
+    addAndMakeVisible(liveBox);
+    liveBox.addItemList({ "File", "Live Input", "Live Input (Frozen)" }, 1);
+    liveBox.setSelectedId(1, juce::dontSendNotification);
+    liveBox.onChange = [this] { updateLiveInput(); };
+    
     initializeLabel(grainSizeLabel, "Grain Size (ms)", grainSizeSlider);
     initializeLabel(grainOverlapLabel, "Overlap (%)", grainOverlapSlider);
     initializeLabel(grainSpacingLabel, "Density (Hz)", grainSpacingSlider);
     initializeLabel(pitchShiftLabel, "Pitch Shift", pitchShiftSlider);
+    initializeLabel(attackLabel, "Attack (%)", attackSlider);
+    initializeLabel(releaseLabel, "Release (%)", releaseSlider);
+    
+    startTimerHz(10);
 
 }
 
@@ -83,6 +130,16 @@ MainComponent::~MainComponent()
 {
     // This shuts down the audio device and clears the audio source.
     shutdownAudio();
+    stopTimer();
+    
+    // the audio thread is gone, whatever it did not get to is freed here
+    engineCommands.drain([](const EngineCommand& command)
+    {
+        delete command.synth;
+        if (command.sampleIndex != nullptr)
+            command.sampleIndex->decReferenceCount();
+    });
+    retiredSynths.drain([](GranSynth* synth) { delete synth; });
 }
 
 //==============================================================================
@@ -98,6 +155,12 @@ void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRat
     
     currentSampleRate = sampleRate;
     samplesPerBlock = samplesPerBlockExpected;
+    DBG("Grain kernels: " << SimdKernels::get().name);
+    
+    if (auto* device = deviceManager.getCurrentAudioDevice())
+        numInputChannels = device->getActiveInputChannels().countNumberOfSetBits();
+    liveInput.prepare(sampleRate, samplesPerBlockExpected);
+    granSynth->prepareToPlay(sampleRate, samplesPerBlockExpected);
 }
 
 void MainComponent::getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill)
@@ -106,23 +169,22 @@ void MainComponent::getNextAudioBlock (const juce::AudioSourceChannelInfo& buffe
 
     // For more details, see the help for AudioProcessor::getNextAudioBlock()
 
-    // Right now we are not producing any data, in which case we need to clear the buffer
-    // (to prevent the output of random noise)
+    // UI changes are applied here, between renders
+    engineCommands.drain([this](const EngineCommand& command) { handleCommand(command); });
+    
+    // The input is kept for live grains before the buffer is cleared for the output
+    liveInput.write(*bufferToFill.buffer, numInputChannels, bufferToFill.startSample, bufferToFill.numSamples);
     bufferToFill.clearActiveBufferRegion();
     
     // a barrier that only pass when the play button is clicked
     if (!currentlyPlaying)
         return;
     
-    for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); channel++)
-    {
-        if (channel > 0)
-        {
-            bufferToFill.buffer->copyFrom(channel, 0, *bufferToFill.buffer, 0, 0, bufferToFill.buffer->getNumSamples());
-            continue;
-        }
-        granSynth->processBlock(*bufferToFill.buffer);
-    }
+    // the synth fills the first two channels itself
+    granSynth->processBlock(*bufferToFill.buffer);
+    
+    int numPositions = granSynth->getGrainPositions(grainPositionScratch.data(), (int)grainPositionScratch.size());
+    grainPositions.push(grainPositionScratch.data(), numPositions);
 }
 
 void MainComponent::releaseResources()
@@ -149,21 +211,27 @@ void MainComponent::resized()
     // update their positions.
     
     auto area = getLocalBounds();
+    waveformDisplay.setBounds(area.removeFromBottom(100).reduced(4));
 
     auto leftArea1 = area.removeFromLeft(area.getWidth() / 3);
     auto leftArea = area.removeFromLeft(area.getWidth() / 4);
     auto rightArea = area;
 
-    auto buttonHeight = leftArea.getHeight() / 3;
+    auto buttonHeight = leftArea.getHeight() / 6;
     openButton.setBounds(leftArea1.removeFromTop(buttonHeight));
     playButton.setBounds(leftArea1.removeFromTop(buttonHeight));
     stopButton.setBounds(leftArea1.removeFromTop(buttonHeight));
+    envelopeBox.setBounds(leftArea1.removeFromTop(buttonHeight).reduced(4));
+    snapBox.setBounds(leftArea1.removeFromTop(buttonHeight).reduced(4));
+    liveBox.setBounds(leftArea1.removeFromTop(buttonHeight).reduced(4));
 
-    auto sliderHeight = rightArea.getHeight() / 4;
+    auto sliderHeight = rightArea.getHeight() / 6;
     grainSizeSlider.setBounds(rightArea.removeFromTop(sliderHeight));
     grainOverlapSlider.setBounds(rightArea.removeFromTop(sliderHeight));
     grainSpacingSlider.setBounds(rightArea.removeFromTop(sliderHeight));
     pitchShiftSlider.setBounds(rightArea.removeFromTop(sliderHeight));
+    attackSlider.setBounds(rightArea.removeFromTop(sliderHeight));
+    releaseSlider.setBounds(rightArea.removeFromTop(sliderHeight));
     
 }
 
@@ -206,12 +274,55 @@ bool MainComponent::loadAudioFile(const juce::File& file)
     
     if (!fileBuffer.hasBeenCleared())
     {
-        granSynth.reset(new GranSynth(fileBuffer));
+        // the new synth is set up here while nothing else can see it, then handed to the audio thread
+        auto newSynth = std::make_unique<GranSynth>(fileBuffer);
+        newSynth->prepareToPlay(currentSampleRate, samplesPerBlock);
         
-        granSynth->setGrainsParams((int)(grainSizeSlider.getValue() / 1000 * currentSampleRate),
+        newSynth->setGrainsParams((int)(grainSizeSlider.getValue() / 1000 * currentSampleRate),
                                       (int)(grainOverlapSlider.getValue() * grainSizeSlider.getValue() / 1000 * currentSampleRate),
                                       (int)( currentSampleRate/grainSpacingSlider.getValue() ),
                                       (float)pitchShiftSlider.getValue());
+        newSynth->setEnvelopeParams((GrainEnvelope::Shape)(envelopeBox.getSelectedId() - 1),
+                                     (float)attackSlider.getValue(),
+                                     (float)releaseSlider.getValue());
+        newSynth->setSnapMode((SampleIndex::SnapMode)(snapBox.getSelectedId() - 1));
+        newSynth->setLiveInput(&liveInput);
+        newSynth->setReleaseQueue(&releaseQueue);
+        newSynth->reserveGrains(maxGrains);
+        newSynth->setLoopSeams(LoopSeams::build(newSynth->getArena(), {}));
+        auto arena = newSynth->getArena();
+        
+        EngineCommand command;
+        command.type = EngineCommand::Type::swapSynth;
+        command.synth = newSynth.get();
+        if (! engineCommands.push(command))
+            return false;
+        newSynth.release();
+        updateLiveInput();
+        
+        // onsets, zero crossings and the overview are built in the background and handed over when ready
+        analysisPool.addJob([safeThis = juce::Component::SafePointer<MainComponent>(this),
+                             buffer = fileBuffer, arena, load = ++loadCount]
+        {
+            auto index = SampleIndex::build(buffer);
+            auto newPeaks = PeakPyramid::build(arena);
+            juce::MessageManager::callAsync([safeThis, index, newPeaks, load]
+            {
+                if (safeThis != nullptr && safeThis->loadCount == load)
+                {
+                    safeThis->peaks = newPeaks;
+                    
+                    //the reference travels with the command, so a newer load can't free the index before it lands
+                    EngineCommand indexCommand;
+                    indexCommand.type = EngineCommand::Type::sampleIndex;
+                    indexCommand.sampleIndex = index.get();
+                    index->incReferenceCount();
+                    if (! safeThis->engineCommands.push(indexCommand))
+                        index->decReferenceCount();
+                }
+            });
+        });
+        
         openButton.setEnabled(false);
         stopButton.setEnabled(false);
         playButton.setEnabled(true);
@@ -246,8 +357,76 @@ void MainComponent::sliderValueChanged(juce::Slider *slider)
 {
 //    grainOverlapSlider.setNormalisableRange(juce::NormalisableRange<double>(0, grainSizeSlider.getValue()-1, 1.0));
     
-    granSynth->setGrainsParams((int)(grainSizeSlider.getValue() / 1000 * currentSampleRate),
-                                  (int)(grainOverlapSlider.getValue() * grainSizeSlider.getValue() / 1000 * currentSampleRate),
-                                  (int)(currentSampleRate/grainSpacingSlider.getValue()),
-                                  (float)pitchShiftSlider.getValue());
+    sendGrainSettings();
+}
+
+void MainComponent::sendGrainSettings()
+{
+    EngineCommand parameters;
+    parameters.type = EngineCommand::Type::grainParameters;
+    parameters.grainSize = (int)(grainSizeSlider.getValue() / 1000 * currentSampleRate);
+    parameters.grainOverlap = (int)(grainOverlapSlider.getValue() * grainSizeSlider.getValue() / 1000 * currentSampleRate);
+    parameters.grainSpacing = (int)(currentSampleRate/grainSpacingSlider.getValue());
+    parameters.pitchShiftFactor = (float)pitchShiftSlider.getValue();
+    engineCommands.push(parameters);
+    
+    EngineCommand envelope;
+    envelope.type = EngineCommand::Type::envelope;
+    envelope.envelope.shape = (GrainEnvelope::Shape)(envelopeBox.getSelectedId() - 1);
+    envelope.envelope.attackPercent = (float)attackSlider.getValue();
+    envelope.envelope.releasePercent = (float)releaseSlider.getValue();
+    engineCommands.push(envelope);
+}
+
+void MainComponent::handleCommand(const EngineCommand& command)
+{
+    switch (command.type)
+    {
+        case EngineCommand::Type::grainParameters:
+            granSynth->setGrainsParams(command.grainSize, command.grainOverlap, command.grainSpacing, command.pitchShiftFactor);
+            break;
+        case EngineCommand::Type::envelope:
+            granSynth->setEnvelopeParams(command.envelope.shape, command.envelope.attackPercent, command.envelope.releasePercent);
+            break;
+        case EngineCommand::Type::snapMode:
+            granSynth->setSnapMode(command.snapMode);
+            break;
+        case EngineCommand::Type::grainSource:
+            granSynth->setGrainSource(command.grainSource);
+            break;
+        case EngineCommand::Type::sampleIndex:
+            //the synth takes a reference of its own first, so dropping the command's never frees the index
+            granSynth->setSampleIndex(command.sampleIndex);
+            command.sampleIndex->decReferenceCount();
+            break;
+        case EngineCommand::Type::swapSynth:
+        {
+            //the old synth is freed on the message thread, or here if that has stalled for a long time
+            auto* oldSynth = granSynth.release();
+            granSynth.reset(command.synth);
+            if (! retiredSynths.push(oldSynth))
+                delete oldSynth;
+            break;
+        }
+    }
+}
+
+void MainComponent::timerCallback()
+{
+    retiredSynths.drain([](GranSynth* synth) { delete synth; });
+    releaseQueue.releasePending();
+}
+
+void MainComponent::updateLiveInput()
+{
+    //live grains need no file, so playing can start straight away
+    bool live = liveBox.getSelectedId() > 1;
+    EngineCommand command;
+    command.type = EngineCommand::Type::grainSource;
+    command.grainSource = live ? GranSynth::GrainSource::liveInput : GranSynth::GrainSource::filePosition;
+    engineCommands.push(command);
+    liveInput.setFrozen(liveBox.getSelectedId() == 3);
+    
+    if (live && ! currentlyPlaying)
+        playButton.setEnabled(true);
 }
@@ -2,13 +2,16 @@
 
 #include <JuceHeader.h>
 #include "GranSynth.h"
+#include "WaveformDisplay.h"
+#include "CommandFifo.h"
 
 //==============================================================================
 /*
     This component lives inside our window, and this is where you should put all
     your controls and content.
 */
-class MainComponent  : public juce::AudioAppComponent, public juce::Slider::Listener, public juce::Button::Listener
+class MainComponent  : public juce::AudioAppComponent, public juce::Slider::Listener, public juce::Button::Listener,
+                       private juce::Timer
 {
 public:
     //==============================================================================
@@ -28,6 +31,8 @@ public:
     void buttonClicked(juce::Button* button) override;
     void openFile();
     bool loadAudioFile(const juce::File& file);
+    void updateLiveInput();
+    void sendGrainSettings();
     void sliderValueChanged(juce::Slider *slider) override; //@ need define
     void initializeLabel(juce::Label& label, const juce::String& text, juce::Slider& slider);
     
@@ -36,6 +41,32 @@ private:
     //==============================================================================
     // Your private member variables go here...
     
+    // Everything the UI changes reaches the synth as one of these, drained at the top of each block
+    struct EngineCommand
+    {
+        enum class Type
+        {
+            grainParameters = 0,
+            envelope,
+            snapMode,
+            grainSource,
+            sampleIndex,
+            swapSynth
+        };
+        
+        Type type = Type::grainParameters;
+        int grainSize = 0, grainOverlap = 0, grainSpacing = 0;
+        float pitchShiftFactor = 1.0f;
+        GrainEnvelope::Parameters envelope;
+        SampleIndex::SnapMode snapMode = SampleIndex::SnapMode::off;
+        GranSynth::GrainSource grainSource = GranSynth::GrainSource::filePosition;
+        SampleIndex* sampleIndex = nullptr; //carries a reference of its own, adopted by handleCommand
+        GranSynth* synth = nullptr;         //owned by the audio thread once drained
+    };
+    
+    void handleCommand(const EngineCommand& command);
+    void timerCallback() override;
+    
     int grainSize, grainOverlap, grainSpacing;
     float pitchShiftFactor;
     bool currentlyPlaying = false; //the flag used to check if the audio is currently
@@ -43,13 +74,30 @@ private:
     int currentSampleRate;
     int samplesPerBlock;
     
-    std::unique_ptr<GranSynth> granSynth;
+    static constexpr int maxGrains = 4096; //reserved up front so grains never allocate in the callback
+    ReleaseQueue releaseQueue; //what a synth replaces on the audio thread is dropped in timerCallback
+    std::unique_ptr<GranSynth> granSynth; //only touched by the audio thread once audio has started
+    CommandFifo<EngineCommand, 64> engineCommands;
+    CommandFifo<GranSynth*, 16> retiredSynths; //replaced synths, deleted back on the message thread
+    LiveInputBuffer liveInput; //the device input, granulated instead of the file when live is picked
+    int numInputChannels = 0;
     std::unique_ptr<juce::FileChooser> chooser;
     
+    juce::ThreadPool analysisPool { 1 };
+    int loadCount = 0; //stops a late analysis result landing on a newer file
+    
+    PeakPyramid::Ptr peaks; //built with the sample index
+    GrainPositionFifo grainPositions;
+    std::array<int, 256> grainPositionScratch;
+    WaveformDisplay waveformDisplay { [this] { return peaks; }, grainPositions };
+    
     //GUI Components
     juce::Slider grainSizeSlider, grainOverlapSlider, grainSpacingSlider, pitchShiftSlider;
+    juce::Slider attackSlider, releaseSlider;
+    juce::ComboBox envelopeBox, snapBox, liveBox;
     juce::TextButton openButton, playButton, stopButton;
     juce::Label grainSizeLabel, grainOverlapLabel, grainSpacingLabel, pitchShiftLabel;
+    juce::Label attackLabel, releaseLabel;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    ModulationEngine.cpp
+    Created: 21 Oct 2026 10:12:26am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "ModulationEngine.h"
+
+void ModulationEngine::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    envelope.setSampleRate(sampleRate / controlInterval);
+    reserve(maximumBlockSize);
+}
+
+void ModulationEngine::reserve(int maximumBlockSize)
+{
+    //enough control points for a full block at the shortest interval, plus one on each side
+    auto size = (size_t)(maximumBlockSize / minimumInterval + 3);
+    for (auto& v : values)
+        v.resize(size);
+    for (auto& s : sources)
+        s.resize(size);
+}
+
+bool ModulationEngine::Parameters::operator== (const Parameters& other) const noexcept
+{
+    for (int l = 0; l < numLfos; l++)
+        if (lfoRates[l] != other.lfoRates[l] || lfoShapes[l] != other.lfoShapes[l])
+            return false;
+
+    for (int s = 0; s < numSlots; s++)
+        if (slots[s].source != other.slots[s].source || slots[s].destination != other.slots[s].destination
+            || slots[s].amount != other.slots[s].amount)
+            return false;
+
+    return envelope.attack == other.envelope.attack && envelope.decay == other.envelope.decay
+        && envelope.sustain == other.envelope.sustain && envelope.release == other.envelope.release
+        && controlInterval == other.controlInterval;
+}
+
+void ModulationEngine::setParameters(const Parameters& newParameters)
+{
+    if (newParameters == parameters)
+        return;
+
+    parameters = newParameters;
+
+    int newInterval = juce::jlimit(minimumInterval, maximumInterval, parameters.controlInterval);
+    if (newInterval != controlInterval)
+    {
+        //restart the control clock on the last evaluated value
+        controlInterval = newInterval;
+        inverseInterval = 1.0f / controlInterval;
+        envelope.setSampleRate(sampleRate / controlInterval);
+        clock = 0;
+        lastEvaluatedPoint = lastEvaluatedPoint >= 0 ? 0 : -1;
+    }
+
+    envelope.setParameters(parameters.envelope);
+    updateRouting();
+}
+
+void ModulationEngine::updateRouting()
+{
+    active = false;
+    std::fill(std::begin(destinationsInUse), std::end(destinationsInUse), false);
+
+    for (auto& slot : parameters.slots)
+    {
+        if (slot.source != Source::off && slot.amount != 0.0f)
+        {
+            active = true;
+            destinationsInUse[slot.destination] = true;
+        }
+    }
+}
+
+void ModulationEngine::noteOn(float midiNote, float newVelocity)
+{
+    velocity = newVelocity;
+    key = (midiNote - 60.0f) / 60.0f;
+    std::fill(std::begin(lfoPhases), std::end(lfoPhases), 0.0f);
+    envelope.reset();
+    envelope.noteOn();
+    clock = 0;
+    lastEvaluatedPoint = -1;
+}
+
+void ModulationEngine::noteOff()
+{
+    envelope.noteOff();
+}
+
+void ModulationEngine::process(int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    blockStart = clock;
+    firstPoint = blockStart / controlInterval;
+    auto lastPoint = (blockStart + numSamples - 1) / controlInterval + 1;
+    int numPoints = (int)(lastPoint - firstPoint + 1);
+    if ((size_t)numPoints > values[0].size())
+        reserve(numSamples); //only if the host breaks its maximum block size
+
+    //the previous block already evaluated up to one point into this one
+    int carried = (int)juce::jlimit((juce::int64)0, (juce::int64)2, lastEvaluatedPoint - firstPoint + 1);
+    for (int d = 0; d < numDestinations; d++)
+        for (int i = 0; i < carried; i++)
+            values[d][(size_t)i] = lastValues[d][2 - carried + i];
+
+    evaluate(carried, numPoints - carried);
+
+    for (int d = 0; d < numDestinations; d++)
+    {
+        lastValues[d][0] = values[d][(size_t)numPoints - 2];
+        lastValues[d][1] = values[d][(size_t)numPoints - 1];
+    }
+    lastEvaluatedPoint = lastPoint;
+    clock += numSamples;
+}
+
+void ModulationEngine::evaluate(int firstIndex, int numPoints)
+{
+    if (numPoints <= 0)
+        return;
+
+    //sources first, each one as a single loop over the new points
+    for (int l = 0; l < numLfos; l++)
+    {
+        float* out = sources[(int)Source::lfo1 - 1 + l].data() + firstIndex;
+        float phase = lfoPhases[l];
+        float increment = (float)(parameters.lfoRates[l] * controlInterval / sampleRate);
+
+        for (int i = 0; i < numPoints; i++)
+        {
+            float p = phase + i * increment;
+            out[i] = p - std::floor(p);
+        }
+
+        switch (parameters.lfoShapes[l])
+        {
+            case LfoShape::sine:
+                for (int i = 0; i < numPoints; i++)
+                    out[i] = std::sin(juce::MathConstants<float>::twoPi * out[i]);
+                break;
+            case LfoShape::triangle:
+                for (int i = 0; i < numPoints; i++)
+                    out[i] = 1.0f - 4.0f * std::abs(out[i] - 0.5f);
+                break;
+            case LfoShape::saw:
+                for (int i = 0; i < numPoints; i++)
+                    out[i] = 2.0f * out[i] - 1.0f;
+                break;
+            case LfoShape::square:
+                for (int i = 0; i < numPoints; i++)
+                    out[i] = out[i] < 0.5f ? 1.0f : -1.0f;
+                break;
+        }
+
+        float next = phase + numPoints * increment;
+        lfoPhases[l] = next - std::floor(next);
+    }
+
+    float* envelopeOut = sources[(int)Source::envelope - 1].data() + firstIndex;
+    for (int i = 0; i < numPoints; i++)
+        envelopeOut[i] = envelope.getNextSample();
+
+    std::fill_n(sources[(int)Source::velocity - 1].data() + firstIndex, numPoints, velocity);
+    std::fill_n(sources[(int)Source::key - 1].data() + firstIndex, numPoints, key);
+
+    //then the matrix, one multiply-accumulate pass per slot
+    for (auto& v : values)
+        std::fill_n(v.data() + firstIndex, numPoints, 0.0f);
+
+    for (auto& slot : parameters.slots)
+    {
+        if (slot.source == Source::off || slot.amount == 0.0f)
+            continue;
+
+        const float* in = sources[(int)slot.source - 1].data() + firstIndex;
+        float* out = values[slot.destination].data() + firstIndex;
+        for (int i = 0; i < numPoints; i++)
+            out[i] += slot.amount * in[i];
+    }
+}
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    ModulationEngine.h
+    Created: 21 Oct 2026 10:12:26am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Control-rate modulation for one voice: two LFOs, an envelope, velocity and
+// key tracking, routed through a small matrix to the grain scheduler. Sources
+// are evaluated once every controlInterval samples, a whole block of control
+// points at a time, and read back interpolated between those points.
+class ModulationEngine
+{
+public:
+
+    enum class Source
+    {
+        off = 0,
+        lfo1,
+        lfo2,
+        envelope,
+        velocity,
+        key
+    };
+
+    enum Destination
+    {
+        grainSize = 0, // +-2 octaves of grain length at full amount
+        density,       // +-2 octaves of grains per second
+        position,      // +-the whole file, or the whole live input delay range
+        pitch,         // +-1 octave
+        pan,           // full left to full right
+        numDestinations
+    };
+
+    enum class LfoShape
+    {
+        sine = 0,
+        triangle,
+        saw,
+        square
+    };
+
+    struct Slot
+    {
+        Source source = Source::off;
+        Destination destination = grainSize;
+        float amount = 0.0f; // -1..1
+    };
+
+    static constexpr int numSources = 5;
+    static constexpr int numLfos = 2;
+    static constexpr int numSlots = 4;
+    static constexpr int minimumInterval = 8;
+    static constexpr int maximumInterval = 256;
+
+    struct Parameters
+    {
+        float lfoRates[numLfos] = { 1.0f, 1.0f }; // Hz
+        LfoShape lfoShapes[numLfos] = { LfoShape::sine, LfoShape::sine };
+        juce::ADSR::Parameters envelope;
+        Slot slots[numSlots];
+        int controlInterval = 32; // samples between control points
+
+        bool operator== (const Parameters& other) const noexcept;
+        bool operator!= (const Parameters& other) const noexcept { return ! (*this == other); }
+    };
+
+    void prepare(double sampleRate, int maximumBlockSize);
+    // Does nothing if the parameters are the ones already set, so it can be called every block
+    void setParameters(const Parameters& newParameters);
+
+    void noteOn(float midiNote, float velocity);
+    void noteOff();
+
+    // True if any slot routes a source somewhere; when false, every value is 0
+    bool isActive() const noexcept { return active; }
+    bool isModulated(Destination destination) const noexcept { return destinationsInUse[destination]; }
+
+    // Evaluates the control points covering the next numSamples. Call it every block even while
+    // no slot is active, so the LFOs, the envelope and the control clock keep running
+    void process(int numSamples);
+
+    // Modulation of a destination at a sample of the block just processed
+    float getValue(Destination destination, int sample) const noexcept
+    {
+        auto time = blockStart + sample;
+        auto point = time / controlInterval;
+        float fraction = (float)(time - point * controlInterval) * inverseInterval;
+        const float* v = values[destination].data() + (point - firstPoint);
+        return v[0] + fraction * (v[1] - v[0]);
+    }
+
+private:
+
+    void evaluate(int firstIndex, int numPoints);
+    void updateRouting();
+    void reserve(int maximumBlockSize);
+
+    Parameters parameters;
+    double sampleRate = 44100.0;
+    int controlInterval = 32;
+    float inverseInterval = 1.0f / 32.0f;
+    bool active = false;
+    bool destinationsInUse[numDestinations] = {};
+
+    float lfoPhases[numLfos] = {};
+    juce::ADSR envelope; // runs at the control rate, one sample per control point
+    float velocity = 0.0f;
+    float key = 0.0f;
+
+    // control point k sits at sample k * controlInterval since the note started;
+    // values[d][i] is point firstPoint + i, so the block is covered from both sides
+    std::vector<float> values[numDestinations];
+    std::vector<float> sources[numSources];
+    juce::int64 clock = 0;
+    juce::int64 blockStart = 0;
+    juce::int64 firstPoint = 0;
+    juce::int64 lastEvaluatedPoint = -1;
+    float lastValues[numDestinations][2] = {}; // points lastEvaluatedPoint - 1 and lastEvaluatedPoint
+};
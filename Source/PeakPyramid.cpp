@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    PeakPyramid.cpp
+    Created: 23 Oct 2026 9:41:33am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "PeakPyramid.h"
+
+static PeakPyramid::Peak measure(const float* data, int numSamples) noexcept
+{
+    PeakPyramid::Peak peak;
+    if (numSamples <= 0)
+        return peak;
+
+    auto range = juce::FloatVectorOperations::findMinAndMax(data, numSamples);
+    double sumSquares = 0.0;
+    for (int i = 0; i < numSamples; i++)
+        sumSquares += data[i] * data[i];
+
+    peak.min = range.getStart();
+    peak.max = range.getEnd();
+    peak.rms = (float)std::sqrt(sumSquares / numSamples);
+    return peak;
+}
+
+static PeakPyramid::Peak combine(const PeakPyramid::Peak& a, const PeakPyramid::Peak& b) noexcept
+{
+    return { juce::jmin(a.min, b.min), juce::jmax(a.max, b.max), std::sqrt(0.5f * (a.rms * a.rms + b.rms * b.rms)) };
+}
+
+PeakPyramid::Ptr PeakPyramid::build(SampleArena::Ptr arena)
+{
+    PeakPyramid::Ptr pyramid = new PeakPyramid();
+    if (arena == nullptr)
+        return pyramid;
+
+    pyramid->arena = arena;
+    pyramid->numSamples = arena->getTotalSize();
+
+    //the finest level straight from the samples, read a stretch at a time so 16 bit arenas are decoded as they go
+    auto& finest = pyramid->levels.emplace_back((size_t)((pyramid->numSamples + finestBlockSize - 1) / finestBlockSize));
+    std::vector<float> chunk((size_t)finestBlockSize * 256);
+    for (int start = 0; start < pyramid->numSamples; start += (int)chunk.size())
+    {
+        int length = juce::jmin((int)chunk.size(), pyramid->numSamples - start);
+        arena->readSamples(chunk.data(), start, length);
+
+        for (int offset = 0; offset < length; offset += finestBlockSize)
+            finest[(size_t)((start + offset) / finestBlockSize)] = measure(chunk.data() + offset, juce::jmin(finestBlockSize, length - offset));
+    }
+
+    //every further level pairs up the one below until a single peak covers everything
+    while (pyramid->levels.back().size() > 1)
+    {
+        const auto& below = pyramid->levels.back();
+        std::vector<Peak> level((below.size() + 1) / 2);
+        for (size_t i = 0; i < level.size(); i++)
+            level[i] = 2 * i + 1 < below.size() ? combine(below[2 * i], below[2 * i + 1]) : below[2 * i];
+
+        pyramid->levels.push_back(std::move(level));
+    }
+
+    return pyramid;
+}
+
+std::vector<size_t> PeakPyramid::getLevelSizes(int numSamples)
+{
+    std::vector<size_t> sizes { (size_t)((numSamples + finestBlockSize - 1) / finestBlockSize) };
+    while (sizes.back() > 1)
+        sizes.push_back((sizes.back() + 1) / 2);
+    return sizes;
+}
+
+void PeakPyramid::writeTo(juce::OutputStream& stream) const
+{
+    stream.writeInt((int)levels.size());
+    for (const auto& level : levels)
+    {
+        stream.writeInt((int)level.size());
+        stream.write(level.data(), level.size() * sizeof(Peak));
+    }
+}
+
+PeakPyramid::Ptr PeakPyramid::readFrom(juce::InputStream& stream, SampleArena::Ptr arena)
+{
+    if (arena == nullptr)
+        return nullptr;
+
+    PeakPyramid::Ptr pyramid = new PeakPyramid();
+    pyramid->arena = arena;
+    pyramid->numSamples = arena->getTotalSize();
+
+    auto sizes = getLevelSizes(pyramid->numSamples);
+    if (stream.readInt() != (int)sizes.size())
+        return nullptr;
+
+    for (auto expectedSize : sizes)
+    {
+        int size = stream.readInt();
+        if ((size_t)size != expectedSize || (juce::int64)size * (juce::int64)sizeof(Peak) > stream.getNumBytesRemaining())
+            return nullptr;
+
+        auto& level = pyramid->levels.emplace_back((size_t)size);
+        stream.read(level.data(), size * (int)sizeof(Peak));
+
+        //the overview draws straight from these, a damaged one would draw garbage
+        for (const auto& peak : level)
+            if (! (std::isfinite(peak.min) && std::isfinite(peak.max) && std::isfinite(peak.rms))
+                || peak.min > peak.max || peak.rms < 0.0f)
+                return nullptr;
+    }
+
+    return pyramid;
+}
+
+void PeakPyramid::getPeaks(double startSample, double endSample, Peak* peaks, int numPixels) const noexcept
+{
+    if (numPixels <= 0)
+        return;
+
+    double samplesPerPixel = (endSample - startSample) / numPixels;
+    if (numSamples == 0 || samplesPerPixel <= 0.0)
+    {
+        std::fill(peaks, peaks + numPixels, Peak());
+        return;
+    }
+
+    //zoomed in past the finest level, a pixel covers fewer samples than a block, so read them
+    if (samplesPerPixel < finestBlockSize)
+    {
+        float samples[finestBlockSize + 1];
+        for (int x = 0; x < numPixels; x++)
+        {
+            int first = juce::jlimit(0, numSamples, (int)(startSample + x * samplesPerPixel));
+            int last = juce::jlimit(first, numSamples, juce::jmax(first + 1, (int)(startSample + (x + 1) * samplesPerPixel)));
+            arena->readSamples(samples, first, last - first);
+            peaks[x] = measure(samples, last - first);
+        }
+        return;
+    }
+
+    //the coarsest level whose blocks are no longer than a pixel, so each pixel combines two or three of them
+    int level = juce::jlimit(0, (int)levels.size() - 1, (int)std::floor(std::log2(samplesPerPixel / finestBlockSize)));
+    const auto& blocks = levels[(size_t)level];
+    double blockSize = (double)(finestBlockSize << level);
+
+    for (int x = 0; x < numPixels; x++)
+    {
+        auto first = (int)std::floor((startSample + x * samplesPerPixel) / blockSize);
+        auto last = (int)std::ceil((startSample + (x + 1) * samplesPerPixel) / blockSize);
+        first = juce::jlimit(0, (int)blocks.size(), first);
+        last = juce::jlimit(first, (int)blocks.size(), last);
+
+        Peak peak = first < last ? blocks[(size_t)first] : Peak();
+        for (int b = first + 1; b < last; b++)
+            peak = { juce::jmin(peak.min, blocks[(size_t)b].min), juce::jmax(peak.max, blocks[(size_t)b].max),
+                     juce::jmax(peak.rms, blocks[(size_t)b].rms) };
+        peaks[x] = peak;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    PeakPyramid.h
+    Created: 23 Oct 2026 9:41:33am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+
+
+// Min / max / RMS overview of an arena at every power of two resolution, so
+// a waveform of any length is drawn from a couple of peaks per pixel at any
+// zoom. Built in the background after loading; immutable once built.
+class PeakPyramid : public juce::ReferenceCountedObject
+{
+public:
+
+    using Ptr = juce::ReferenceCountedObjectPtr<PeakPyramid>;
+
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
+    static Ptr build(SampleArena::Ptr arena);
+
+    // Native byte order, for the on-disk cache only; readFrom returns nullptr if the data is cut short,
+    // a level is not the size building this arena would give it, or a peak is not a finite range
+    void writeTo(juce::OutputStream& stream) const;
+    static Ptr readFrom(juce::InputStream& stream, SampleArena::Ptr arena);
+
+    int getNumSamples() const noexcept { return numSamples; }
+
+    // One peak per pixel across [startSample, endSample) of the arena. Reads the
+    // coarsest level that still resolves a pixel, or the samples themselves
+    // when zoomed in further than the finest level.
+    void getPeaks(double startSample, double endSample, Peak* peaks, int numPixels) const noexcept;
+
+private:
+
+    static constexpr int finestBlockSize = 64; // samples per peak at level 0, doubling with every level
+
+    // Peaks per level for an arena of numSamples, finest first
+    static std::vector<size_t> getLevelSizes(int numSamples);
+
+    SampleArena::Ptr arena;
+    int numSamples = 0;
+    std::vector<std::vector<Peak>> levels;
+};
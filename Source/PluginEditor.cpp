@@ -11,11 +11,12 @@
 
 //==============================================================================
 GranSynthZiAudioProcessorEditor::GranSynthZiAudioProcessorEditor (GranSynthZiAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p),
+      waveformDisplay ([&p] { return p.getPeakPyramid(); }, p.getGrainPositionFifo())
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (800, 200);
+    setSize (1000, 360);
     
     addAndMakeVisible(&openButton);
     openButton.setButtonText("Open File");
@@ -27,7 +28,6 @@ GranSynthZiAudioProcessorEditor::GranSynthZiAudioProcessorEditor (GranSynthZiAud
     grainSizeSlider.setTextBoxIsEditable(true);
     grainSizeSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, true, 120, 20);
     grainSizeSlider.setNormalisableRange(juce::NormalisableRange<double>(5.0, 100.0, 1.0));
-    grainSizeSlider.setValue (audioProcessor.getGrainSize());
     grainSizeSlider.addListener (this);
     grainSizeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
                 audioProcessor.getAPVTS(), "grainSize", grainSizeSlider);
@@ -36,8 +36,6 @@ GranSynthZiAudioProcessorEditor::GranSynthZiAudioProcessorEditor (GranSynthZiAud
     grainOverlapSlider.setSliderStyle (juce::Slider::RotaryVerticalDrag);
     grainOverlapSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, true, 120, 20);
     grainOverlapSlider.setNormalisableRange(juce::NormalisableRange<double>(0, grainSizeSlider.getValue()-1, 1.0));
-    grainOverlapSlider.setValue (audioProcessor.getGrainOverlap());
-    grainOverlapSlider.addListener (this);
     grainOverlapAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
                 audioProcessor.getAPVTS(), "grainOverlap", grainOverlapSlider);
     
@@ -45,11 +43,51 @@ GranSynthZiAudioProcessorEditor::GranSynthZiAudioProcessorEditor (GranSynthZiAud
     grainSpacingSlider.setSliderStyle (juce::Slider::RotaryVerticalDrag);
     grainSpacingSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, true, 120, 20);
     grainSpacingSlider.setNormalisableRange(juce::NormalisableRange<double>(1.0, 200.0, 1));
-    grainSpacingSlider.setValue (audioProcessor.getGrainSpacing());
-    grainSpacingSlider.addListener (this);
     grainSpacingAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
                 audioProcessor.getAPVTS(), "grainSpacing", grainSpacingSlider);
     
+    addAndMakeVisible(grainAttackSlider);
+    grainAttackSlider.setSliderStyle (juce::Slider::RotaryVerticalDrag);
+    grainAttackSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, true, 120, 20);
+    grainAttackAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+                audioProcessor.getAPVTS(), "grainAttack", grainAttackSlider);
+    
+    addAndMakeVisible(grainReleaseSlider);
+    grainReleaseSlider.setSliderStyle (juce::Slider::RotaryVerticalDrag);
+    grainReleaseSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, true, 120, 20);
+    grainReleaseAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+                audioProcessor.getAPVTS(), "grainRelease", grainReleaseSlider);
+    
+    addAndMakeVisible(grainEnvelopeBox);
+    grainEnvelopeBox.addItemList({ "Trapezoid", "Hann" }, 1);
+    grainEnvelopeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+                audioProcessor.getAPVTS(), "grainEnvelope", grainEnvelopeBox);
+    
+    addAndMakeVisible(grainInterpolationBox);
+    grainInterpolationBox.addItemList({ "Linear", "Cubic" }, 1);
+    grainInterpolationAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+                audioProcessor.getAPVTS(), "grainInterpolation", grainInterpolationBox);
+    
+    addAndMakeVisible(grainSnapBox);
+    grainSnapBox.addItemList({ "No Snap", "Zero Crossing", "Onset" }, 1);
+    grainSnapAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+                audioProcessor.getAPVTS(), "grainSnap", grainSnapBox);
+    
+    addAndMakeVisible(grainSourceBox);
+    grainSourceBox.addItemList({ "File Position", "Corpus", "Live Input" }, 1);
+    grainSourceAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+                audioProcessor.getAPVTS(), "grainSource", grainSourceBox);
+    
+    addAndMakeVisible(grainModeBox);
+    grainModeBox.addItemList({ "Time", "Spectral" }, 1);
+    grainModeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+                audioProcessor.getAPVTS(), "grainMode", grainModeBox);
+    
+    addAndMakeVisible(liveFreezeButton);
+    liveFreezeButton.setButtonText("Freeze");
+    liveFreezeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+                audioProcessor.getAPVTS(), "liveFreeze", liveFreezeButton);
+    
     addAndMakeVisible(grainSizeLabel);
     grainSizeLabel.setText("Grain Size (ms)", juce::dontSendNotification);
     grainSizeLabel.attachToComponent(&grainSizeSlider, false);
@@ -62,8 +100,18 @@ GranSynthZiAudioProcessorEditor::GranSynthZiAudioProcessorEditor (GranSynthZiAud
     grainSpacingLabel.setText("Grain Spacing (ms)", juce::dontSendNotification);
     grainSpacingLabel.attachToComponent(&grainSpacingSlider, false);
     
+    addAndMakeVisible(grainAttackLabel);
+    grainAttackLabel.setText("Attack (%)", juce::dontSendNotification);
+    grainAttackLabel.attachToComponent(&grainAttackSlider, false);
+    
+    addAndMakeVisible(grainReleaseLabel);
+    grainReleaseLabel.setText("Release (%)", juce::dontSendNotification);
+    grainReleaseLabel.attachToComponent(&grainReleaseSlider, false);
+    
     addAndMakeVisible(explainLabel);
-    explainLabel.setText("Original pitch is mapped to A3", juce::dontSendNotification);
+    explainLabel.setText("Original pitch is mapped to A3 (note " + juce::String(GranSynth::rootNote) + ")", juce::dontSendNotification);
+    
+    addAndMakeVisible(waveformDisplay);
     
     addAndMakeVisible (midiKeyboardComponent);
     midiKeyboardComponent.setMidiChannel (2);
@@ -98,32 +146,43 @@ void GranSynthZiAudioProcessorEditor::resized()
 //    int labelHeight = 20;
     
     openButton.setBounds(area.getWidth()*0.025, area.getHeight()*0.2, 90, 40);
+    grainEnvelopeBox.setBounds(area.getWidth()*0.025, area.getHeight()*0.2+48, 90, 24);
+    grainInterpolationBox.setBounds(area.getWidth()*0.025, area.getHeight()*0.2-32, 90, 24);
 
     grainSizeSlider.setBounds(area.getWidth()*0.03+140, area.getHeight()*0.15, sliderWidth, sliderHeight);
     
     grainOverlapSlider.setBounds(area.getWidth()*0.03+250, area.getHeight()*0.15, sliderWidth, sliderHeight);
     grainSpacingSlider.setBounds(area.getWidth()*0.03+360, area.getHeight()*0.15, sliderWidth, sliderHeight);
+    grainAttackSlider.setBounds(area.getWidth()*0.03+470, area.getHeight()*0.15, sliderWidth, sliderHeight);
+    grainReleaseSlider.setBounds(area.getWidth()*0.03+580, area.getHeight()*0.15, sliderWidth, sliderHeight);
     
-    explainLabel.setBounds(area.getWidth()*0.65, area.getHeight()*0.15, 250, 30);
+    explainLabel.setBounds(area.getWidth()*0.72, area.getHeight()*0.15, 250, 30);
     explainLabel.setFont(juce::Font(20));
+    grainSnapBox.setBounds(area.getWidth()*0.72, area.getHeight()*0.15+40, 120, 24);
+    grainSourceBox.setBounds(area.getWidth()*0.72+130, area.getHeight()*0.15+40, 120, 24);
+    grainModeBox.setBounds(area.getWidth()*0.72, area.getHeight()*0.15+72, 120, 24);
+    liveFreezeButton.setBounds(area.getWidth()*0.72+130, area.getHeight()*0.15+72, 120, 24);
     
-    midiKeyboardComponent.setBounds (0, area.getHeight()*0.6, area.getWidth(), area.getHeight()*0.4);
+    waveformDisplay.setBounds(area.getWidth()*0.025, area.getHeight()*0.43, area.getWidth()*0.95, area.getHeight()*0.24);
+    midiKeyboardComponent.setBounds (0, area.getHeight()*0.7, area.getWidth(), area.getHeight()*0.3);
 }
 
 void GranSynthZiAudioProcessorEditor::buttonClicked(juce::Button* button) {
     
     if (button == &openButton){
         // Open a file chooser dialog to select an audio file
-        chooser = std::make_unique<juce::FileChooser>("Select a Wave file to play...",
+        chooser = std::make_unique<juce::FileChooser>("Select Wave files or a folder to play...",
                                                                  juce::File{},
                                                                      "*.wav");
         
         auto chooserFlags = juce::FileBrowserComponent::openMode
-                                    | juce::FileBrowserComponent::canSelectFiles;
+                                    | juce::FileBrowserComponent::canSelectFiles
+                                    | juce::FileBrowserComponent::canSelectDirectories
+                                    | juce::FileBrowserComponent::canSelectMultipleItems;
         
         chooser->launchAsync(chooserFlags, [this](const juce::FileChooser& fc)       // [8]
         {
-            audioProcessor.loadFile(fc.getResult());
+            audioProcessor.loadFiles(fc.getResults());
         });
     }
     
@@ -131,18 +190,8 @@ void GranSynthZiAudioProcessorEditor::buttonClicked(juce::Button* button) {
 
 void GranSynthZiAudioProcessorEditor::sliderValueChanged (juce::Slider* slider)
 {
+    // The grain sliders drive their parameters through the attachments, only the overlap's range follows here
     if (slider == &grainSizeSlider)
-    {
-        audioProcessor.setGrainSize(grainSizeSlider.getValue() / 1000 * audioProcessor.getSampleRate());
         grainOverlapSlider.setNormalisableRange(juce::NormalisableRange<double>(0, grainSizeSlider.getValue()-1, 1.0));
-    }
-    else if(slider == &grainOverlapSlider)
-    {
-        audioProcessor.setGrainOverlap(grainOverlapSlider.getValue() / 1000 * audioProcessor.getSampleRate());
-    }
-    else if(slider == &grainSpacingSlider)
-    {
-        audioProcessor.setGrainSpacing(grainSpacingSlider.getValue() / 1000 * audioProcessor.getSampleRate());
-    }
     
 }
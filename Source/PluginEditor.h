@@ -11,6 +11,7 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "GranSynth.h"
+#include "WaveformDisplay.h"
 
 //==============================================================================
 /**
@@ -46,8 +47,36 @@ private:
     juce::Label grainSpacingLabel;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> grainSpacingAttachment;
     
+    juce::Slider grainAttackSlider;
+    juce::Label grainAttackLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> grainAttackAttachment;
+    
+    juce::Slider grainReleaseSlider;
+    juce::Label grainReleaseLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> grainReleaseAttachment;
+    
+    juce::ComboBox grainEnvelopeBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> grainEnvelopeAttachment;
+    
+    juce::ComboBox grainInterpolationBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> grainInterpolationAttachment;
+    
+    juce::ComboBox grainSnapBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> grainSnapAttachment;
+    
+    juce::ComboBox grainSourceBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> grainSourceAttachment;
+    
+    juce::ComboBox grainModeBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> grainModeAttachment;
+    
+    juce::ToggleButton liveFreezeButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> liveFreezeAttachment;
+    
     juce::Label explainLabel;
     
+    WaveformDisplay waveformDisplay;
+    
     juce::MidiKeyboardState midiKeyboardState;
     juce::MidiKeyboardComponent midiKeyboardComponent {
         midiKeyboardState, juce::MidiKeyboardComponent::horizontalKeyboard };
@@ -9,6 +9,7 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "GranSynth.h"
+#include "SimdKernels.h"
 
 //==============================================================================
 GranSynthZiAudioProcessor::GranSynthZiAudioProcessor()
@@ -17,16 +18,53 @@ GranSynthZiAudioProcessor::GranSynthZiAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #else
+                       .withInput  ("Live Input", juce::AudioChannelSet::stereo(), true)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        ), apvts(*this, nullptr, "PARAMETERS", createParameterLayout())
 #endif
 {
+    // The modulation parameters are read every block, so they are looked up by name only once
+    auto& values = modulationParamValues;
+    for (int l = 0; l < ModulationEngine::numLfos; l++)
+    {
+        auto prefix = "lfo" + juce::String(l + 1);
+        values.lfoRates[l] = apvts.getRawParameterValue(prefix + "Rate");
+        values.lfoShapes[l] = apvts.getRawParameterValue(prefix + "Shape");
+    }
+    
+    values.attack = apvts.getRawParameterValue("modAttack");
+    values.decay = apvts.getRawParameterValue("modDecay");
+    values.sustain = apvts.getRawParameterValue("modSustain");
+    values.release = apvts.getRawParameterValue("modRelease");
+    
+    for (int s = 0; s < ModulationEngine::numSlots; s++)
+    {
+        auto prefix = "mod" + juce::String(s + 1);
+        values.sources[s] = apvts.getRawParameterValue(prefix + "Source");
+        values.destinations[s] = apvts.getRawParameterValue(prefix + "Destination");
+        values.amounts[s] = apvts.getRawParameterValue(prefix + "Amount");
+    }
+    
+    values.controlRate = apvts.getRawParameterValue("modControlRate");
+    
+    startTimerHz(10);
+    
+    engine.setTracer(&tracer);
+    auto tracePath = juce::SystemStats::getEnvironmentVariable("GRANSYNTH_TRACE", {});
+    if (tracePath.isNotEmpty())
+        startTrace(TraceRecorder::getInstanceFile(juce::File::getCurrentWorkingDirectory().getChildFile(tracePath)));
 }
 
 GranSynthZiAudioProcessor::~GranSynthZiAudioProcessor()
 {
+    // A load still running reads the parameters and the live input, which go before analysisPool does;
+    // the generation bump makes it give up at its next check instead of decoding to the end
+    ++loadGeneration;
+    analysisPool.removeAllJobs(true, -1);
+    stopTimer();
 
 }
 
@@ -65,7 +103,8 @@ bool GranSynthZiAudioProcessor::isMidiEffect() const
 
 double GranSynthZiAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // The amplitude release plus the last grain it lets through
+    return *apvts.getRawParameterValue("ampRelease") + *apvts.getRawParameterValue("grainSize") / 1000.0;
 }
 
 int GranSynthZiAudioProcessor::getNumPrograms()
@@ -98,6 +137,13 @@ void GranSynthZiAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     midiMessageCollector.reset (sampleRate);
+    DBG("Grain kernels: " << SimdKernels::get().name);
+    
+    // Voices may have grains reading the old live input, they go with it
+    liveInput.prepare(sampleRate, samplesPerBlock);
+    engine.prepare(samplesPerBlock, sampleRate, maxGrains, maxVoices);
+    engine.setLiveInput(&liveInput);
+    cpuGovernor.prepare(sampleRate, maxVoices);
 }
 
 void GranSynthZiAudioProcessor::releaseResources()
@@ -125,6 +171,12 @@ bool GranSynthZiAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+   #else
+    // The live input is optional, mono or stereo
+    if (! layouts.getMainInputChannelSet().isDisabled()
+     && layouts.getMainInputChannelSet() != juce::AudioChannelSet::mono()
+     && layouts.getMainInputChannelSet() != juce::AudioChannelSet::stereo())
+        return false;
    #endif
 
     return true;
@@ -135,58 +187,117 @@ bool GranSynthZiAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void GranSynthZiAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    TraceRecorder::Span blockSpan(&tracer, "process block", buffer.getNumSamples());
+    cpuGovernor.beginBlock();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
     grainSize = *apvts.getRawParameterValue("grainSize") / 1000 * getSampleRate();
     grainOverlap = *apvts.getRawParameterValue("grainOverlap") / 1000 * getSampleRate();
     grainSpacing = *apvts.getRawParameterValue("grainSpacing") / 1000 * getSampleRate();
+    grainEnvelope = (GrainEnvelope::Shape)(int)*apvts.getRawParameterValue("grainEnvelope");
+    grainAttack = *apvts.getRawParameterValue("grainAttack");
+    grainRelease = *apvts.getRawParameterValue("grainRelease");
+    grainInterpolation = (GrainKernels::Interpolation)(int)*apvts.getRawParameterValue("grainInterpolation");
+    cpuGovernor.setMode((CpuGovernor::Mode)(int)*apvts.getRawParameterValue("cpuGovernor"));
+    if (cpuGovernor.shouldUseLinearInterpolation())
+        grainInterpolation = GrainKernels::Interpolation::linear;
+    grainSnap = (SampleIndex::SnapMode)(int)*apvts.getRawParameterValue("grainSnap");
+    grainSource = (GranSynth::GrainSource)(int)*apvts.getRawParameterValue("grainSource");
+    grainMode = (GranSynth::GrainMode)(int)*apvts.getRawParameterValue("grainMode");
+    spectralParams.smear = *apvts.getRawParameterValue("spectralSmear");
+    spectralParams.freeze = *apvts.getRawParameterValue("spectralFreeze") > 0.5f;
+    unison.streams = (int)*apvts.getRawParameterValue("unisonStreams");
+    unison.detuneCents = *apvts.getRawParameterValue("unisonDetune");
+    unison.positionSpread = (int)(*apvts.getRawParameterValue("unisonPositionSpread") / 1000 * getSampleRate());
+    unison.stereoSpread = *apvts.getRawParameterValue("unisonStereoSpread") / 100.0f;
+    sourceFile = (int)*apvts.getRawParameterValue("sourceFile") - 1;
+    sourceFileSelect = (GranularEngine::SourceFileSelect)(int)*apvts.getRawParameterValue("sourceFileSelect");
+    updateModulationParams();
+    amplitudeEnvelope.attack = *apvts.getRawParameterValue("ampAttack");
+    amplitudeEnvelope.decay = *apvts.getRawParameterValue("ampDecay");
+    amplitudeEnvelope.sustain = *apvts.getRawParameterValue("ampSustain");
+    amplitudeEnvelope.release = *apvts.getRawParameterValue("ampRelease");
+    
+    // Commands queued on the message thread are applied here, between renders
+    engineCommands.drain([this](const EngineCommand& command) { handleCommand(command); });
+    
+    liveDelay = *apvts.getRawParameterValue("liveDelay") / 1000 * getSampleRate();
+    
+    // The input is captured before any voice reads it, then cleared so it does not pass through
+    liveInput.setFrozen(*apvts.getRawParameterValue("liveFreeze") > 0.5f);
+    liveInput.write(buffer, totalNumInputChannels, 0, buffer.getNumSamples());
     
     midiMessageCollector.removeNextBlockOfMessages (midiMessages, buffer.getNumSamples());
+    
+    // Nothing sounds while a restored session's sample is still loading
+    if (sourceLoading)
+    {
+        buffer.clear();
+        return;
+    }
 
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+    // New notes pick up the latest source, unless the loader is publishing one right now
+    {
+        const juce::SpinLock::ScopedTryLockType lock(sourceLock);
+        if (lock.isLocked())
+            engine.setSource(arena, sampleIndex, corpus, loopSeams);
+    }
+    
+    GranularEngine::Parameters engineParameters;
+    engineParameters.grainSize = grainSize;
+    engineParameters.grainOverlap = grainOverlap;
+    engineParameters.grainSpacing = grainSpacing;
+    engineParameters.grainEnvelope = { grainEnvelope, grainAttack, grainRelease };
+    engineParameters.interpolation = grainInterpolation;
+    engineParameters.snapMode = grainSnap;
+    engineParameters.grainSource = grainSource;
+    engineParameters.grainMode = grainMode;
+    engineParameters.spectral = spectralParams;
+    engineParameters.unison = unison;
+    engineParameters.sourceFile = sourceFile;
+    engineParameters.sourceFileSelect = sourceFileSelect;
+    engineParameters.modulation = modulationParams;
+    engineParameters.amplitudeEnvelope = amplitudeEnvelope;
+    engineParameters.liveDelay = liveDelay;
+    engineParameters.cacheGrains = *apvts.getRawParameterValue("grainCache") > 0.5f;
+    engine.setParameters(engineParameters);
+    engine.setGrainCap(cpuGovernor.getGrainCap());
+    engine.setVoiceCap(cpuGovernor.getVoiceCap());
     
+    int numEvents = 0;
+    bool overflowed = false;
     for(const auto metaData: midiMessages){
         auto message = metaData.getMessage();
         
-        if (message.isNoteOn()){
-            
-            double newFrequency = (double) message.getMidiNoteInHertz(message.getNoteNumber());
-            float newVel = message.getFloatVelocity();
-            noteOn(grainSize, grainOverlap, grainSpacing, newFrequency, newVel);
-            
-        } else if (message.isNoteOff()){
-            
-            double frequency = (double) message.getMidiNoteInHertz(message.getNoteNumber());
-            noteOff(frequency);
-            
+        GranularEngine::Event event;
+        if (message.isNoteOn())
+            event = { GranularEngine::Event::Type::noteOn, message.getNoteNumber(), message.getFloatVelocity() };
+        else if (message.isNoteOff())
+            event = { GranularEngine::Event::Type::noteOff, message.getNoteNumber(), 0.0f };
+        else if (message.isAllNotesOff() || message.isAllSoundOff())
+            event = { GranularEngine::Event::Type::allNotesOff, 0, 0.0f };
+        else
+            continue;
+        
+        //a flood past the array would lose note-offs, so the last slot releases everything instead
+        if (numEvents == maxEventsPerBlock)
+        {
+            overflowed = true;
+            break;
         }
+        engineEvents[(size_t)numEvents++] = event;
     }
+    if (overflowed)
+        engineEvents[(size_t)maxEventsPerBlock - 1] = { GranularEngine::Event::Type::allNotesOff, 0, 0.0f };
     
-    auto it = granSynthBank.begin();
+    engine.render(buffer.getArrayOfWritePointers(), totalNumOutputChannels, buffer.getNumSamples(),
+                  engineEvents.data(), numEvents);
     
-    for(auto& granSynthTone : granSynthBank){
-                    
-        if (granSynthTone.shouldBeRemoved()) {
-            granSynthBank.erase(it);
-            break;
-        }
-        
-        it++;
-
-    }
+    int numPositions = engine.getGrainPositions(grainPositionScratch.data(), (int)grainPositionScratch.size());
+    grainPositions.push(grainPositionScratch.data(), numPositions);
     
-    for(auto& granSynthTone : granSynthBank){
-        granSynthTone.processBlock(buffer);
-//        granSynthTone.updateTote();
-    }
+    cpuGovernor.endBlock(buffer.getNumSamples(), engine.getNumGrains());
 
 }
 
@@ -209,6 +320,20 @@ void GranSynthZiAudioProcessor::getStateInformation (juce::MemoryBlock& destData
     // as intermediaries to make it easy to save and load complex data.
     
     auto state = apvts.copyState();
+    
+    // The loaded files are saved by path, with their cache key (a hash of the paths, sizes and modification
+    // times) under "hash"; restoring only uses the key when a saved file is missing, to load it from the cache
+    state.removeChild(state.getChildWithName("Source"), nullptr);
+    {
+        const juce::ScopedLock lock(sourceInfoLock);
+        juce::ValueTree source("Source");
+        source.setProperty("hash", juce::String::toHexString((juce::int64)loadedCacheKey), nullptr);
+        source.setProperty("storage", (int)loadedStorage, nullptr);
+        for (auto& file : loadedFiles)
+            source.appendChild(juce::ValueTree("File").setProperty("path", file.getFullPathName(), nullptr), nullptr);
+        state.appendChild(source, nullptr);
+    }
+    
         std::unique_ptr<juce::XmlElement> xml(state.createXml());
         copyXmlToBinary(*xml, destData);
     
@@ -223,81 +348,253 @@ void GranSynthZiAudioProcessor::setStateInformation (const void* data, int sizeI
         
         if (xmlState.get() != nullptr) {
             if (xmlState->hasTagName(apvts.state.getType()))
-                apvts.replaceState(juce::ValueTree::fromXml(*xmlState));
+            {
+                auto state = juce::ValueTree::fromXml(*xmlState);
+                auto source = state.getChildWithName("Source");
+                state.removeChild(source, nullptr);
+                apvts.replaceState(state);
+                
+                // The old session's voices have nothing to do with the new one. Hosts can call this
+                // from any thread, so the timer queues the reset from the message thread
+                voicesNeedReset = true;
+                if (source.isValid())
+                    restoreSource(source);
+            }
         }
     
 }
 
-void GranSynthZiAudioProcessor::noteOn(int grainSize, int grainOverlap, int grainSpacing, double frequency, float velocity)
+void GranSynthZiAudioProcessor::updateModulationParams()
 {
+    static const int controlIntervals[] = { 8, 16, 32, 64 };
+    auto& values = modulationParamValues;
     
-    if (granSynthBank.size() >= 5) {
-            return;
+    for (int l = 0; l < ModulationEngine::numLfos; l++)
+    {
+        modulationParams.lfoRates[l] = *values.lfoRates[l];
+        modulationParams.lfoShapes[l] = (ModulationEngine::LfoShape)(int)*values.lfoShapes[l];
     }
     
-    for(auto& note : granSynthBank){
-        if (note.getFreq() == frequency) {
-            return;
-        }
-    }
+    modulationParams.envelope.attack = *values.attack;
+    modulationParams.envelope.decay = *values.decay;
+    modulationParams.envelope.sustain = *values.sustain;
+    modulationParams.envelope.release = *values.release;
     
-    GranSynth granSynthTone(audioBuffer, frequency, velocity);
-    granSynthTone.setGrainParameters(grainSize, grainOverlap, grainSpacing);
+    for (int s = 0; s < ModulationEngine::numSlots; s++)
+    {
+        auto& slot = modulationParams.slots[s];
+        slot.source = (ModulationEngine::Source)(int)*values.sources[s];
+        slot.destination = (ModulationEngine::Destination)(int)*values.destinations[s];
+        slot.amount = *values.amounts[s];
+    }
     
-    granSynthTone.prepareToPlay(getSampleRate(), getBlockSize());
-    granSynthBank.push_back(granSynthTone);
+    modulationParams.controlInterval = controlIntervals[(int)*values.controlRate];
+}
+
+void GranSynthZiAudioProcessor::restoreSource(const juce::ValueTree& source)
+{
+    juce::Array<juce::File> files;
+    for (auto child : source)
+        if (child.hasType("File"))
+            files.add(juce::File(child["path"].toString()));
     
+    if (files.isEmpty())
+        return;
     
+    // Returns straight away, voices stay silent until the sample is back
+    auto storage = (SampleArena::Format)(int)source["storage"];
+    auto savedCacheKey = (juce::uint64)source["hash"].toString().getHexValue64();
+    sourceLoading = true;
+    startLoading(files, storage, savedCacheKey);
 }
 
-void  GranSynthZiAudioProcessor::noteOff(double frequency){
-    for(auto& granSynth : granSynthBank){
-        if (granSynth.getFreq() == frequency) {
-            granSynth.setReleased();
-        }
+void GranSynthZiAudioProcessor::resetVoices() {
+    engineCommands.push({ EngineCommand::Type::resetVoices });
+}
+
+void GranSynthZiAudioProcessor::handleCommand(const EngineCommand& command)
+{
+    // Runs on the audio thread, the voices are never touched from anywhere else
+    switch (command.type)
+    {
+        case EngineCommand::Type::resetVoices:
+            engine.reset();
+            break;
     }
 }
 
-void GranSynthZiAudioProcessor::setGrainSize(int newGrainSize) { 
-    grainSize = newGrainSize;
-    for (auto& gst: granSynthBank) 
-        gst.setGrainParameters(grainSize, grainOverlap, grainSpacing);
+void GranSynthZiAudioProcessor::loadFile(const juce::File& file)
+{
+    loadFiles({ file });
 }
 
-void GranSynthZiAudioProcessor::setGrainOverlap(int newGrainOverlap) {
-    grainOverlap = newGrainOverlap;
-    for (auto& gst: granSynthBank) 
-        gst.setGrainParameters(grainSize, grainOverlap, grainSpacing);
+void GranSynthZiAudioProcessor::loadFiles(const juce::Array<juce::File>& files)
+{
+    // Folders contribute the audio files directly inside them
+    juce::Array<juce::File> audioFiles;
+    for (auto& file : files)
+    {
+        if (file.isDirectory())
+            audioFiles.addArray(SampleArena::findAudioFiles(file));
+        else
+            audioFiles.add(file);
+    }
+
+    auto storage = (SampleArena::Format)(int)*apvts.getRawParameterValue("sampleStorage");
+    startLoading(audioFiles, storage, 0);
 }
 
-void GranSynthZiAudioProcessor::setGrainSpacing(int newGrainSpacing) {
-    grainSpacing = newGrainSpacing;
-    for (auto& gst: granSynthBank)
-        gst.setGrainParameters(grainSize, grainOverlap, grainSpacing);
+int GranSynthZiAudioProcessor::getAudioSize() const
+{
+    const juce::SpinLock::ScopedLockType lock(sourceLock);
+    return arena != nullptr ? arena->getTotalSize() : 0;
 }
 
-void GranSynthZiAudioProcessor::loadFile(const juce::File& file)
+PeakPyramid::Ptr GranSynthZiAudioProcessor::getPeakPyramid() const
 {
-    // Load the audio file directly into the member audioBuffer
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    const juce::SpinLock::ScopedLockType lock(sourceLock);
+    return peaks;
+}
+
+PeakPyramid::Ptr GranSynthZiAudioProcessor::buildPeaks(SampleArena::Ptr forArena)
+{
+    auto newPeaks = PeakPyramid::build(forArena);
+    
+    const juce::SpinLock::ScopedLockType lock(sourceLock);
+    if (arena == forArena)
+        peaks = newPeaks;
+    return newPeaks;
+}
 
-    if (reader != nullptr)
+void GranSynthZiAudioProcessor::startLoading(const juce::Array<juce::File>& files, SampleArena::Format storage,
+                                             juce::uint64 savedCacheKey)
+{
+    // Decoding and analysis happen on analysisPool, a newer load makes older ones drop their results
+    int generation = ++loadGeneration;
+    analysisPool.addJob([this, files, storage, savedCacheKey, generation]
     {
-        // Assuming a mono audio file for simplicity
-        const int numChannels = 1;
-        const int numSamples = (int)reader->lengthInSamples;
+        loadInBackground(files, storage, savedCacheKey, generation);
+    });
+}
 
-        audioBuffer.setSize(numChannels, numSamples);
-        reader->read(&audioBuffer, 0, numSamples, 0, true, true);
+void GranSynthZiAudioProcessor::loadInBackground(const juce::Array<juce::File>& files, SampleArena::Format storage,
+                                                 juce::uint64 savedCacheKey, int generation)
+{
+    // Files that went missing since the session was saved can still come back from the cache
+    bool allFilesFound = ! files.isEmpty()
+                      && std::all_of(files.begin(), files.end(), [](const juce::File& f) { return f.existsAsFile(); });
+    auto cacheKey = allFilesFound ? SampleCache::computeKey(files, storage) : savedCacheKey;
+    
+    // A cache hit brings its overview along, nothing is decoded or measured
+    SampleCache::Entry cached;
+    if (SampleCache::load(cacheKey, cached))
+    {
+        publishSource(cached, files, cacheKey, generation);
+        return;
+    }
+    
+    // Every file goes into one arena, voices pick theirs by index. A newer load, or the processor
+    // going away, stops this one between decoded blocks and analysis steps
+    auto superseded = [this, generation] { return generation != loadGeneration; };
+    auto newArena = allFilesFound ? SampleArena::loadFiles(files, storage, superseded) : nullptr;
+    if (newArena == nullptr || newArena->getNumRegions() == 0)
+    {
+        if (generation == loadGeneration)
+            sourceLoading = false;
+        return;
+    }
+    
+    // Voices can start on the new arena while it is analysed, the overview comes first
+    if (! publishSource({ newArena, nullptr, nullptr, nullptr }, files, cacheKey, generation))
+        return;
+    auto newPeaks = buildPeaks(newArena);
+    
+    // Find onsets and zero crossings and build the feature corpus file by file, each at its own
+    // sample rate, into one index and corpus so corpus grains can come from any file.
+    // 16 bit arenas are widened a frame at a time.
+    if (superseded())
+        return;
+    auto newIndex = SampleIndex::build(*newArena);
+    if (superseded())
+        return;
+    auto newCorpus = GrainCorpus::build(*newArena);
+    {
+        const juce::SpinLock::ScopedLockType lock(sourceLock);
+        if (arena == newArena)
+        {
+            sampleIndex = newIndex;
+            corpus = newCorpus;
+        }
+    }
+    
+    SampleCache::save(cacheKey, { newArena, newIndex, newCorpus, newPeaks });
+}
+
+LoopSeams::Settings GranSynthZiAudioProcessor::getLoopSettings() const
+{
+    LoopSeams::Settings settings;
+    settings.start = *apvts.getRawParameterValue("loopStart") / 100.0f;
+    settings.end = *apvts.getRawParameterValue("loopEnd") / 100.0f;
+    settings.crossfadeSeconds = *apvts.getRawParameterValue("loopCrossfade") / 1000.0f;
+    return settings;
+}
 
-//        // Normalize the audio buffer
-//        audioBuffer.applyGain(1.0 / audioBuffer.getRMSLevel(0));
+void GranSynthZiAudioProcessor::timerCallback()
+{
+    if (voicesNeedReset.exchange(false))
+        resetVoices();
+    
+    // Frees whatever sources the audio thread let go of since the last tick
+    engine.releasePending();
+    
+    // The seams are only a few thousand samples per file, rebuilding them here keeps the audio thread out of it.
+    // While a loop control is still moving they wait for it to hold still for a tick, instead of being
+    // rebuilt, and every voice's looped grains dropped, ten times a second
+    auto settings = getLoopSettings();
+    bool settled = settings == lastLoopSettings;
+    lastLoopSettings = settings;
+    
+    SampleArena::Ptr currentArena;
+    {
+        const juce::SpinLock::ScopedLockType lock(sourceLock);
+        if (arena == nullptr || ! settled
+            || (loopSeams != nullptr && loopSeams->isFor(arena.get()) && loopSeams->getSettings() == settings))
+            return;
+        currentArena = arena;
+    }
+    
+    auto newLoopSeams = LoopSeams::build(currentArena, settings);
+    
+    const juce::SpinLock::ScopedLockType lock(sourceLock);
+    if (arena == currentArena)
+        loopSeams = newLoopSeams;
+}
 
-        // Reset the position to the beginning
-//        audioPosition = 0;
+bool GranSynthZiAudioProcessor::publishSource(const SampleCache::Entry& entry, const juce::Array<juce::File>& files,
+                                              juce::uint64 cacheKey, int generation)
+{
+    auto newLoopSeams = LoopSeams::build(entry.arena, getLoopSettings());
+    {
+        const juce::SpinLock::ScopedLockType lock(sourceLock);
+        if (generation != loadGeneration)
+            return false;
+        
+        arena = entry.arena;
+        sampleIndex = entry.sampleIndex;
+        corpus = entry.corpus;
+        loopSeams = newLoopSeams;
+        peaks = entry.peaks;
     }
+    
+    {
+        const juce::ScopedLock lock(sourceInfoLock);
+        loadedFiles = files;
+        loadedCacheKey = cacheKey;
+        loadedStorage = entry.arena->getFormat();
+    }
+    
+    sourceLoading = false;
+    return true;
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout GranSynthZiAudioProcessor::createParameterLayout()
@@ -319,6 +616,134 @@ juce::AudioProcessorValueTreeState::ParameterLayout GranSynthZiAudioProcessor::c
                                                            juce::NormalisableRange<float>(1.0, 200.0, 1.0),
                                                            20.0f));
 
+    layout.add(std::make_unique<juce::AudioParameterChoice>(grainEnvelopeId, "Grain Envelope",
+                                                            juce::StringArray { "Trapezoid", "Hann" },
+                                                            0));
+
+    // Attack and release of the trapezoid envelope, in percent of the grain size
+    layout.add(std::make_unique<juce::AudioParameterFloat>(grainAttackId, "Grain Attack",
+                                                           juce::NormalisableRange<float>(0.0, 50.0, 0.1),
+                                                           1.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(grainReleaseId, "Grain Release",
+                                                           juce::NormalisableRange<float>(0.0, 50.0, 0.1),
+                                                           1.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>(grainInterpolationId, "Grain Interpolation",
+                                                            juce::StringArray { "Linear", "Cubic" },
+                                                            0));
+
+    // Snaps grain starts to the analysed zero crossings or onsets
+    layout.add(std::make_unique<juce::AudioParameterChoice>(grainSnapId, "Grain Snap",
+                                                            juce::StringArray { "Off", "Zero Crossing", "Onset" },
+                                                            0));
+
+    // Whether grains follow the file position or are picked from the corpus by note and velocity
+    layout.add(std::make_unique<juce::AudioParameterChoice>(grainSourceId, "Grain Source",
+                                                            juce::StringArray { "File Position", "Corpus", "Live Input" },
+                                                            0));
+
+    // Time-domain grains resample their source; spectral grains move its partials, smear and freeze its spectrum
+    layout.add(std::make_unique<juce::AudioParameterChoice>(grainModeId, "Grain Mode",
+                                                            juce::StringArray { "Time", "Spectral" },
+                                                            0));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(spectralSmearId, "Spectral Smear",
+                                                           juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterBool>(spectralFreezeId, "Spectral Freeze", false));
+
+    // Grain streams per voice, spread in pitch, file position and pan; short grains of all of them render together
+    layout.add(std::make_unique<juce::AudioParameterInt>(unisonStreamsId, "Unison", 1, GranSynth::maxUnisonStreams, 1));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(unisonDetuneId, "Unison Detune",
+                                                           juce::NormalisableRange<float>(0.0f, 100.0f, 0.1f), 15.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(unisonPositionSpreadId, "Unison Position Spread",
+                                                           juce::NormalisableRange<float>(0.0f, 500.0f, 1.0f, 0.5f), 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(unisonStereoSpreadId, "Unison Stereo Spread",
+                                                           juce::NormalisableRange<float>(0.0f, 100.0f, 1.0f), 50.0f));
+
+    // Repeated grains are rendered once in the background and mixed from memory after that, for repetitive patches
+    layout.add(std::make_unique<juce::AudioParameterBool>(grainCacheId, "Grain Cache", false));
+
+    // Live input grains start this far behind the input; freezing stops recording and keeps granulating what is there
+    layout.add(std::make_unique<juce::AudioParameterFloat>(liveDelayId, "Live Delay",
+                                                           juce::NormalisableRange<float>(0.0f, 2000.0f, 1.0f, 0.5f),
+                                                           100.0f));
+    layout.add(std::make_unique<juce::AudioParameterBool>(liveFreezeId, "Live Freeze", false));
+
+    // Which of the loaded files a voice plays: the Source File parameter, one per key, or a new one per grain
+    layout.add(std::make_unique<juce::AudioParameterInt>(sourceFileId, "Source File", 1, 128, 1));
+
+    // The part of every file the play position loops over, in percent of its length, with a crossfade across the seam
+    layout.add(std::make_unique<juce::AudioParameterFloat>(loopStartId, "Loop Start",
+                                                           juce::NormalisableRange<float>(0.0f, 100.0f, 0.1f), 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(loopEndId, "Loop End",
+                                                           juce::NormalisableRange<float>(0.0f, 100.0f, 0.1f), 100.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(loopCrossfadeId, "Loop Crossfade",
+                                                           juce::NormalisableRange<float>(0.0f, 500.0f, 1.0f, 0.5f), 20.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>(sourceFileSelectId, "Source File Select",
+                                                            juce::StringArray { "Fixed", "By Note", "Per Grain" },
+                                                            0));
+
+    // Amplitude envelope of each voice
+    layout.add(std::make_unique<juce::AudioParameterFloat>(ampAttackId, "Attack",
+                                                           juce::NormalisableRange<float>(0.0f, 5.0f, 0.001f, 0.4f), 0.01f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(ampDecayId, "Decay",
+                                                           juce::NormalisableRange<float>(0.0f, 5.0f, 0.001f, 0.4f), 0.1f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(ampSustainId, "Sustain",
+                                                           juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 1.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(ampReleaseId, "Release",
+                                                           juce::NormalisableRange<float>(0.0f, 10.0f, 0.001f, 0.4f), 0.3f));
+
+    // Modulation: two LFOs and an envelope, plus velocity and key, routed through four matrix slots
+    for (int l = 1; l <= ModulationEngine::numLfos; l++)
+    {
+        auto prefix = "lfo" + juce::String(l);
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(prefix + "Rate", 1), "LFO " + juce::String(l) + " Rate",
+                                                               juce::NormalisableRange<float>(0.01f, 20.0f, 0.01f, 0.3f),
+                                                               1.0f));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(prefix + "Shape", 1), "LFO " + juce::String(l) + " Shape",
+                                                                juce::StringArray { "Sine", "Triangle", "Saw", "Square" },
+                                                                0));
+    }
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(modAttackId, "Mod Env Attack",
+                                                           juce::NormalisableRange<float>(0.0f, 5.0f, 0.001f, 0.4f), 0.1f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(modDecayId, "Mod Env Decay",
+                                                           juce::NormalisableRange<float>(0.0f, 5.0f, 0.001f, 0.4f), 0.5f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(modSustainId, "Mod Env Sustain",
+                                                           juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.5f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(modReleaseId, "Mod Env Release",
+                                                           juce::NormalisableRange<float>(0.0f, 5.0f, 0.001f, 0.4f), 0.5f));
+
+    for (int s = 1; s <= ModulationEngine::numSlots; s++)
+    {
+        auto prefix = "mod" + juce::String(s);
+        auto name = "Mod " + juce::String(s);
+        layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(prefix + "Source", 1), name + " Source",
+                                                                juce::StringArray { "Off", "LFO 1", "LFO 2", "Envelope", "Velocity", "Key" },
+                                                                0));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(prefix + "Destination", 1), name + " Destination",
+                                                                juce::StringArray { "Grain Size", "Density", "Position", "Pitch", "Pan" },
+                                                                0));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(prefix + "Amount", 1), name + " Amount",
+                                                               juce::NormalisableRange<float>(-1.0f, 1.0f, 0.01f), 0.0f));
+    }
+
+    // Samples between modulation control points
+    layout.add(std::make_unique<juce::AudioParameterChoice>(modControlRateId, "Mod Control Rate",
+                                                            juce::StringArray { "8", "16", "32", "64" },
+                                                            2));
+
+    // What gives way when rendering gets close to the block deadline
+    layout.add(std::make_unique<juce::AudioParameterChoice>(cpuGovernorId, "CPU Governor",
+                                                            juce::StringArray { "Off", "Thin Grains", "Thin Grains + Linear" },
+                                                            1));
+
+    // How loaded files are held in memory, takes effect on the next load
+    layout.add(std::make_unique<juce::AudioParameterChoice>(sampleStorageId, "Sample Storage",
+                                                            juce::StringArray { "32-bit Float", "16-bit Integer", "16-bit Half Float" },
+                                                            0));
+
     return layout;
 }
 
@@ -9,12 +9,18 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "GranSynth.h"
+#include "GranularEngine.h"
+#include "SampleCache.h"
+#include "CpuGovernor.h"
+#include "PeakPyramid.h"
+#include "GrainPositionFifo.h"
+#include "CommandFifo.h"
 
 //==============================================================================
 /**
 */
-class GranSynthZiAudioProcessor  : public juce::AudioProcessor
+class GranSynthZiAudioProcessor  : public juce::AudioProcessor,
+                                   private juce::Timer
 {
 public:
     //==============================================================================
@@ -60,35 +66,158 @@ public:
     juce::ParameterID grainSizeId = juce::ParameterID("grainSize", 1);
     juce::ParameterID grainOverlapId = juce::ParameterID("grainOverlap", 1);
     juce::ParameterID grainSpacingId = juce::ParameterID("grainSpacing", 1);
+    juce::ParameterID grainEnvelopeId = juce::ParameterID("grainEnvelope", 1);
+    juce::ParameterID grainAttackId = juce::ParameterID("grainAttack", 1);
+    juce::ParameterID grainReleaseId = juce::ParameterID("grainRelease", 1);
+    juce::ParameterID grainInterpolationId = juce::ParameterID("grainInterpolation", 1);
+    juce::ParameterID grainSnapId = juce::ParameterID("grainSnap", 1);
+    juce::ParameterID grainSourceId = juce::ParameterID("grainSource", 1);
+    juce::ParameterID grainModeId = juce::ParameterID("grainMode", 1);
+    juce::ParameterID spectralSmearId = juce::ParameterID("spectralSmear", 1);
+    juce::ParameterID spectralFreezeId = juce::ParameterID("spectralFreeze", 1);
+    juce::ParameterID sourceFileId = juce::ParameterID("sourceFile", 1);
+    juce::ParameterID sourceFileSelectId = juce::ParameterID("sourceFileSelect", 1);
+    juce::ParameterID sampleStorageId = juce::ParameterID("sampleStorage", 1);
+    juce::ParameterID ampAttackId = juce::ParameterID("ampAttack", 1);
+    juce::ParameterID ampDecayId = juce::ParameterID("ampDecay", 1);
+    juce::ParameterID ampSustainId = juce::ParameterID("ampSustain", 1);
+    juce::ParameterID ampReleaseId = juce::ParameterID("ampRelease", 1);
+    juce::ParameterID modAttackId = juce::ParameterID("modAttack", 1);
+    juce::ParameterID modDecayId = juce::ParameterID("modDecay", 1);
+    juce::ParameterID modSustainId = juce::ParameterID("modSustain", 1);
+    juce::ParameterID modReleaseId = juce::ParameterID("modRelease", 1);
+    juce::ParameterID modControlRateId = juce::ParameterID("modControlRate", 1);
+    juce::ParameterID liveDelayId = juce::ParameterID("liveDelay", 1);
+    juce::ParameterID liveFreezeId = juce::ParameterID("liveFreeze", 1);
+    juce::ParameterID cpuGovernorId = juce::ParameterID("cpuGovernor", 1);
+    juce::ParameterID loopStartId = juce::ParameterID("loopStart", 1);
+    juce::ParameterID loopEndId = juce::ParameterID("loopEnd", 1);
+    juce::ParameterID loopCrossfadeId = juce::ParameterID("loopCrossfade", 1);
+    juce::ParameterID unisonStreamsId = juce::ParameterID("unisonStreams", 1);
+    juce::ParameterID unisonDetuneId = juce::ParameterID("unisonDetune", 1);
+    juce::ParameterID unisonPositionSpreadId = juce::ParameterID("unisonPositionSpread", 1);
+    juce::ParameterID unisonStereoSpreadId = juce::ParameterID("unisonStereoSpread", 1);
+    juce::ParameterID grainCacheId = juce::ParameterID("grainCache", 1);
     
-    int getGrainSize() const { return grainSize; }
-    void setGrainSize(int newGrainSize);
+    // Drops every playing voice at the start of the next block. Queues a command for the audio
+    // thread, call it from the message thread only
+    void resetVoices();
     
-    int getGrainOverlap() const { return grainOverlap; }
-    void setGrainOverlap(int newGrainOverlap);
+    int getAudioSize() const;
     
-    int getGrainSpacing() const { return grainSpacing; }
-    void setGrainSpacing(int newGrainSpacing) ;
+    // The loaded sample's overview, null until it has been built
+    PeakPyramid::Ptr getPeakPyramid() const;
+    GrainPositionFifo& getGrainPositionFifo() noexcept { return grainPositions; }
     
-    int getAudioSize() const { return audioBuffer.getNumSamples(); }
+    // Smoothed render time as a fraction of the block's duration
+    float getCpuLoad() const { return cpuGovernor.getLoad(); }
     
     juce::MidiMessageCollector& getMidiMessageCollector() noexcept { return midiMessageCollector; }
     
     void loadFile(const juce::File& file);
+    void loadFiles(const juce::Array<juce::File>& files);
     
-    void noteOn(int grainSize, int grainOverlap, int grainSpacing, double frequency, float velocity);
-    void noteOff(double frequency);
+    // Records what the audio thread does into a Chrome / Perfetto trace until stopTrace. Also started
+    // at construction when the GRANSYNTH_TRACE environment variable names a file, with the process
+    // id and instance number added to its name.
+    bool startTrace(const juce::File& file) { return tracer.start(file); }
+    void stopTrace() { tracer.stop(); }
 
 private:
     
+    void startLoading(const juce::Array<juce::File>& files, SampleArena::Format storage, juce::uint64 savedCacheKey);
+    void loadInBackground(const juce::Array<juce::File>& files, SampleArena::Format storage,
+                          juce::uint64 savedCacheKey, int generation);
+    bool publishSource(const SampleCache::Entry& entry, const juce::Array<juce::File>& files,
+                       juce::uint64 cacheKey, int generation);
+    void restoreSource(const juce::ValueTree& source);
+    PeakPyramid::Ptr buildPeaks(SampleArena::Ptr forArena);
+    LoopSeams::Settings getLoopSettings() const;
+    void timerCallback() override;
+    
+    struct EngineCommand
+    {
+        enum class Type
+        {
+            resetVoices = 0
+        };
+        
+        Type type = Type::resetVoices;
+    };
+    
+    void handleCommand(const EngineCommand& command);
+    void updateModulationParams();
+    
+    static constexpr int maxVoices = 5;
+    static constexpr int maxGrains = 4096;
+    static constexpr int maxEventsPerBlock = 256;
+    
+    TraceRecorder tracer; // outlives the engine, which records into it
+    CommandFifo<EngineCommand, 256> engineCommands;
     juce::MidiMessageCollector midiMessageCollector;
-    juce::AudioBuffer<float> audioBuffer;
-    std::vector<GranSynth> granSynthBank;
+    GranularEngine engine;
+    std::array<GranularEngine::Event, maxEventsPerBlock> engineEvents;
+    CpuGovernor cpuGovernor;
     int grainSize;
     int grainOverlap;
     int grainSpacing;
+    GrainEnvelope::Shape grainEnvelope = GrainEnvelope::Shape::trapezoid;
+    float grainAttack = 1.0f;
+    float grainRelease = 1.0f;
+    GrainKernels::Interpolation grainInterpolation = GrainKernels::Interpolation::linear;
+    SampleIndex::SnapMode grainSnap = SampleIndex::SnapMode::off;
+    GranSynth::GrainSource grainSource = GranSynth::GrainSource::filePosition;
+    GranSynth::GrainMode grainMode = GranSynth::GrainMode::time;
+    SpectralGrains::Parameters spectralParams;
+    GranSynth::Unison unison;
+    int sourceFile = 0;
+    GranularEngine::SourceFileSelect sourceFileSelect = GranularEngine::SourceFileSelect::fixed;
+    ModulationEngine::Parameters modulationParams;
+    juce::ADSR::Parameters amplitudeEnvelope;
+    int liveDelay = 4410;
+    
+    struct ModulationParamValues
+    {
+        std::atomic<float>* lfoRates[ModulationEngine::numLfos];
+        std::atomic<float>* lfoShapes[ModulationEngine::numLfos];
+        std::atomic<float>* attack;
+        std::atomic<float>* decay;
+        std::atomic<float>* sustain;
+        std::atomic<float>* release;
+        std::atomic<float>* sources[ModulationEngine::numSlots];
+        std::atomic<float>* destinations[ModulationEngine::numSlots];
+        std::atomic<float>* amounts[ModulationEngine::numSlots];
+        std::atomic<float>* controlRate;
+    };
+    ModulationParamValues modulationParamValues;
     int fileIndex = 0;
     
+    // every loaded file, plus its onset / zero crossing index and feature corpus filled in by analysisPool
+    SampleArena::Ptr arena;
+    SampleIndex::Ptr sampleIndex;
+    GrainCorpus::Ptr corpus;
+    LoopSeams::Ptr loopSeams; // rebuilt on the message thread when the loop parameters move
+    LoopSeams::Settings lastLoopSettings; // as the timer saw them last tick, message thread only
+    PeakPyramid::Ptr peaks;
+    mutable juce::SpinLock sourceLock;
+    
+    // grain positions for the editor's overview, published at the end of every block
+    GrainPositionFifo grainPositions;
+    std::array<int, 1024> grainPositionScratch;
+    
+    // what the current arena was loaded from, saved with the session
+    juce::Array<juce::File> loadedFiles;
+    juce::uint64 loadedCacheKey = 0;
+    SampleArena::Format loadedStorage = SampleArena::Format::float32;
+    juce::CriticalSection sourceInfoLock;
+    std::atomic<int> loadGeneration { 0 };
+    std::atomic<bool> sourceLoading { false };
+    std::atomic<bool> voicesNeedReset { false }; // set by setStateInformation on any thread, acted on by the timer
+    juce::ThreadPool analysisPool { 1 };
+    
+    // the audio input, captured every block for live grains; voices playing it need no file
+    LiveInputBuffer liveInput;
+    
     juce::AudioProcessorValueTreeState apvts;
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     
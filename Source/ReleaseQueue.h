@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    ReleaseQueue.h
+    Created: 26 Oct 2026 10:12:48am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "CommandFifo.h"
+
+
+// Takes the references the audio thread lets go of and drops them on another
+// thread, so a replaced arena, index, corpus or set of seams is never freed
+// inside the callback however it was the last thing holding it. The audio
+// thread retires, one other thread, e.g. a timer on the message thread, calls
+// releasePending every so often.
+class ReleaseQueue
+{
+public:
+
+    ~ReleaseQueue() { releasePending(); }
+
+    // Audio thread: takes over ptr's reference and leaves it null. Only if the queue is full
+    // is the reference dropped right here, as it would have been without the queue
+    template <typename Object>
+    void retire(juce::ReferenceCountedObjectPtr<Object>& ptr) noexcept
+    {
+        if (ptr == nullptr)
+            return;
+
+        juce::ReferenceCountedObject* object = ptr.get();
+        object->incReferenceCount();
+        if (! pending.push(object))
+            object->decReferenceCount();
+        ptr = nullptr;
+    }
+
+    // Releasing thread: drops every reference retired so far, running whatever destructors that takes
+    void releasePending()
+    {
+        pending.drain([](juce::ReferenceCountedObject* object) { object->decReferenceCount(); });
+    }
+
+private:
+
+    // a note on can retire its voice's arena, index, corpus and seams; this covers a flood of them between drains
+    CommandFifo<juce::ReferenceCountedObject*, 4096> pending;
+};
@@ -0,0 +1,251 @@
+/*
+  ==============================================================================
+
+    SampleArena.cpp
+    Created: 20 Oct 2026 1:15:42pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "SampleArena.h"
+
+#include "SimdKernels.h"
+
+static constexpr int alignmentInBytes = 64;
+static constexpr int alignmentInSamples = alignmentInBytes / 2; // whole cache lines in every format
+
+static int roundUpToAlignment(int numSamples)
+{
+    return (numSamples + alignmentInSamples - 1) / alignmentInSamples * alignmentInSamples;
+}
+
+static juce::uint16 floatToHalf(float value) noexcept
+{
+    //round to nearest even, quiet samples become denormals, out of range values saturate
+    juce::uint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto sign = (juce::uint16)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    juce::uint32 mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31)
+        return (juce::uint16)(sign | 0x7bff);
+    if (exponent < -10)
+        return sign;
+
+    int shift = 13;
+    juce::uint32 half;
+    if (exponent > 0)
+    {
+        half = ((juce::uint32)exponent << 10) | (mantissa >> shift);
+    }
+    else
+    {
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    }
+
+    juce::uint32 remainder = mantissa & ((1u << shift) - 1);
+    juce::uint32 halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+        half++;
+    return (juce::uint16)(sign | juce::jmin(half, (juce::uint32)0x7bff));
+}
+
+SampleArena::SampleArena(Format storageFormat)
+    : format(storageFormat),
+      bytesPerSample(getBytesPerSample(storageFormat))
+{
+}
+
+int SampleArena::getBytesPerSample(Format format) noexcept
+{
+    return format == Format::float32 ? (int)sizeof(float) : (int)sizeof(juce::int16);
+}
+
+void SampleArena::allocate(const std::vector<int>& lengths)
+{
+    regions.resize(lengths.size());
+
+    //every region starts aligned and is followed by at least guardSamples zeros
+    int position = roundUpToAlignment(guardSamples);
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        regions[i].offset = position;
+        regions[i].length = lengths[i];
+        position = roundUpToAlignment(position + lengths[i] + guardSamples);
+    }
+    totalSize = position;
+
+    storage.calloc((size_t)totalSize * (size_t)bytesPerSample + alignmentInBytes);
+    data = storage.get();
+    while ((reinterpret_cast<juce::pointer_sized_int>(data) & (alignmentInBytes - 1)) != 0)
+        data++;
+}
+
+void SampleArena::writeSamples(const float* source, int startSample, int numSamples) noexcept
+{
+    if (format == Format::float32)
+    {
+        std::copy(source, source + numSamples, reinterpret_cast<float*>(data) + startSample);
+    }
+    else if (format == Format::int16)
+    {
+        auto dest = reinterpret_cast<juce::int16*>(data) + startSample;
+        for (int i = 0; i < numSamples; i++)
+            dest[i] = (juce::int16)juce::roundToInt(juce::jlimit(-1.0f, 1.0f, source[i]) * 32767.0f);
+    }
+    else
+    {
+        auto dest = reinterpret_cast<juce::uint16*>(data) + startSample;
+        for (int i = 0; i < numSamples; i++)
+            dest[i] = floatToHalf(source[i]);
+    }
+}
+
+void SampleArena::readSamples(float* dest, int startSample, int numSamples) const noexcept
+{
+    if (format == Format::float32)
+        std::copy_n(reinterpret_cast<const float*>(data) + startSample, numSamples, dest);
+    else if (format == Format::int16)
+        SimdKernels::get().decodeInt16(dest, reinterpret_cast<const juce::int16*>(data) + startSample, numSamples);
+    else
+        SimdKernels::get().decodeHalf(dest, reinterpret_cast<const juce::uint16*>(data) + startSample, numSamples);
+}
+
+SampleArena::Ptr SampleArena::loadFiles(const juce::Array<juce::File>& files, Format format,
+                                        const std::function<bool()>& shouldStop)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    //open everything first so the arena is allocated exactly once
+    std::vector<std::unique_ptr<juce::AudioFormatReader>> readers;
+    std::vector<juce::String> names;
+    std::vector<int> lengths;
+    for (auto& file : files)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->lengthInSamples > std::numeric_limits<int>::max() / 2)
+            continue;
+
+        lengths.push_back((int)reader->lengthInSamples);
+        names.push_back(file.getFileName());
+        readers.push_back(std::move(reader));
+    }
+
+    SampleArena::Ptr arena = new SampleArena(format);
+    arena->allocate(lengths);
+
+    //16 bit arenas are filled through a small float buffer instead of a full size copy, float ones are
+    //read in place; both a block at a time so a load can be abandoned part way
+    constexpr int blockSize = 65536;
+    juce::AudioBuffer<float> block(1, format == Format::float32 ? 0 : blockSize);
+
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        auto& region = arena->regions[i];
+        region.name = names[i];
+        region.sampleRate = readers[i]->sampleRate;
+
+        // Mono for simplicity, like the single file loader always was
+        float* destination = format == Format::float32 ? reinterpret_cast<float*>(arena->data) + region.offset : nullptr;
+        juce::AudioBuffer<float> view(&destination, 1, format == Format::float32 ? region.length : 0);
+
+        for (int done = 0; done < region.length; done += blockSize)
+        {
+            if (shouldStop != nullptr && shouldStop())
+                return nullptr;
+
+            int n = juce::jmin(blockSize, region.length - done);
+            if (format == Format::float32)
+                readers[i]->read(&view, done, n, done, true, true);
+            else
+            {
+                readers[i]->read(&block, 0, n, done, true, true);
+                arena->writeSamples(block.getReadPointer(0), region.offset + done, n);
+            }
+        }
+    }
+
+    return arena;
+}
+
+SampleArena::Ptr SampleArena::fromBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate,
+                                         const juce::String& name, Format format)
+{
+    SampleArena::Ptr arena = new SampleArena(format);
+    arena->allocate({ buffer.getNumChannels() > 0 ? buffer.getNumSamples() : 0 });
+
+    auto& region = arena->regions[0];
+    region.name = name;
+    region.sampleRate = sampleRate;
+    if (region.length > 0)
+        arena->writeSamples(buffer.getReadPointer(0), region.offset, region.length);
+
+    return arena;
+}
+
+SampleArena::Ptr SampleArena::fromChannels(const juce::AudioBuffer<float>& buffer, const std::vector<int>& lengths,
+                                           Format format, double sampleRate)
+{
+    jassert((int)lengths.size() <= buffer.getNumChannels());
+    SampleArena::Ptr arena = new SampleArena(format);
+    arena->allocate(lengths);
+
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        auto& region = arena->regions[i];
+        region.length = juce::jmin(region.length, buffer.getNumSamples());
+        region.sampleRate = sampleRate;
+        if (region.length > 0)
+            arena->writeSamples(buffer.getReadPointer((int)i), region.offset, region.length);
+    }
+
+    return arena;
+}
+
+SampleArena::Ptr SampleArena::fromMappedFile(std::unique_ptr<juce::MemoryMappedFile> file, size_t dataOffset,
+                                             Format format, int totalSize, std::vector<Region> regions)
+{
+    if (file == nullptr || file->getData() == nullptr || totalSize < 0
+        || dataOffset + (size_t)totalSize * (size_t)getBytesPerSample(format) > file->getSize())
+        return nullptr;
+
+    //regions have to be in order and leave room for the interpolators' guard samples
+    int end = 0;
+    for (auto& region : regions)
+    {
+        if (region.offset < end + guardSamples || region.length < 0
+            || region.offset > totalSize - guardSamples - region.length)
+            return nullptr;
+        end = region.offset + region.length;
+    }
+
+    SampleArena::Ptr arena = new SampleArena(format);
+    arena->data = static_cast<char*>(file->getData()) + dataOffset;
+    arena->mappedFile = std::move(file);
+    arena->totalSize = totalSize;
+    arena->regions = std::move(regions);
+    return arena;
+}
+
+juce::Array<juce::File> SampleArena::findAudioFiles(const juce::File& folder)
+{
+    auto files = folder.findChildFiles(juce::File::findFiles, false, "*.wav;*.aif;*.aiff;*.flac;*.ogg");
+    files.sort();
+    return files;
+}
+
+int SampleArena::findRegion(int position) const noexcept
+{
+    auto after = std::upper_bound(regions.begin(), regions.end(), position,
+                                  [](int p, const Region& r) { return p < r.offset; });
+    if (after == regions.begin())
+        return -1;
+
+    auto region = std::prev(after);
+    return position < region->offset + region->length ? (int)std::distance(regions.begin(), region) : -1;
+}
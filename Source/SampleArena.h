@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    SampleArena.h
+    Created: 20 Oct 2026 1:15:42pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Any number of mono source files packed into one contiguous, aligned block
+// with an offset/length table. Voices and grains pick a file by index, so
+// switching material never reloads anything. Immutable once built.
+class SampleArena : public juce::ReferenceCountedObject
+{
+public:
+
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleArena>;
+
+    // How the samples are held in memory. The 16 bit formats halve the footprint
+    // and the memory traffic of dense clouds; the grain kernels widen them on the fly.
+    enum class Format
+    {
+        float32 = 0,
+        int16,
+        half
+    };
+
+    struct Region
+    {
+        juce::String name;
+        int offset = 0; // first sample of the file inside the arena
+        int length = 0;
+        double sampleRate = 0.0;
+    };
+
+    // Zeros around every file, so interpolators reading a few samples past either end stay inside the arena
+    static constexpr int guardSamples = 16;
+
+    // Reads the first channel of every file that can be decoded; unreadable files are skipped.
+    // shouldStop is asked between blocks of 65536 samples, returning true gives up and returns null
+    static Ptr loadFiles(const juce::Array<juce::File>& files, Format format = Format::float32,
+                         const std::function<bool()>& shouldStop = nullptr);
+    static Ptr fromBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate = 44100.0,
+                          const juce::String& name = {}, Format format = Format::float32);
+    // One region per channel, the first lengths[channel] samples of it
+    static Ptr fromChannels(const juce::AudioBuffer<float>& buffer, const std::vector<int>& lengths,
+                            Format format = Format::float32, double sampleRate = 44100.0);
+
+    // Wraps samples already laid out like an arena, e.g. inside a mapped cache file.
+    // The arena keeps the mapping open; returns nullptr if the layout doesn't fit the file.
+    static Ptr fromMappedFile(std::unique_ptr<juce::MemoryMappedFile> file, size_t dataOffset,
+                              Format format, int totalSize, std::vector<Region> regions);
+
+    static int getBytesPerSample(Format format) noexcept;
+
+    // Decodable audio files directly inside a folder, in name order
+    static juce::Array<juce::File> findAudioFiles(const juce::File& folder);
+
+    int getNumRegions() const noexcept { return (int)regions.size(); }
+    const Region& getRegion(int index) const noexcept { return regions[(size_t)index]; }
+    const void* getRegionData(int index) const noexcept { return data + (size_t)regions[(size_t)index].offset * bytesPerSample; }
+
+    // Region containing an arena position, or -1 if it falls in a guard gap
+    int findRegion(int position) const noexcept;
+
+    Format getFormat() const noexcept { return format; }
+    int getTotalSize() const noexcept { return totalSize; }
+
+    // The whole arena as floats, or nullptr if it is stored in a 16 bit format
+    const float* getFloatData() const noexcept { return format == Format::float32 ? reinterpret_cast<const float*>(data) : nullptr; }
+
+    // Widens any stretch of the arena to floats, whatever the format
+    void readSamples(float* dest, int startSample, int numSamples) const noexcept;
+
+    // The raw samples, guard gaps included, as they would be written to disk
+    const void* getStorage() const noexcept { return data; }
+    size_t getStorageSize() const noexcept { return (size_t)totalSize * (size_t)bytesPerSample; }
+
+private:
+
+    SampleArena(Format storageFormat);
+    void allocate(const std::vector<int>& lengths);
+    void writeSamples(const float* source, int startSample, int numSamples) noexcept;
+
+    Format format;
+    int bytesPerSample;
+    juce::HeapBlock<char> storage;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile; // used instead of storage when loaded from a cache
+    char* data = nullptr; // storage rounded up to a 64 byte boundary, or the mapped samples
+    int totalSize = 0;
+    std::vector<Region> regions;
+};
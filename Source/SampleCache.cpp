@@ -0,0 +1,186 @@
+/*
+  ==============================================================================
+
+    SampleCache.cpp
+    Created: 20 Oct 2026 4:37:05pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "SampleCache.h"
+
+namespace SampleCache
+{
+
+// Layout: a fixed header, the arena samples starting on a 64 byte boundary,
+// then the region table, the sample index, the corpus and the peak pyramid.
+static constexpr int magic = 0x435a5347; // "GSZC"
+static constexpr int headerSize = 64;
+
+static juce::uint64 hashBytes(const void* data, size_t numBytes, juce::uint64 hash) noexcept
+{
+    constexpr juce::uint64 prime1 = 0x9e3779b185ebca87ull, prime2 = 0xc2b2ae3d27d4eb4full;
+    auto mix = [](juce::uint64 h, juce::uint64 word)
+    {
+        h ^= word * prime2;
+        h = (h << 31) | (h >> 33);
+        return h * prime1;
+    };
+
+    auto bytes = static_cast<const juce::uint8*>(data);
+    size_t i = 0;
+    for (; i + 8 <= numBytes; i += 8)
+    {
+        juce::uint64 word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = mix(hash, word);
+    }
+
+    juce::uint64 tail = numBytes;
+    for (; i < numBytes; i++)
+        tail = (tail << 8) | bytes[i];
+    return mix(hash, tail);
+}
+
+juce::uint64 computeKey(const juce::Array<juce::File>& files, SampleArena::Format format)
+{
+    juce::uint64 hash = ((juce::uint64)version << 32) | (juce::uint64)format;
+
+    for (auto& file : files)
+    {
+        //the path, size and modification time stand in for the contents, nothing is read
+        auto path = file.getFullPathName().toStdString();
+        juce::int64 stats[] = { file.getSize(), file.getLastModificationTime().toMilliseconds() };
+        hash = hashBytes(path.data(), path.size(), hash);
+        hash = hashBytes(stats, sizeof(stats), hash);
+    }
+
+    return hash;
+}
+
+juce::File getCacheFile(juce::uint64 key)
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("GranSynthZi")
+               .getChildFile("Cache")
+               .getChildFile(juce::String::toHexString((juce::int64)key) + ".gscache");
+}
+
+bool load(juce::uint64 key, Entry& entry)
+{
+    auto file = getCacheFile(key);
+    if (! file.existsAsFile())
+        return false;
+
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    if (mapped->getData() == nullptr || mapped->getSize() < (size_t)headerSize)
+        return false;
+
+    juce::MemoryInputStream header(mapped->getData(), (size_t)headerSize, false);
+    if (header.readInt() != magic || header.readInt() != version || (juce::uint64)header.readInt64() != key)
+        return false;
+
+    int format = header.readInt();
+    int totalSize = header.readInt();
+    auto metadataOffset = (size_t)header.readInt64();
+    if (! juce::isPositiveAndNotGreaterThan(format, (int)SampleArena::Format::half) || totalSize < 0
+        || metadataOffset != (size_t)headerSize + (size_t)totalSize * (size_t)SampleArena::getBytesPerSample((SampleArena::Format)format)
+        || metadataOffset > mapped->getSize())
+        return false;
+
+    juce::MemoryInputStream metadata(static_cast<const char*>(mapped->getData()) + metadataOffset,
+                                     mapped->getSize() - metadataOffset, false);
+
+    int numRegions = metadata.readInt();
+    if (numRegions <= 0 || numRegions > metadata.getNumBytesRemaining())
+        return false;
+
+    std::vector<SampleArena::Region> regions((size_t)numRegions);
+    for (auto& region : regions)
+    {
+        region.name = metadata.readString();
+        region.offset = metadata.readInt();
+        region.length = metadata.readInt();
+        region.sampleRate = metadata.readDouble();
+    }
+
+    //a region, crossing or frame outside the arena means a damaged file, decode it again instead
+    for (auto& region : regions)
+        if (region.offset < 0 || region.length < 0 || region.offset > totalSize - region.length)
+            return false;
+
+    auto sampleIndex = SampleIndex::readFrom(metadata, totalSize);
+    auto corpus = GrainCorpus::readFrom(metadata, totalSize);
+    if (sampleIndex == nullptr || corpus == nullptr)
+        return false;
+
+    auto arena = SampleArena::fromMappedFile(std::move(mapped), (size_t)headerSize, (SampleArena::Format)format,
+                                             totalSize, std::move(regions));
+    if (arena == nullptr)
+        return false;
+
+    //the metadata stream still reads the mapping, which the arena now owns
+    auto peaks = PeakPyramid::readFrom(metadata, arena);
+    if (peaks == nullptr)
+        return false;
+
+    entry = { arena, sampleIndex, corpus, peaks };
+    return true;
+}
+
+bool save(juce::uint64 key, const Entry& entry)
+{
+    if (entry.arena == nullptr || entry.sampleIndex == nullptr || entry.corpus == nullptr || entry.peaks == nullptr)
+        return false;
+
+    auto file = getCacheFile(key);
+    if (! file.getParentDirectory().createDirectory())
+        return false;
+
+    auto tempFile = file.withFileExtension("tmp");
+    {
+        juce::FileOutputStream stream(tempFile);
+        if (! stream.openedOk())
+            return false;
+
+        stream.setPosition(0);
+        stream.truncate();
+
+        const auto& arena = *entry.arena;
+        stream.writeInt(magic);
+        stream.writeInt(version);
+        stream.writeInt64((juce::int64)key);
+        stream.writeInt((int)arena.getFormat());
+        stream.writeInt(arena.getTotalSize());
+        stream.writeInt64((juce::int64)(headerSize + arena.getStorageSize()));
+        stream.writeRepeatedByte(0, (size_t)headerSize - (size_t)stream.getPosition());
+
+        stream.write(arena.getStorage(), arena.getStorageSize());
+
+        stream.writeInt(arena.getNumRegions());
+        for (int i = 0; i < arena.getNumRegions(); i++)
+        {
+            const auto& region = arena.getRegion(i);
+            stream.writeString(region.name);
+            stream.writeInt(region.offset);
+            stream.writeInt(region.length);
+            stream.writeDouble(region.sampleRate);
+        }
+
+        entry.sampleIndex->writeTo(stream);
+        entry.corpus->writeTo(stream);
+        entry.peaks->writeTo(stream);
+
+        stream.flush();
+        if (stream.getStatus().failed())
+        {
+            tempFile.deleteFile();
+            return false;
+        }
+    }
+
+    return tempFile.moveFileTo(file);
+}
+
+}
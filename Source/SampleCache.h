@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    SampleCache.h
+    Created: 20 Oct 2026 4:37:05pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+#include "SampleIndex.h"
+#include "GrainCorpus.h"
+#include "PeakPyramid.h"
+
+
+// Decoded sources and their analysis saved to disk after the first load, keyed
+// by a hash of each file's path, size and modification time. A repeat load maps the cache file straight
+// into memory instead of decoding, analysing and measuring everything again.
+namespace SampleCache
+{
+    struct Entry
+    {
+        SampleArena::Ptr arena;
+        SampleIndex::Ptr sampleIndex;
+        GrainCorpus::Ptr corpus;
+        PeakPyramid::Ptr peaks;
+    };
+
+    // Bump whenever the file layout or the analysis changes, old caches are then ignored
+    static constexpr int version = 3;
+
+    // Hash of every file's path, size and modification time, their order and the storage format.
+    // Only the directory is read, so the key costs nothing however large the files are
+    juce::uint64 computeKey(const juce::Array<juce::File>& files, SampleArena::Format format);
+
+    // Fills the entry from the cache file for this key, false if there is no valid one
+    bool load(juce::uint64 key, Entry& entry);
+
+    // Writes through a temporary file, so a half written cache is never picked up
+    bool save(juce::uint64 key, const Entry& entry);
+
+    juce::File getCacheFile(juce::uint64 key);
+}
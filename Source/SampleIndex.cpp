@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    SampleIndex.cpp
+    Created: 19 Oct 2026 7:26:51pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "SampleIndex.h"
+
+SampleIndex::Ptr SampleIndex::build(const juce::AudioBuffer<float>& buffer)
+{
+    if (buffer.getNumChannels() == 0)
+        return new SampleIndex();
+
+    return build(buffer.getReadPointer(0), buffer.getNumSamples());
+}
+
+SampleIndex::Ptr SampleIndex::build(const float* data, int numSamples)
+{
+    SampleIndex::Ptr index = new SampleIndex();
+    index->analyse([data](int position, int count, float* dest) { std::copy(data + position, data + position + count, dest); },
+                   0, numSamples);
+    return index;
+}
+
+SampleIndex::Ptr SampleIndex::build(const SampleArena& arena)
+{
+    SampleIndex::Ptr index = new SampleIndex();
+    auto read = [&arena](int position, int count, float* dest) { arena.readSamples(dest, position, count); };
+    for (int r = 0; r < arena.getNumRegions(); r++)
+        index->analyse(read, arena.getRegion(r).offset, arena.getRegion(r).length);
+    return index;
+}
+
+void SampleIndex::analyse(const Reader& read, int start, int numSamples)
+{
+    if (numSamples > 1)
+    {
+        findZeroCrossings(read, start, numSamples);
+        findOnsets(read, start, numSamples);
+    }
+}
+
+int SampleIndex::snap(SnapMode mode, int sample) const noexcept
+{
+    switch (mode)
+    {
+        case SnapMode::zeroCrossing: return findNearest(zeroCrossings, sample);
+        case SnapMode::onset:        return findNearest(onsets, sample);
+        case SnapMode::off:          break;
+    }
+    return sample;
+}
+
+int SampleIndex::findNearest(const std::vector<int>& positions, int sample) noexcept
+{
+    if (positions.empty())
+        return sample;
+
+    auto after = std::lower_bound(positions.begin(), positions.end(), sample);
+
+    if (after == positions.begin())
+        return *after;
+    if (after == positions.end())
+        return positions.back();
+
+    auto before = std::prev(after);
+    return (sample - *before) <= (*after - sample) ? *before : *after;
+}
+
+void SampleIndex::findZeroCrossings(const Reader& read, int start, int numSamples)
+{
+    //rising crossings only, so every snapped grain starts on the same phase; read a chunk at a time
+    std::vector<float> chunk((size_t)juce::jmin(numSamples, chunkSize));
+    float previous = 0.0f;
+    for (int done = 0; done < numSamples; done += chunkSize)
+    {
+        int count = juce::jmin(chunkSize, numSamples - done);
+        read(start + done, count, chunk.data());
+        for (int i = 0; i < count; i++)
+        {
+            if (done + i > 0 && previous < 0.0f && chunk[(size_t)i] >= 0.0f)
+                zeroCrossings.push_back(start + done + i);
+            previous = chunk[(size_t)i];
+        }
+    }
+}
+
+void SampleIndex::findOnsets(const Reader& read, int start, int numSamples)
+{
+    //rises in frame log-energy, peak picked against a local average
+    const int frameSize = 1024;
+    const int hopSize = 512;
+    const int averageFrames = 8;
+    const float silence = 1.0e-6f;         //-60 dB
+    const float minimumRise = 1.0f;        //natural log, roughly 4.3 dB
+    const int minimumGapFrames = 4;
+
+    int numFrames = numSamples < frameSize ? 0 : (numSamples - frameSize) / hopSize + 1;
+    if (numFrames < 3)
+        return;
+
+    std::vector<float> frame((size_t)frameSize);
+    std::vector<float> energy((size_t)numFrames);
+    for (int f = 0; f < numFrames; f++)
+    {
+        read(start + f * hopSize, frameSize, frame.data());
+        float sum = 0.0f;
+        for (int i = 0; i < frameSize; i++)
+            sum += frame[i] * frame[i];
+        energy[(size_t)f] = sum / frameSize;
+    }
+
+    std::vector<float> rise((size_t)numFrames, 0.0f);
+    for (int f = 1; f < numFrames; f++)
+        rise[(size_t)f] = juce::jmax(0.0f, std::log(energy[(size_t)f] + silence) - std::log(energy[(size_t)f - 1] + silence));
+
+    int lastOnsetFrame = -minimumGapFrames;
+    for (int f = 1; f < numFrames - 1; f++)
+    {
+        float average = 0.0f;
+        int count = 0;
+        for (int k = juce::jmax(0, f - averageFrames); k <= juce::jmin(numFrames - 1, f + averageFrames); k++, count++)
+            average += rise[(size_t)k];
+        average /= count;
+
+        bool isPeak = rise[(size_t)f] >= rise[(size_t)f - 1] && rise[(size_t)f] > rise[(size_t)f + 1];
+        if (! isPeak || energy[(size_t)f] < silence || rise[(size_t)f] < juce::jmax(minimumRise, 1.5f * average)
+            || f - lastOnsetFrame < minimumGapFrames)
+            continue;
+
+        //the attack is where the frame first gets within 20 dB of its peak
+        read(start + f * hopSize, frameSize, frame.data());
+        float peak = 0.0f;
+        for (int i = 0; i < frameSize; i++)
+            peak = juce::jmax(peak, std::abs(frame[(size_t)i]));
+
+        int attack = 0;
+        while (std::abs(frame[(size_t)attack]) < 0.1f * peak)
+            attack++;
+        int position = start + f * hopSize + attack;
+
+        //start on the last rising zero crossing before the attack, if it is close by
+        auto crossing = std::upper_bound(zeroCrossings.begin(), zeroCrossings.end(), position);
+        if (crossing != zeroCrossings.begin() && *std::prev(crossing) >= start && position - *std::prev(crossing) < hopSize)
+            position = *std::prev(crossing);
+
+        onsets.push_back(position);
+        lastOnsetFrame = f;
+    }
+}
+
+void SampleIndex::writeTo(juce::OutputStream& stream) const
+{
+    for (auto* positions : { &zeroCrossings, &onsets })
+    {
+        stream.writeInt((int)positions->size());
+        stream.write(positions->data(), positions->size() * sizeof(int));
+    }
+}
+
+SampleIndex::Ptr SampleIndex::readFrom(juce::InputStream& stream, int totalSize)
+{
+    SampleIndex::Ptr index = new SampleIndex();
+
+    for (auto* positions : { &index->zeroCrossings, &index->onsets })
+    {
+        int size = stream.readInt();
+        if (size < 0 || (juce::int64)size * (juce::int64)sizeof(int) > stream.getNumBytesRemaining())
+            return nullptr;
+
+        positions->resize((size_t)size);
+        stream.read(positions->data(), size * (int)sizeof(int));
+
+        //snapping binary searches them, so they have to be sorted too
+        for (size_t i = 0; i < positions->size(); i++)
+            if (! juce::isPositiveAndBelow((*positions)[i], totalSize) || (i > 0 && (*positions)[i] < (*positions)[i - 1]))
+                return nullptr;
+    }
+
+    return index;
+}
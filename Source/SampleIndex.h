@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    SampleIndex.h
+    Created: 19 Oct 2026 7:26:51pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+
+
+// Sorted positions of the rising zero crossings and onsets of a loaded file,
+// built once off the audio thread so grain starts can be snapped to them
+// with a binary search when the grain is spawned.
+class SampleIndex : public juce::ReferenceCountedObject
+{
+public:
+
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleIndex>;
+
+    enum class SnapMode
+    {
+        off = 0,
+        zeroCrossing,
+        onset
+    };
+
+    // Analyses the first channel of the buffer, can take a while on long files
+    static Ptr build(const juce::AudioBuffer<float>& buffer);
+    static Ptr build(const float* data, int numSamples);
+    // Every file of the arena on its own, leaving out the guard gaps between them; reads it
+    // a frame at a time, whatever its format, without a float copy of it
+    static Ptr build(const SampleArena& arena);
+
+    // Nearest entry to the given sample, or the sample itself if the index is empty
+    int snap(SnapMode mode, int sample) const noexcept;
+
+    const std::vector<int>& getZeroCrossings() const noexcept { return zeroCrossings; }
+    const std::vector<int>& getOnsets() const noexcept { return onsets; }
+
+    // Native byte order, for the on-disk cache only; readFrom returns nullptr if the data is cut short
+    // or a position is out of order or outside an arena of totalSize samples
+    void writeTo(juce::OutputStream& stream) const;
+    static Ptr readFrom(juce::InputStream& stream, int totalSize);
+
+private:
+
+    // Widens count samples from position on into dest
+    using Reader = std::function<void(int position, int count, float* dest)>;
+
+    static constexpr int chunkSize = 1 << 16;
+
+    static int findNearest(const std::vector<int>& positions, int sample) noexcept;
+    void analyse(const Reader& read, int start, int numSamples);
+    void findZeroCrossings(const Reader& read, int start, int numSamples);
+    void findOnsets(const Reader& read, int start, int numSamples);
+
+    std::vector<int> zeroCrossings;
+    std::vector<int> onsets;
+};
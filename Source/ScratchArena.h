@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    ScratchArena.h
+    Created: 25 Oct 2026 9:14:27am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Temporary working memory for the audio thread. One block is allocated in
+// prepare; allocate hands out 64 byte aligned spans of it by bumping an
+// offset, and reset at the start of each audio block gives all of it back.
+// Spans are not cleared and nothing is ever freed on its own, so only plain
+// values belong in them.
+class ScratchArena
+{
+public:
+
+    static constexpr size_t alignment = 64;
+
+    ScratchArena() = default;
+
+    // What a span of count values takes out of the arena
+    template <typename T>
+    static constexpr size_t bytesFor(int count) noexcept
+    {
+        return ((size_t)juce::jmax(0, count) * sizeof(T) + alignment - 1) / alignment * alignment;
+    }
+
+    // Allocates room for capacityInBytes of spans, dropping any handed out
+    void prepare(size_t capacityInBytes)
+    {
+        capacity = capacityInBytes;
+        storage.allocate(capacity + alignment, false);
+        auto address = reinterpret_cast<juce::pointer_sized_uint>(storage.get());
+        base = storage.get() + (alignment - address % alignment) % alignment;
+        used = 0;
+        highWaterMark = 0;
+    }
+
+    // A span of count values, or null once the arena is used up
+    template <typename T>
+    T* allocate(int count) noexcept
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "nothing in the arena is ever destroyed");
+        size_t bytes = bytesFor<T>(count);
+        if (used + bytes > capacity)
+        {
+            jassertfalse; //prepare asked for too little
+            return nullptr;
+        }
+
+        auto* span = reinterpret_cast<T*>(base + used);
+        used += bytes;
+        highWaterMark = juce::jmax(highWaterMark, used);
+        return span;
+    }
+
+    // Gives every span back, at the start of each audio block
+    void reset() noexcept { used = 0; }
+
+    size_t getCapacity() const noexcept { return capacity; }
+    size_t getUsed() const noexcept { return used; }
+    // The most ever in use at once since prepare
+    size_t getHighWaterMark() const noexcept { return highWaterMark; }
+
+    // Gives back the spans allocated during its lifetime, for memory only needed inside one call
+    class Scope
+    {
+    public:
+        explicit Scope(ScratchArena& arenaToRewind) noexcept : arena(arenaToRewind), mark(arenaToRewind.used) {}
+        ~Scope() noexcept { arena.used = mark; }
+
+    private:
+        ScratchArena& arena;
+        size_t mark;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+private:
+
+    juce::HeapBlock<char> storage;
+    char* base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t highWaterMark = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ScratchArena)
+};
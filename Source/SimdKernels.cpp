@@ -0,0 +1,646 @@
+/*
+  ==============================================================================
+
+    SimdKernels.cpp
+    Created: 19 Oct 2026 5:03:48pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "SimdKernels.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+ #if JUCE_MSVC
+  #include <intrin.h>
+  #define SIMD_TARGET(isa)
+ #else
+  #include <cpuid.h>
+  #define SIMD_TARGET(isa) __attribute__((target(isa)))
+ #endif
+#endif
+
+namespace SimdKernels
+{
+
+//==============================================================================
+// portable versions, also used for the tails of the vector loops
+
+static void multiplyAddScalar(float* dest, const float* source, const float* envelope, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+        dest[i] += source[i] * envelope[i];
+}
+
+static void interpolateLinearScalar(float* dest, const float* source, double position, double increment, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        double p = position + i * increment;
+        int index = (int)p;
+        float fraction = (float)(p - index);
+        dest[i] = source[index] + fraction * (source[index + 1] - source[index]);
+    }
+}
+
+static void addClippedScalar(float* dest, const float* source, float ceiling, float gain, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+        dest[i] += juce::jmin(source[i], ceiling) * gain;
+}
+
+static constexpr float int16Scale = 1.0f / 32767.0f;
+
+static void decodeInt16Scalar(float* dest, const juce::int16* source, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+        dest[i] = source[i] * int16Scale;
+}
+
+static void decodeHalfScalar(float* dest, const juce::uint16* source, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        juce::uint32 sign = (juce::uint32)(source[i] & 0x8000) << 16;
+        juce::uint32 exponent = (source[i] >> 10) & 0x1f;
+        juce::uint32 mantissa = source[i] & 0x3ff;
+        juce::uint32 bits;
+
+        if (exponent == 0)
+        {
+            //zero or denormal, both exact as a scaled float
+            float magnitude = mantissa * (1.0f / 16777216.0f);
+            std::memcpy(&bits, &magnitude, sizeof(bits));
+            bits |= sign;
+        }
+        else if (exponent == 31)
+        {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else
+        {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        std::memcpy(dest + i, &bits, sizeof(bits));
+    }
+}
+
+//cos(pi * u) for u in -0.5..0.5 as a polynomial in u squared, its square is the hann window at phase u
+static constexpr float cosPi[] = { -4.934802200544679f, 4.058712126416768f, -1.3352627688545893f,
+                                   0.23533063035889312f, -0.02580689139001405f };
+
+static inline float hannScalar(float phase)
+{
+    float x = phase * phase;
+    float c = 1.0f + x * (cosPi[0] + x * (cosPi[1] + x * (cosPi[2] + x * (cosPi[3] + x * cosPi[4]))));
+    return c * c;
+}
+
+static void renderLanesScalar(const float* source, GrainLanes& lanes, int numGrains, bool hann,
+                              float* left, float* right, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        float sumLeft = 0.0f, sumRight = 0.0f;
+
+        for (int g = 0; g < numGrains; g++)
+        {
+            if (lanes.delay[g] > 0)
+            {
+                lanes.delay[g]--;
+                continue;
+            }
+            if (lanes.remaining[g] <= 0)
+                continue;
+
+            const float* s = source + lanes.index[g];
+            float envelope = hann ? hannScalar(lanes.attack[g]) : juce::jmin(1.0f, lanes.attack[g], lanes.release[g]);
+            float value = (s[0] + lanes.fraction[g] * (s[1] - s[0])) * envelope;
+            sumLeft += value * lanes.gainLeft[g];
+            sumRight += value * lanes.gainRight[g];
+
+            lanes.fraction[g] += lanes.stepFraction[g];
+            int carry = lanes.fraction[g] >= 1.0f ? 1 : 0;
+            lanes.fraction[g] -= (float)carry;
+            lanes.index[g] += lanes.step[g] + carry;
+            lanes.attack[g] += lanes.attackSlope[g];
+            lanes.release[g] += lanes.releaseSlope[g];
+            lanes.remaining[g]--;
+        }
+
+        left[i] += sumLeft;
+        if (right != nullptr)
+            right[i] += sumRight;
+    }
+}
+
+static const KernelSet scalarKernels { "Scalar", multiplyAddScalar, interpolateLinearScalar, addClippedScalar,
+                                       decodeInt16Scalar, decodeHalfScalar, renderLanesScalar };
+
+#if JUCE_INTEL
+
+//==============================================================================
+SIMD_TARGET("sse4.1")
+static void multiplyAddSse(float* dest, const float* source, const float* envelope, int numSamples)
+{
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(source + i), _mm_loadu_ps(envelope + i));
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), product));
+    }
+    multiplyAddScalar(dest + i, source + i, envelope + i, numSamples - i);
+}
+
+SIMD_TARGET("sse4.1")
+static void interpolateLinearSse(float* dest, const float* source, double position, double increment, int numSamples)
+{
+    const __m128d steps0 = _mm_set_pd(1.0, 0.0), steps1 = _mm_set_pd(3.0, 2.0);
+    const __m128d inc = _mm_set1_pd(increment);
+    alignas(16) int indices[4];
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128d base = _mm_set1_pd(position + i * increment);
+        __m128d p0 = _mm_add_pd(base, _mm_mul_pd(steps0, inc));
+        __m128d p1 = _mm_add_pd(base, _mm_mul_pd(steps1, inc));
+        __m128d f0 = _mm_floor_pd(p0), f1 = _mm_floor_pd(p1);
+
+        //no gather before AVX2, so the indices go through memory
+        _mm_store_si128((__m128i*)indices, _mm_unpacklo_epi64(_mm_cvttpd_epi32(f0), _mm_cvttpd_epi32(f1)));
+        __m128 s0 = _mm_set_ps(source[indices[3]], source[indices[2]], source[indices[1]], source[indices[0]]);
+        __m128 s1 = _mm_set_ps(source[indices[3] + 1], source[indices[2] + 1], source[indices[1] + 1], source[indices[0] + 1]);
+        __m128 fraction = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(p0, f0)), _mm_cvtpd_ps(_mm_sub_pd(p1, f1)));
+
+        _mm_storeu_ps(dest + i, _mm_add_ps(s0, _mm_mul_ps(fraction, _mm_sub_ps(s1, s0))));
+    }
+    interpolateLinearScalar(dest + i, source, position + i * increment, increment, numSamples - i);
+}
+
+SIMD_TARGET("sse4.1")
+static void addClippedSse(float* dest, const float* source, float ceiling, float gain, int numSamples)
+{
+    const __m128 c = _mm_set1_ps(ceiling), g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 clipped = _mm_mul_ps(_mm_min_ps(_mm_loadu_ps(source + i), c), g);
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), clipped));
+    }
+    addClippedScalar(dest + i, source + i, ceiling, gain, numSamples - i);
+}
+
+SIMD_TARGET("sse4.1")
+static void decodeInt16Sse(float* dest, const juce::int16* source, int numSamples)
+{
+    const __m128 scale = _mm_set1_ps(int16Scale);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128i widened = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(source + i)));
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(widened), scale));
+    }
+    decodeInt16Scalar(dest + i, source + i, numSamples - i);
+}
+
+SIMD_TARGET("sse4.1")
+static inline __m128 hannSse(__m128 phase)
+{
+    __m128 x = _mm_mul_ps(phase, phase);
+    __m128 c = _mm_set1_ps(cosPi[4]);
+    for (int k = 3; k >= 0; k--)
+        c = _mm_add_ps(_mm_mul_ps(c, x), _mm_set1_ps(cosPi[k]));
+    c = _mm_add_ps(_mm_mul_ps(c, x), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(c, c);
+}
+
+SIMD_TARGET("sse4.1")
+static inline float horizontalSumSse(__m128 v)
+{
+    __m128 pairs = _mm_add_ps(v, _mm_movehdup_ps(v));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_movehl_ps(pairs, pairs)));
+}
+
+SIMD_TARGET("sse4.1")
+static void renderLanesSse(const float* source, GrainLanes& lanes, int numGrains, bool hann,
+                           float* left, float* right, int numSamples)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i zero = _mm_setzero_si128();
+    int paddedGrains = (numGrains + 3) & ~3;
+    alignas(16) int indices[4], live[4];
+    alignas(16) float s0[4], s1[4];
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        __m128 sumLeft = _mm_setzero_ps(), sumRight = _mm_setzero_ps();
+
+        for (int g = 0; g < paddedGrains; g += 4)
+        {
+            __m128i delay = _mm_load_si128((const __m128i*)(lanes.delay + g));
+            __m128i waiting = _mm_cmpgt_epi32(delay, zero);
+            __m128i liveMask = _mm_andnot_si128(waiting, _mm_cmpgt_epi32(_mm_load_si128((const __m128i*)(lanes.remaining + g)), zero));
+            _mm_store_si128((__m128i*)(lanes.delay + g), _mm_add_epi32(delay, waiting));
+            __m128 liveLanes = _mm_castsi128_ps(liveMask);
+            if (_mm_movemask_ps(liveLanes) == 0)
+                continue;
+
+            //no gather before AVX2, so the samples go through memory; silent lanes are not read at all
+            __m128i index = _mm_load_si128((const __m128i*)(lanes.index + g));
+            _mm_store_si128((__m128i*)indices, index);
+            _mm_store_si128((__m128i*)live, liveMask);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                s0[lane] = live[lane] != 0 ? source[indices[lane]] : 0.0f;
+                s1[lane] = live[lane] != 0 ? source[indices[lane] + 1] : 0.0f;
+            }
+
+            __m128 fraction = _mm_load_ps(lanes.fraction + g);
+            __m128 attack = _mm_load_ps(lanes.attack + g);
+            __m128 release = _mm_load_ps(lanes.release + g);
+            __m128 envelope = hann ? hannSse(attack) : _mm_min_ps(one, _mm_min_ps(attack, release));
+            __m128 first = _mm_load_ps(s0);
+            __m128 value = _mm_add_ps(first, _mm_mul_ps(fraction, _mm_sub_ps(_mm_load_ps(s1), first)));
+            value = _mm_and_ps(_mm_mul_ps(value, envelope), liveLanes);
+            sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(value, _mm_load_ps(lanes.gainLeft + g)));
+            sumRight = _mm_add_ps(sumRight, _mm_mul_ps(value, _mm_load_ps(lanes.gainRight + g)));
+
+            //only the live lanes move on
+            __m128 nextFraction = _mm_add_ps(fraction, _mm_load_ps(lanes.stepFraction + g));
+            __m128 carry = _mm_cmpge_ps(nextFraction, one);
+            nextFraction = _mm_sub_ps(nextFraction, _mm_and_ps(carry, one));
+            __m128i nextIndex = _mm_sub_epi32(_mm_add_epi32(index, _mm_load_si128((const __m128i*)(lanes.step + g))),
+                                              _mm_castps_si128(carry));
+            _mm_store_ps(lanes.fraction + g, _mm_blendv_ps(fraction, nextFraction, liveLanes));
+            _mm_store_si128((__m128i*)(lanes.index + g), _mm_blendv_epi8(index, nextIndex, liveMask));
+            _mm_store_ps(lanes.attack + g, _mm_add_ps(attack, _mm_and_ps(_mm_load_ps(lanes.attackSlope + g), liveLanes)));
+            _mm_store_ps(lanes.release + g, _mm_add_ps(release, _mm_and_ps(_mm_load_ps(lanes.releaseSlope + g), liveLanes)));
+            __m128i remaining = _mm_load_si128((const __m128i*)(lanes.remaining + g));
+            _mm_store_si128((__m128i*)(lanes.remaining + g), _mm_add_epi32(remaining, liveMask));
+        }
+
+        left[i] += horizontalSumSse(sumLeft);
+        if (right != nullptr)
+            right[i] += horizontalSumSse(sumRight);
+    }
+}
+
+//half floats need F16C, which only arrived alongside AVX, so SSE4.1 keeps the portable version
+static const KernelSet sseKernels { "SSE4.1", multiplyAddSse, interpolateLinearSse, addClippedSse,
+                                    decodeInt16Sse, decodeHalfScalar, renderLanesSse };
+
+//==============================================================================
+SIMD_TARGET("avx2,fma")
+static void multiplyAddAvx2(float* dest, const float* source, const float* envelope, int numSamples)
+{
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_fmadd_ps(_mm256_loadu_ps(source + i), _mm256_loadu_ps(envelope + i),
+                                                   _mm256_loadu_ps(dest + i)));
+    multiplyAddScalar(dest + i, source + i, envelope + i, numSamples - i);
+}
+
+SIMD_TARGET("avx2,fma")
+static void interpolateLinearAvx2(float* dest, const float* source, double position, double increment, int numSamples)
+{
+    const __m256d steps0 = _mm256_set_pd(3.0, 2.0, 1.0, 0.0), steps1 = _mm256_set_pd(7.0, 6.0, 5.0, 4.0);
+    const __m256d inc = _mm256_set1_pd(increment);
+    int i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256d base = _mm256_set1_pd(position + i * increment);
+        __m256d p0 = _mm256_fmadd_pd(steps0, inc, base);
+        __m256d p1 = _mm256_fmadd_pd(steps1, inc, base);
+        __m256d f0 = _mm256_floor_pd(p0), f1 = _mm256_floor_pd(p1);
+
+        __m256i index = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(f0)),
+                                                _mm256_cvttpd_epi32(f1), 1);
+        __m256 fraction = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_sub_pd(p0, f0))),
+                                               _mm256_cvtpd_ps(_mm256_sub_pd(p1, f1)), 1);
+        __m256 s0 = _mm256_i32gather_ps(source, index, 4);
+        __m256 s1 = _mm256_i32gather_ps(source + 1, index, 4);
+
+        _mm256_storeu_ps(dest + i, _mm256_fmadd_ps(fraction, _mm256_sub_ps(s1, s0), s0));
+    }
+    interpolateLinearScalar(dest + i, source, position + i * increment, increment, numSamples - i);
+}
+
+SIMD_TARGET("avx2,fma")
+static void addClippedAvx2(float* dest, const float* source, float ceiling, float gain, int numSamples)
+{
+    const __m256 c = _mm256_set1_ps(ceiling), g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_fmadd_ps(_mm256_min_ps(_mm256_loadu_ps(source + i), c), g,
+                                                   _mm256_loadu_ps(dest + i)));
+    addClippedScalar(dest + i, source + i, ceiling, gain, numSamples - i);
+}
+
+SIMD_TARGET("avx2,fma")
+static void decodeInt16Avx2(float* dest, const juce::int16* source, int numSamples)
+{
+    const __m256 scale = _mm256_set1_ps(int16Scale);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256i widened = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(source + i)));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(widened), scale));
+    }
+    decodeInt16Scalar(dest + i, source + i, numSamples - i);
+}
+
+//only chosen when the CPU reports F16C as well
+SIMD_TARGET("avx2,fma,f16c")
+static void decodeHalfAvx2(float* dest, const juce::uint16* source, int numSamples)
+{
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(source + i))));
+    decodeHalfScalar(dest + i, source + i, numSamples - i);
+}
+
+SIMD_TARGET("avx2,fma")
+static inline __m256 hannAvx2(__m256 phase)
+{
+    __m256 x = _mm256_mul_ps(phase, phase);
+    __m256 c = _mm256_set1_ps(cosPi[4]);
+    for (int k = 3; k >= 0; k--)
+        c = _mm256_fmadd_ps(c, x, _mm256_set1_ps(cosPi[k]));
+    c = _mm256_fmadd_ps(c, x, _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(c, c);
+}
+
+SIMD_TARGET("avx2,fma")
+static inline float horizontalSumAvx2(__m256 v)
+{
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 pairs = _mm_add_ps(half, _mm_movehdup_ps(half));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_movehl_ps(pairs, pairs)));
+}
+
+SIMD_TARGET("avx2,fma")
+static void renderLanesAvx2(const float* source, GrainLanes& lanes, int numGrains, bool hann,
+                            float* left, float* right, int numSamples)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), silence = _mm256_setzero_ps();
+    const __m256i zero = _mm256_setzero_si256();
+    int paddedGrains = (numGrains + 7) & ~7;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        __m256 sumLeft = _mm256_setzero_ps(), sumRight = _mm256_setzero_ps();
+
+        for (int g = 0; g < paddedGrains; g += 8)
+        {
+            __m256i delay = _mm256_load_si256((const __m256i*)(lanes.delay + g));
+            __m256i waiting = _mm256_cmpgt_epi32(delay, zero);
+            __m256i liveMask = _mm256_andnot_si256(waiting, _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i*)(lanes.remaining + g)), zero));
+            _mm256_store_si256((__m256i*)(lanes.delay + g), _mm256_add_epi32(delay, waiting));
+            __m256 liveLanes = _mm256_castsi256_ps(liveMask);
+            if (_mm256_movemask_ps(liveLanes) == 0)
+                continue;
+
+            //masked gathers leave the silent lanes unread
+            __m256i index = _mm256_load_si256((const __m256i*)(lanes.index + g));
+            __m256 first = _mm256_mask_i32gather_ps(silence, source, index, liveLanes, 4);
+            __m256 second = _mm256_mask_i32gather_ps(silence, source + 1, index, liveLanes, 4);
+
+            __m256 fraction = _mm256_load_ps(lanes.fraction + g);
+            __m256 attack = _mm256_load_ps(lanes.attack + g);
+            __m256 release = _mm256_load_ps(lanes.release + g);
+            __m256 envelope = hann ? hannAvx2(attack) : _mm256_min_ps(one, _mm256_min_ps(attack, release));
+            __m256 value = _mm256_fmadd_ps(fraction, _mm256_sub_ps(second, first), first);
+            value = _mm256_and_ps(_mm256_mul_ps(value, envelope), liveLanes);
+            sumLeft = _mm256_fmadd_ps(value, _mm256_load_ps(lanes.gainLeft + g), sumLeft);
+            sumRight = _mm256_fmadd_ps(value, _mm256_load_ps(lanes.gainRight + g), sumRight);
+
+            //only the live lanes move on
+            __m256 nextFraction = _mm256_add_ps(fraction, _mm256_load_ps(lanes.stepFraction + g));
+            __m256 carry = _mm256_cmp_ps(nextFraction, one, _CMP_GE_OQ);
+            nextFraction = _mm256_sub_ps(nextFraction, _mm256_and_ps(carry, one));
+            __m256i nextIndex = _mm256_sub_epi32(_mm256_add_epi32(index, _mm256_load_si256((const __m256i*)(lanes.step + g))),
+                                                 _mm256_castps_si256(carry));
+            _mm256_store_ps(lanes.fraction + g, _mm256_blendv_ps(fraction, nextFraction, liveLanes));
+            _mm256_store_si256((__m256i*)(lanes.index + g), _mm256_blendv_epi8(index, nextIndex, liveMask));
+            _mm256_store_ps(lanes.attack + g, _mm256_add_ps(attack, _mm256_and_ps(_mm256_load_ps(lanes.attackSlope + g), liveLanes)));
+            _mm256_store_ps(lanes.release + g, _mm256_add_ps(release, _mm256_and_ps(_mm256_load_ps(lanes.releaseSlope + g), liveLanes)));
+            __m256i remaining = _mm256_load_si256((const __m256i*)(lanes.remaining + g));
+            _mm256_store_si256((__m256i*)(lanes.remaining + g), _mm256_add_epi32(remaining, liveMask));
+        }
+
+        left[i] += horizontalSumAvx2(sumLeft);
+        if (right != nullptr)
+            right[i] += horizontalSumAvx2(sumRight);
+    }
+}
+
+static const KernelSet avx2Kernels { "AVX2", multiplyAddAvx2, interpolateLinearAvx2, addClippedAvx2,
+                                     decodeInt16Avx2, decodeHalfAvx2, renderLanesAvx2 };
+
+//==============================================================================
+SIMD_TARGET("avx512f")
+static void multiplyAddAvx512(float* dest, const float* source, const float* envelope, int numSamples)
+{
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(dest + i, _mm512_fmadd_ps(_mm512_loadu_ps(source + i), _mm512_loadu_ps(envelope + i),
+                                                   _mm512_loadu_ps(dest + i)));
+    multiplyAddScalar(dest + i, source + i, envelope + i, numSamples - i);
+}
+
+SIMD_TARGET("avx512f")
+static void interpolateLinearAvx512(float* dest, const float* source, double position, double increment, int numSamples)
+{
+    const __m512d steps0 = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+    const __m512d steps1 = _mm512_set_pd(15.0, 14.0, 13.0, 12.0, 11.0, 10.0, 9.0, 8.0);
+    const __m512d inc = _mm512_set1_pd(increment);
+    int i = 0;
+
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512d base = _mm512_set1_pd(position + i * increment);
+        __m512d p0 = _mm512_fmadd_pd(steps0, inc, base);
+        __m512d p1 = _mm512_fmadd_pd(steps1, inc, base);
+        __m512d f0 = _mm512_roundscale_pd(p0, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        __m512d f1 = _mm512_roundscale_pd(p1, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+
+        __m512i index = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvttpd_epi32(f0)),
+                                           _mm512_cvttpd_epi32(f1), 1);
+        __m512d fractionLo = _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(_mm512_sub_pd(p0, f0))));
+        __m512 fraction = _mm512_castpd_ps(_mm512_insertf64x4(fractionLo,
+                                                              _mm256_castps_pd(_mm512_cvtpd_ps(_mm512_sub_pd(p1, f1))), 1));
+        __m512 s0 = _mm512_i32gather_ps(index, source, 4);
+        __m512 s1 = _mm512_i32gather_ps(index, source + 1, 4);
+
+        _mm512_storeu_ps(dest + i, _mm512_fmadd_ps(fraction, _mm512_sub_ps(s1, s0), s0));
+    }
+    interpolateLinearScalar(dest + i, source, position + i * increment, increment, numSamples - i);
+}
+
+SIMD_TARGET("avx512f")
+static void addClippedAvx512(float* dest, const float* source, float ceiling, float gain, int numSamples)
+{
+    const __m512 c = _mm512_set1_ps(ceiling), g = _mm512_set1_ps(gain);
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(dest + i, _mm512_fmadd_ps(_mm512_min_ps(_mm512_loadu_ps(source + i), c), g,
+                                                   _mm512_loadu_ps(dest + i)));
+    addClippedScalar(dest + i, source + i, ceiling, gain, numSamples - i);
+}
+
+SIMD_TARGET("avx512f")
+static void decodeInt16Avx512(float* dest, const juce::int16* source, int numSamples)
+{
+    const __m512 scale = _mm512_set1_ps(int16Scale);
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512i widened = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(source + i)));
+        _mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(widened), scale));
+    }
+    decodeInt16Scalar(dest + i, source + i, numSamples - i);
+}
+
+SIMD_TARGET("avx512f")
+static void decodeHalfAvx512(float* dest, const juce::uint16* source, int numSamples)
+{
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(dest + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(source + i))));
+    decodeHalfScalar(dest + i, source + i, numSamples - i);
+}
+
+SIMD_TARGET("avx512f")
+static inline __m512 hannAvx512(__m512 phase)
+{
+    __m512 x = _mm512_mul_ps(phase, phase);
+    __m512 c = _mm512_set1_ps(cosPi[4]);
+    for (int k = 3; k >= 0; k--)
+        c = _mm512_fmadd_ps(c, x, _mm512_set1_ps(cosPi[k]));
+    c = _mm512_fmadd_ps(c, x, _mm512_set1_ps(1.0f));
+    return _mm512_mul_ps(c, c);
+}
+
+SIMD_TARGET("avx512f")
+static void renderLanesAvx512(const float* source, GrainLanes& lanes, int numGrains, bool hann,
+                              float* left, float* right, int numSamples)
+{
+    const __m512 one = _mm512_set1_ps(1.0f), silence = _mm512_setzero_ps();
+    const __m512i zero = _mm512_setzero_si512(), oneInt = _mm512_set1_epi32(1);
+    int paddedGrains = (numGrains + 15) & ~15;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        __m512 sumLeft = _mm512_setzero_ps(), sumRight = _mm512_setzero_ps();
+
+        for (int g = 0; g < paddedGrains; g += 16)
+        {
+            __m512i delay = _mm512_load_si512(lanes.delay + g);
+            __mmask16 waiting = _mm512_cmpgt_epi32_mask(delay, zero);
+            __mmask16 live = _mm512_mask_cmpgt_epi32_mask((__mmask16)~waiting, _mm512_load_si512(lanes.remaining + g), zero);
+            _mm512_mask_store_epi32(lanes.delay + g, waiting, _mm512_sub_epi32(delay, oneInt));
+            if (live == 0)
+                continue;
+
+            //masked gathers leave the silent lanes unread
+            __m512i index = _mm512_load_si512(lanes.index + g);
+            __m512 first = _mm512_mask_i32gather_ps(silence, live, index, source, 4);
+            __m512 second = _mm512_mask_i32gather_ps(silence, live, index, source + 1, 4);
+
+            __m512 fraction = _mm512_load_ps(lanes.fraction + g);
+            __m512 attack = _mm512_load_ps(lanes.attack + g);
+            __m512 release = _mm512_load_ps(lanes.release + g);
+            __m512 envelope = hann ? hannAvx512(attack) : _mm512_min_ps(one, _mm512_min_ps(attack, release));
+            __m512 value = _mm512_maskz_mul_ps(live, _mm512_fmadd_ps(fraction, _mm512_sub_ps(second, first), first), envelope);
+            sumLeft = _mm512_fmadd_ps(value, _mm512_load_ps(lanes.gainLeft + g), sumLeft);
+            sumRight = _mm512_fmadd_ps(value, _mm512_load_ps(lanes.gainRight + g), sumRight);
+
+            //only the live lanes move on
+            __m512 nextFraction = _mm512_add_ps(fraction, _mm512_load_ps(lanes.stepFraction + g));
+            __mmask16 carry = _mm512_cmp_ps_mask(nextFraction, one, _CMP_GE_OQ);
+            __m512i nextIndex = _mm512_add_epi32(index, _mm512_load_si512(lanes.step + g));
+            _mm512_mask_store_ps(lanes.fraction + g, live, _mm512_mask_sub_ps(nextFraction, carry, nextFraction, one));
+            _mm512_mask_store_epi32(lanes.index + g, live, _mm512_mask_add_epi32(nextIndex, carry, nextIndex, oneInt));
+            _mm512_mask_store_ps(lanes.attack + g, live, _mm512_add_ps(attack, _mm512_load_ps(lanes.attackSlope + g)));
+            _mm512_mask_store_ps(lanes.release + g, live, _mm512_add_ps(release, _mm512_load_ps(lanes.releaseSlope + g)));
+            _mm512_mask_store_epi32(lanes.remaining + g, live, _mm512_sub_epi32(_mm512_load_si512(lanes.remaining + g), oneInt));
+        }
+
+        left[i] += _mm512_reduce_add_ps(sumLeft);
+        if (right != nullptr)
+            right[i] += _mm512_reduce_add_ps(sumRight);
+    }
+}
+
+static const KernelSet avx512Kernels { "AVX-512", multiplyAddAvx512, interpolateLinearAvx512, addClippedAvx512,
+                                       decodeInt16Avx512, decodeHalfAvx512, renderLanesAvx512 };
+
+#endif
+
+//==============================================================================
+#if JUCE_INTEL
+// ECX of CPUID leaf 1
+static juce::uint32 getFeatureFlags()
+{
+   #if JUCE_MSVC
+    int info[4];
+    __cpuid(info, 1);
+    return (juce::uint32)info[2];
+   #else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) ? ecx : 0;
+   #endif
+}
+
+static bool hasF16C()
+{
+    return (getFeatureFlags() & (1u << 29)) != 0;
+}
+
+// Whether the OS saves every register state in mask (bits of XCR0) across context switches;
+// a CPU can support AVX or AVX-512 while the OS leaves the wider registers disabled
+static bool isStateEnabled(juce::uint64 mask)
+{
+    if ((getFeatureFlags() & (1u << 27)) == 0) //OSXSAVE, without it xgetbv faults
+        return false;
+
+   #if JUCE_MSVC
+    auto xcr0 = (juce::uint64)_xgetbv(0);
+   #else
+    unsigned int low, high;
+    __asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+    auto xcr0 = ((juce::uint64)high << 32) | low;
+   #endif
+    return (xcr0 & mask) == mask;
+}
+
+static constexpr juce::uint64 ymmState = 0x06; // SSE and AVX
+static constexpr juce::uint64 zmmState = 0xe6; // plus opmask and both halves of the ZMM registers
+#endif
+
+static const KernelSet& selectKernels()
+{
+   #if JUCE_INTEL
+    if (juce::SystemStats::hasAVX512F() && isStateEnabled(zmmState))
+        return avx512Kernels;
+
+    if (juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3() && hasF16C() && isStateEnabled(ymmState))
+        return avx2Kernels;
+
+    if (juce::SystemStats::hasSSE41())
+        return sseKernels;
+   #endif
+
+    return scalarKernels;
+}
+
+const KernelSet& get() noexcept
+{
+    static const KernelSet& selected = selectKernels();
+    return selected;
+}
+
+}
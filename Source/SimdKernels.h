@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    SimdKernels.h
+    Created: 19 Oct 2026 5:03:48pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Inner loops of the grain renderer compiled for several x86 instruction sets.
+// The best set the CPU supports is picked once, so one binary runs at full
+// speed on every machine. Other architectures use the portable versions.
+namespace SimdKernels
+{
+    // Many grains side by side, one array per field, so a kernel can advance a
+    // whole vector of grains per instruction. Every array is 64 byte aligned and
+    // padded to a multiple of 16 grains; padding lanes have nothing remaining.
+    struct GrainLanes
+    {
+        juce::int32* index = nullptr;      // read position in the source, whole samples
+        float* fraction = nullptr;         // and the part in between
+        juce::int32* step = nullptr;       // read increment per output sample, whole samples
+        float* stepFraction = nullptr;     // and the part in between
+        float* attack = nullptr;           // trapezoid: rising ramp; hann: phase from -0.5 to 0.5
+        float* attackSlope = nullptr;
+        float* release = nullptr;          // trapezoid: falling ramp, unused for hann
+        float* releaseSlope = nullptr;
+        float* gainLeft = nullptr;
+        float* gainRight = nullptr;
+        float* gainMono = nullptr;         // read in place of gainLeft when the output is mono
+        juce::int32* delay = nullptr;      // samples before the grain starts
+        juce::int32* remaining = nullptr;  // samples left once it has
+    };
+
+    struct KernelSet
+    {
+        const char* name;
+
+        // dest[i] += source[i] * envelope[i]
+        void (*multiplyAdd)(float* dest, const float* source, const float* envelope, int numSamples);
+
+        // dest[i] = source interpolated at position + i * increment
+        void (*interpolateLinear)(float* dest, const float* source, double position, double increment, int numSamples);
+
+        // dest[i] += min(source[i], ceiling) * gain
+        void (*addClipped)(float* dest, const float* source, float ceiling, float gain, int numSamples);
+
+        // dest[i] = source[i] widened from 16 bit integer / IEEE half float storage
+        void (*decodeInt16)(float* dest, const juce::int16* source, int numSamples);
+        void (*decodeHalf)(float* dest, const juce::uint16* source, int numSamples);
+
+        // left[i] (and right[i], unless null) += every grain in the lanes, advanced together one
+        // output sample at a time; reads float samples, linearly interpolated
+        void (*renderLanes)(const float* source, GrainLanes& lanes, int numGrains, bool hann,
+                            float* left, float* right, int numSamples);
+    };
+
+    // Chosen from the CPU features on the first call
+    const KernelSet& get() noexcept;
+}
@@ -0,0 +1,258 @@
+/*
+  ==============================================================================
+
+    SpectralGrains.cpp
+    Created: 24 Oct 2026 10:21:14am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "SpectralGrains.h"
+#include "GrainKernels.h"
+
+int SpectralGrains::getSizeFor(int grainLength) noexcept
+{
+    int order = minOrder;
+    while (order < maxOrder && grainLength > (3 << (order - 1)))
+        order++;
+    return 1 << order;
+}
+
+size_t SpectralGrains::getScratchBytes() noexcept
+{
+    int maxSize = 1 << maxOrder;
+    return ScratchArena::bytesFor<float>(maxSize * 2) + 3 * ScratchArena::bytesFor<float>(maxSize / 2 + 1);
+}
+
+void SpectralGrains::prepare(int maxBlockSize)
+{
+    ffts.clear();
+    windows.clear();
+    for (int order = minOrder; order <= maxOrder; order++)
+    {
+        int size = 1 << order;
+        ffts.push_back(std::make_unique<juce::dsp::FFT>(order));
+
+        //periodic, so analysis times synthesis window is an exact Hann
+        std::vector<float> window((size_t)size);
+        for (int i = 0; i < size; i++)
+            window[(size_t)i] = std::sqrt(0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i / (float)size));
+        windows.push_back(std::move(window));
+    }
+
+    int maxSize = 1 << maxOrder;
+    frozenMagnitudes.assign((size_t)(maxSize / 2 + 1), 0.0f);
+
+    //a grain starting at the end of a block still fits in front of the read position
+    ring.setSize(2, juce::nextPowerOfTwo(maxSize + juce::jmax(1, maxBlockSize)));
+    ringMask = ring.getNumSamples() - 1;
+    reset();
+}
+
+void SpectralGrains::reset() noexcept
+{
+    numPending = 0;
+    numSounding = 0;
+    frozenOrder = 0;
+    readPosition = 0;
+    ring.clear();
+}
+
+bool SpectralGrains::addFileGrain(const SampleArena& arena, int arenaStart, int regionEnd, int length,
+                                  float pitch, float pan, float level, int startDelay) noexcept
+{
+    PendingGrain grain;
+    grain.arena = &arena;
+    grain.start = arenaStart;
+    grain.end = regionEnd;
+    grain.pitch = pitch;
+    return addGrain(grain, length, pan, level, startDelay);
+}
+
+bool SpectralGrains::addLiveGrain(const LiveInputBuffer& input, juce::int64 startPosition, int length,
+                                  float pitch, float pan, float level, int startDelay) noexcept
+{
+    PendingGrain grain;
+    grain.ring = input.getData();
+    grain.ringMask = input.getSize() - 1;
+    grain.start = startPosition;
+    grain.pitch = pitch;
+    return addGrain(grain, length, pan, level, startDelay);
+}
+
+bool SpectralGrains::addGrain(PendingGrain grain, int length, float pan, float level, int startDelay) noexcept
+{
+    if (ffts.empty() || numPending + numSounding >= maxGrains)
+        return false;
+
+    grain.order = juce::roundToInt(std::log2((float)getSizeFor(length)));
+    GrainKernels::setChannelGains(grain.gains, pan, level); //the same gains as the time-domain grains
+    grain.startDelay = startDelay;
+    pending[(size_t)numPending++] = grain;
+    return true;
+}
+
+void SpectralGrains::render(juce::AudioBuffer<float>& output, int numSamples, ScratchArena& scratch) noexcept
+{
+    if (ffts.empty() || numSamples <= 0)
+        return;
+
+    jassert(numSamples <= ring.getNumSamples() - (1 << maxOrder));
+    int numChannels = juce::jmin(2, output.getNumChannels());
+    int ringSize = ring.getNumSamples();
+
+    //grains starting inside this block are resynthesised into the ring before it is read
+    ScratchArena::Scope scope(scratch);
+    Workspace workspace {};
+    int kept = 0;
+    for (int i = 0; i < numPending; i++)
+    {
+        auto grain = pending[(size_t)i];
+        if (grain.startDelay < numSamples)
+        {
+            //taken once per block, and only by a block that starts a grain
+            if (workspace.frame == nullptr)
+            {
+                int maxSize = 1 << maxOrder;
+                workspace = { scratch.allocate<float>(maxSize * 2), scratch.allocate<float>(maxSize / 2 + 1),
+                              scratch.allocate<float>(maxSize / 2 + 1), scratch.allocate<float>(maxSize / 2 + 1) };
+            }
+            if (workspace.reshaped != nullptr)
+            {
+                synthesise(grain, numChannels, workspace);
+                soundingRemaining[(size_t)numSounding++] = grain.startDelay + (1 << grain.order);
+            }
+        }
+        else
+        {
+            grain.startDelay -= numSamples;
+            pending[(size_t)kept++] = grain;
+        }
+    }
+    numPending = kept;
+
+    //the block is moved out of the ring and cleared for the grains that wrap around to it next
+    int first = juce::jmin(numSamples, ringSize - readPosition);
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        float* out = output.getWritePointer(channel);
+        float* source = ring.getWritePointer(channel);
+        juce::FloatVectorOperations::add(out, source + readPosition, first);
+        juce::FloatVectorOperations::clear(source + readPosition, first);
+        juce::FloatVectorOperations::add(out + first, source, numSamples - first);
+        juce::FloatVectorOperations::clear(source, numSamples - first);
+    }
+    readPosition = (readPosition + numSamples) & ringMask;
+
+    kept = 0;
+    for (int i = 0; i < numSounding; i++)
+        if (soundingRemaining[(size_t)i] > numSamples)
+            soundingRemaining[(size_t)kept++] = soundingRemaining[(size_t)i] - numSamples;
+    numSounding = kept;
+}
+
+void SpectralGrains::synthesise(const PendingGrain& grain, int numChannels, const Workspace& workspace) noexcept
+{
+    int index = grain.order - minOrder;
+    int size = 1 << grain.order;
+    int numBins = size / 2 + 1;
+    const float* window = windows[(size_t)index].data();
+    float* data = workspace.frame;
+    float* magnitudes = workspace.magnitudes;
+    float* phases = workspace.phases;
+
+    //read at the source's own speed, the pitch is moved in the spectrum
+    if (grain.ring != nullptr)
+    {
+        for (int i = 0; i < size; i++)
+            data[i] = grain.ring[(grain.start + i) & grain.ringMask];
+    }
+    else
+    {
+        int available = juce::jlimit(0, size, grain.end - (int)grain.start);
+        grain.arena->readSamples(data, (int)grain.start, available);
+        std::fill(data + available, data + size, 0.0f);
+    }
+
+    juce::FloatVectorOperations::multiply(data, window, size);
+    ffts[(size_t)index]->performRealOnlyForwardTransform(data, true);
+
+    for (int k = 0; k < numBins; k++)
+    {
+        magnitudes[(size_t)k] = std::sqrt(data[2 * k] * data[2 * k] + data[2 * k + 1] * data[2 * k + 1]);
+        phases[(size_t)k] = std::atan2(data[2 * k + 1], data[2 * k]);
+    }
+
+    //freeze holds the first spectrum after it was engaged, every later grain only gets new phases
+    if (parameters.freeze)
+    {
+        if (frozenOrder != grain.order)
+        {
+            std::copy_n(magnitudes, numBins, frozenMagnitudes.begin());
+            frozenOrder = grain.order;
+        }
+        std::copy_n(frozenMagnitudes.begin(), numBins, magnitudes);
+        for (int k = 0; k < numBins; k++)
+            phases[(size_t)k] = random.nextFloat() * juce::MathConstants<float>::twoPi;
+    }
+    else
+    {
+        frozenOrder = 0;
+    }
+
+    //smear averages every magnitude with its neighbours, a running sum keeps it linear in the bin count
+    int smearBins = juce::roundToInt(juce::jlimit(0.0f, 1.0f, parameters.smear) * maxSmearBins);
+    if (smearBins > 0)
+    {
+        float sum = 0.0f;
+        for (int k = 0; k < juce::jmin(smearBins, numBins); k++)
+            sum += magnitudes[(size_t)k];
+        for (int k = 0; k < numBins; k++)
+        {
+            if (k + smearBins < numBins)
+                sum += magnitudes[(size_t)(k + smearBins)];
+            if (k - smearBins - 1 >= 0)
+                sum -= magnitudes[(size_t)(k - smearBins - 1)];
+            int count = juce::jmin(numBins - 1, k + smearBins) - juce::jmax(0, k - smearBins) + 1;
+            workspace.reshaped[(size_t)k] = sum / (float)count;
+        }
+        std::copy_n(workspace.reshaped, numBins, magnitudes);
+    }
+
+    //pitch moves every bin to pitch times its frequency, taking its phase along
+    for (int k = 0; k < numBins; k++)
+    {
+        float source = (float)k / grain.pitch;
+        int lower = (int)source;
+        float magnitude = 0.0f, phase = 0.0f;
+        if (lower + 1 < numBins)
+        {
+            float fraction = source - (float)lower;
+            magnitude = magnitudes[(size_t)lower] + fraction * (magnitudes[(size_t)lower + 1] - magnitudes[(size_t)lower]);
+            phase = phases[(size_t)(fraction < 0.5f ? lower : lower + 1)];
+        }
+        else if (lower + 1 == numBins)
+        {
+            magnitude = magnitudes[(size_t)lower];
+            phase = phases[(size_t)lower];
+        }
+        data[2 * k] = magnitude * std::cos(phase);
+        data[2 * k + 1] = magnitude * std::sin(phase);
+    }
+
+    ffts[(size_t)index]->performRealOnlyInverseTransform(data);
+    juce::FloatVectorOperations::multiply(data, window, size);
+
+    //overlap-added where the grain starts, wrapping around the end of the ring
+    int ringSize = ring.getNumSamples();
+    int writePosition = (readPosition + grain.startDelay) & ringMask;
+    int first = juce::jmin(size, ringSize - writePosition);
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        float gain = numChannels > 1 ? grain.gains[channel] : GrainKernels::getMonoGain(grain.gains);
+        float* destination = ring.getWritePointer(channel);
+        juce::FloatVectorOperations::addWithMultiply(destination + writePosition, data, gain, first);
+        juce::FloatVectorOperations::addWithMultiply(destination, data + first, gain, size - first);
+    }
+}
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    SpectralGrains.h
+    Created: 24 Oct 2026 10:21:14am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "SampleArena.h"
+#include "LiveInputBuffer.h"
+#include "ScratchArena.h"
+
+
+// Grains resynthesised in the frequency domain, the alternative to the
+// time-domain Grain. A grain is read at its own speed once it starts,
+// windowed, transformed, reshaped and transformed back, then overlap-added
+// into an output ring the voice drains every block. Pitch moves the partials
+// without changing the grain's length; smear spreads every magnitude over its
+// neighbouring bins; freeze holds the spectrum of the first grain after it was
+// engaged and gives every later grain fresh random phases. Plans and windows
+// exist for every supported size from prepare on; the frame and spectra being
+// worked on come from the caller's scratch arena.
+class SpectralGrains
+{
+public:
+
+    struct Parameters
+    {
+        float smear = 0.0f; // 0..1, up to maxSmearBins on either side
+        bool freeze = false;
+    };
+
+    static constexpr int minOrder = 8;  // 256 samples
+    static constexpr int maxOrder = 13; // 8192 samples
+    static constexpr int maxGrains = 128;
+    static constexpr int maxSmearBins = 16;
+
+    // The transform size a grain of this length is played at, the nearest supported power of two
+    static int getSizeFor(int grainLength) noexcept;
+
+    // Scratch one render takes at most, all of it handed back before render returns
+    static size_t getScratchBytes() noexcept;
+
+    // Allocates everything; blocks up to maxBlockSize can be rendered afterwards
+    void prepare(int maxBlockSize);
+    void setParameters(const Parameters& newParameters) noexcept { parameters = newParameters; }
+    // Drops every pending and sounding grain
+    void reset() noexcept;
+
+    // Schedules a grain startDelay samples into the next render. File grains read
+    // the arena from arenaStart, never past regionEnd; live grains read the ring
+    // from startPosition. Both return false when every grain slot is taken.
+    bool addFileGrain(const SampleArena& arena, int arenaStart, int regionEnd, int length,
+                      float pitch, float pan, float level, int startDelay) noexcept;
+    bool addLiveGrain(const LiveInputBuffer& input, juce::int64 startPosition, int length,
+                      float pitch, float pan, float level, int startDelay) noexcept;
+
+    // Adds the next numSamples of output to the first one or two channels of the buffer
+    void render(juce::AudioBuffer<float>& output, int numSamples, ScratchArena& scratch) noexcept;
+
+    // Grains waiting to start plus grains still sounding
+    int getNumGrains() const noexcept { return numPending + numSounding; }
+
+private:
+
+    struct PendingGrain
+    {
+        const SampleArena* arena = nullptr; // file grains
+        const float* ring = nullptr;        // live grains
+        int ringMask = 0;
+        juce::int64 start = 0;
+        int end = 0;
+        int order = minOrder;
+        float pitch = 1.0f;
+        float gains[2] = { 1.0f, 1.0f };
+        int startDelay = 0;
+    };
+
+    // spans of the scratch arena, sized for the largest transform
+    struct Workspace
+    {
+        float* frame;
+        float* magnitudes;
+        float* phases;
+        float* reshaped;
+    };
+
+    bool addGrain(PendingGrain grain, int length, float pan, float level, int startDelay) noexcept;
+    void synthesise(const PendingGrain& grain, int numChannels, const Workspace& workspace) noexcept;
+
+    Parameters parameters;
+    std::vector<std::unique_ptr<juce::dsp::FFT>> ffts;  // one plan per order
+    std::vector<std::vector<float>> windows;            // square root Hann per order, applied before and after
+    std::vector<float> frozenMagnitudes;
+    int frozenOrder = 0; // 0 until a spectrum has been held
+    juce::Random random;
+
+    // overlap-add output, two channels, a power of two long
+    juce::AudioBuffer<float> ring;
+    int ringMask = 0;
+    int readPosition = 0;
+
+    std::array<PendingGrain, maxGrains> pending;
+    int numPending = 0;
+    std::array<int, maxGrains> soundingRemaining; // samples left of each grain already in the ring
+    int numSounding = 0;
+};
@@ -0,0 +1,653 @@
+/*
+  ==============================================================================
+
+    StressMain.cpp
+    Created: 26 Oct 2026 3:47:21pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "GranularEngine.h"
+#include "CpuGovernor.h"
+#include "CommandLine.h"
+#include "LatencyHistogram.h"
+#include "SimdKernels.h"
+
+namespace
+{
+    const char* usage =
+        "Usage: GranSynthStress [options] [files or folders]...\n"
+        "\n"
+        "Renders the engine as fast as it goes under random parameter jumps, MIDI floods\n"
+        "and sample swaps, timing every block. Fails on non-finite output or when more\n"
+        "blocks than allowed take longer to render than a full block lasts. Without\n"
+        "sources it granulates generated noise, sweeps and clicks.\n"
+        "\n"
+        "  --minutes <n>         how long to run (default 60)\n"
+        "  --blocks <n>          stop after this many blocks instead\n"
+        "  --seed <n>            repeats an earlier run (default: from the clock)\n"
+        "  --block-size <n>      largest block, most blocks are this size (default 512)\n"
+        "  --budget <n>          fraction of a full block's duration any non-empty block may take (default 1)\n"
+        "  --max-violations <n>  blocks over budget before the run fails (default 0)\n"
+        "  --governor <mode>     off, grains or linear, as the plugin's CPU Governor (default grains)\n"
+        "  --trace <file>        writes a Chrome / Perfetto trace of the run to the file\n"
+        "  --formats             instead of the stress run, renders the same notes from float32, int16 and\n"
+        "                        half arenas and fails if the 16 bit renders stray from float32 too far\n"
+        "  --bench               instead of the stress run, times the faster render paths against the ones\n"
+        "                        they replace and fails if their output strays too far\n";
+
+    // --formats, --bench and --help are flags, the rest take a value
+    const juce::StringArray optionsWithValues { "--minutes", "--blocks", "--seed", "--block-size", "--budget",
+                                                "--max-violations", "--governor", "--trace" };
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int maxGrains = 4096;
+    constexpr int maxVoices = 5; // as many as the plugin
+    constexpr int maxEventsPerBlock = 256;
+
+    // One arena to swap to, with whatever the loader would have built for it
+    struct Source
+    {
+        SampleArena::Ptr arena;
+        SampleIndex::Ptr sampleIndex;
+        GrainCorpus::Ptr corpus;
+        std::vector<LoopSeams::Ptr> loops;
+    };
+
+    // Noise, a sweep, a click and a file too short to loop, in every storage format
+    std::vector<SampleArena::Ptr> generateArenas(juce::Random& random)
+    {
+        std::vector<int> lengths { (int)sampleRate * 2, (int)sampleRate * 5, 100, 30 };
+        juce::AudioBuffer<float> channels((int)lengths.size(), lengths[1]);
+        channels.clear();
+        for (int i = 0; i < lengths[0]; i++)
+            channels.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+        double phase = 0.0;
+        for (int i = 0; i < lengths[1]; i++)
+        {
+            phase += juce::MathConstants<double>::twoPi * (20.0 + 20000.0 * i / lengths[1]) / sampleRate;
+            channels.setSample(1, i, 0.8f * (float)std::sin(phase));
+        }
+        channels.setSample(2, 0, 1.0f);
+        for (int i = 0; i < lengths[3]; i++)
+            channels.setSample(3, i, 0.5f);
+
+        std::vector<SampleArena::Ptr> arenas;
+        for (auto format : { SampleArena::Format::float32, SampleArena::Format::int16, SampleArena::Format::half })
+            arenas.push_back(SampleArena::fromChannels(channels, lengths, format, sampleRate));
+        return arenas;
+    }
+
+    // Analysis and a few loops, built up front since the plugin builds them off the audio thread
+    Source prepareSource(SampleArena::Ptr arena, juce::Random& random)
+    {
+        Source source;
+        source.arena = arena;
+
+        source.sampleIndex = SampleIndex::build(*arena);
+        source.corpus = GrainCorpus::build(*arena);
+
+        source.loops.push_back(nullptr);
+        for (int i = 0; i < 3; i++)
+        {
+            LoopSeams::Settings settings;
+            settings.start = random.nextFloat() * 0.9f;
+            settings.end = juce::jmin(1.0f, settings.start + random.nextFloat());
+            settings.crossfadeSeconds = random.nextFloat() * 0.5f;
+            source.loops.push_back(LoopSeams::build(arena, settings));
+        }
+        return source;
+    }
+
+    // Every control jumps somewhere inside the range the plugin's parameters allow, sizes past them included
+    void randomiseParameters(GranularEngine::Parameters& parameters, juce::Random& random)
+    {
+        auto ms = [&](double low, double high) { return (int)((low + random.nextDouble() * (high - low)) / 1000.0 * sampleRate); };
+
+        parameters.grainSize = ms(5.0, 100.0);
+        parameters.grainOverlap = ms(0.0, 99.0); // often the whole grain or more
+        parameters.grainSpacing = random.nextInt(10) == 0 ? random.nextInt(2) : ms(1.0, 200.0);
+        parameters.grainEnvelope.shape = (GrainEnvelope::Shape)random.nextInt(2);
+        parameters.grainEnvelope.attackPercent = random.nextFloat() * 50.0f;
+        parameters.grainEnvelope.releasePercent = random.nextFloat() * 50.0f;
+        parameters.interpolation = (GrainKernels::Interpolation)random.nextInt(2);
+        parameters.snapMode = (SampleIndex::SnapMode)random.nextInt(3);
+        parameters.grainSource = (GranSynth::GrainSource)random.nextInt(3);
+        parameters.grainMode = random.nextInt(4) == 0 ? GranSynth::GrainMode::spectral : GranSynth::GrainMode::time;
+        parameters.spectral.smear = random.nextFloat();
+        parameters.spectral.freeze = random.nextBool();
+        parameters.unison.streams = 1 + random.nextInt(GranSynth::maxUnisonStreams);
+        parameters.unison.detuneCents = random.nextFloat() * 100.0f;
+        parameters.unison.positionSpread = ms(0.0, 500.0);
+        parameters.unison.stereoSpread = random.nextFloat();
+        parameters.sourceFile = random.nextInt(8);
+        parameters.sourceFileSelect = (GranularEngine::SourceFileSelect)random.nextInt(3);
+        parameters.liveDelay = ms(0.0, 2000.0);
+        parameters.cacheGrains = random.nextBool();
+
+        auto& modulation = parameters.modulation;
+        for (int l = 0; l < ModulationEngine::numLfos; l++)
+        {
+            modulation.lfoRates[l] = 0.01f + random.nextFloat() * 20.0f;
+            modulation.lfoShapes[l] = (ModulationEngine::LfoShape)random.nextInt(4);
+        }
+        for (auto& slot : modulation.slots)
+        {
+            slot.source = (ModulationEngine::Source)random.nextInt(ModulationEngine::numSources + 1);
+            slot.destination = (ModulationEngine::Destination)random.nextInt(ModulationEngine::numDestinations);
+            slot.amount = random.nextFloat() * 2.0f - 1.0f;
+        }
+        modulation.controlInterval = 8 << random.nextInt(4);
+        modulation.envelope = { random.nextFloat(), random.nextFloat(), random.nextFloat(), random.nextFloat() };
+        parameters.amplitudeEnvelope = { random.nextFloat() * 0.1f, random.nextFloat(), random.nextFloat(), random.nextFloat() * 2.0f };
+    }
+
+    // Mostly a note or two; now and then a whole block of them, or everything off
+    int makeEvents(GranularEngine::Event* events, juce::Random& random)
+    {
+        using Type = GranularEngine::Event::Type;
+        int numEvents = random.nextInt(100) == 0 ? maxEventsPerBlock : random.nextInt(3);
+        for (int i = 0; i < numEvents; i++)
+            events[i] = { random.nextBool() ? Type::noteOn : Type::noteOff, random.nextInt(128), random.nextFloat() };
+        if (random.nextInt(500) == 0 && numEvents < maxEventsPerBlock)
+            events[numEvents++] = { Type::allNotesOff, 0, 0.0f };
+        return numEvents;
+    }
+
+    // One note of a fixed patch from one file of the arena, both channels one after the other
+    std::vector<float> renderNote(SampleArena::Ptr arena, const GranularEngine::Parameters& parameters, int note)
+    {
+        constexpr int blockSize = 512;
+        constexpr int numBlocks = 100;
+        GranularEngine engine;
+        engine.prepare(blockSize, sampleRate, maxGrains, 1);
+        engine.setParameters(parameters);
+        engine.setSource(arena, nullptr, nullptr);
+
+        juce::AudioBuffer<float> output(2, blockSize);
+        std::vector<float> rendered;
+        GranularEngine::Event noteOn { GranularEngine::Event::Type::noteOn, note, 1.0f };
+        for (int block = 0; block < numBlocks; block++)
+        {
+            engine.render(output.getArrayOfWritePointers(), 2, blockSize, &noteOn, block == 0 ? 1 : 0);
+            for (int channel = 0; channel < 2; channel++)
+                rendered.insert(rendered.end(), output.getReadPointer(channel), output.getReadPointer(channel) + blockSize);
+        }
+        return rendered;
+    }
+
+    // The golden-reference check of the 16 bit storage formats: every interpolation, envelope and a few
+    // pitches, the root note's unity pitch among them, of the noise and the sweep, each compared with
+    // the float32 arena's render. The error is the largest difference in any sample as a fraction of
+    // the float32 render's peak.
+    int checkFormats(juce::Random& random)
+    {
+        auto arenas = generateArenas(random);
+        const char* names[] = { "float32", "int16", "half" };
+        const double maxErrors[] = { 0.0, 1.0e-4, 1.0e-3 };
+        double worst[] = { 0.0, 0.0, 0.0 };
+
+        GranularEngine::Parameters parameters;
+        parameters.grainSize = (int)(0.05 * sampleRate);
+        parameters.grainOverlap = parameters.grainSize / 2;
+        parameters.grainSpacing = 1;
+        for (auto interpolation : { GrainKernels::Interpolation::linear, GrainKernels::Interpolation::cubic })
+            for (auto shape : { GrainEnvelope::Shape::trapezoid, GrainEnvelope::Shape::hann })
+                for (int file = 0; file < 2; file++)
+                    for (int note : { 48, GranSynth::rootNote, 67 })
+                    {
+                        parameters.interpolation = interpolation;
+                        parameters.grainEnvelope = { shape, 20.0f, 20.0f };
+                        parameters.sourceFile = file;
+
+                        auto reference = renderNote(arenas[0], parameters, note);
+                        float peak = 0.0f;
+                        for (auto sample : reference)
+                            peak = juce::jmax(peak, std::abs(sample));
+
+                        for (size_t format = 1; format < arenas.size(); format++)
+                        {
+                            auto rendered = renderNote(arenas[format], parameters, note);
+                            float difference = 0.0f;
+                            for (size_t i = 0; i < reference.size(); i++)
+                                difference = juce::jmax(difference, std::abs(rendered[i] - reference[i]));
+                            worst[format] = juce::jmax(worst[format], (double)difference / juce::jmax(peak, 1.0e-6f));
+                        }
+                    }
+
+        int failures = 0;
+        for (size_t format = 1; format < arenas.size(); format++)
+        {
+            bool passed = worst[format] <= maxErrors[format];
+            failures += passed ? 0 : 1;
+            std::cout << names[format] << ": worst error " << worst[format] << " of the float32 peak, bound "
+                      << maxErrors[format] << (passed ? "" : " FAILED") << std::endl;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    // Seconds a render takes, the best of a few tries so a busy machine doesn't skew the comparison
+    template <typename RenderFunction>
+    double timeRender(RenderFunction&& render)
+    {
+        double best = 0.0;
+        for (int attempt = 0; attempt < 5; attempt++)
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+            render();
+            double seconds = (double)(juce::Time::getHighResolutionTicks() - start) / (double)juce::Time::getHighResolutionTicksPerSecond();
+            best = attempt == 0 ? seconds : juce::jmin(best, seconds);
+        }
+        return best;
+    }
+
+    struct BenchResult
+    {
+        double speedup = 0.0;
+        double error = -1.0; // left negative when the two paths aren't meant to sound the same
+        double peak = 0.0;
+    };
+
+    // The largest difference in any sample as a fraction of the reference's peak
+    void compareOutputs(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& rendered, BenchResult& result)
+    {
+        float peak = 0.0f, difference = 0.0f;
+        for (int channel = 0; channel < reference.getNumChannels(); channel++)
+            for (int i = 0; i < reference.getNumSamples(); i++)
+            {
+                peak = juce::jmax(peak, std::abs(reference.getSample(channel, i)));
+                difference = juce::jmax(difference, std::abs(rendered.getSample(channel, i) - reference.getSample(channel, i)));
+            }
+        result.peak = peak;
+        result.error = (double)difference / juce::jmax(peak, 1.0e-6f);
+    }
+
+    // A dense cloud as a voice spawns it: 100 overlapping 300-sample grains of the noise at random pitches
+    // and pans, rendered as spans one grain at a time and as a GrainCloud, for each envelope shape, in
+    // stereo and mono
+    std::vector<BenchResult> benchmarkCloud(SampleArena::Ptr arena, juce::Random& random)
+    {
+        constexpr int numGrains = 100;
+        constexpr int grainLength = 300;
+        constexpr int blockSize = 512;
+        constexpr int numBlocks = 2;
+        constexpr int rounds = 200;
+        const auto& region = arena->getRegion(0);
+        const float* storage = static_cast<const float*>(arena->getStorage());
+
+        struct Spawn { int start, length, delay; float pitch, pan; };
+        std::vector<Spawn> spawns;
+        for (int g = 0; g < numGrains; g++)
+        {
+            Spawn spawn;
+            spawn.start = random.nextInt(region.length - 2 * grainLength);
+            spawn.pitch = 0.5f + random.nextFloat() * 1.5f;
+            spawn.pan = random.nextFloat() * 2.0f - 1.0f;
+            spawn.delay = random.nextInt(blockSize);
+            spawn.length = Grain::fitToFile(region.length, spawn.start, grainLength, spawn.pitch, GrainKernels::Interpolation::linear);
+            spawns.push_back(spawn);
+        }
+
+        std::vector<BenchResult> results;
+        std::vector<Grain> grains;
+        grains.reserve(numGrains);
+        GrainCloud cloud;
+        cloud.reserve(numGrains);
+        for (auto shape : { GrainEnvelope::Shape::trapezoid, GrainEnvelope::Shape::hann })
+            for (int numChannels : { 2, 1 })
+            {
+                GrainEnvelope::Parameters envelope { shape, 20.0f, 20.0f };
+                juce::AudioBuffer<float> block(numChannels, blockSize);
+                juce::AudioBuffer<float> spanOutput(numChannels, blockSize * numBlocks), cloudOutput(numChannels, blockSize * numBlocks);
+
+                auto renderSpans = [&]
+                {
+                    grains.clear();
+                    for (auto& spawn : spawns)
+                    {
+                        int key = GrainKernels::getKernelKey(SampleArena::Format::float32, GrainKernels::Interpolation::linear,
+                                                             shape, spawn.pitch == 1.0f);
+                        grains.emplace_back(arena->getRegionData(0), region.length, spawn.start, grainLength, spawn.pitch,
+                                            envelope, GrainKernels::Interpolation::linear, spawn.delay, key, spawn.pan);
+                    }
+                    for (int b = 0; b < numBlocks; b++)
+                    {
+                        block.clear();
+                        for (auto& grain : grains)
+                            grain.processGrain(GrainKernels::getRenderFunction(grain.getKernelKey(), numChannels), block);
+                        for (int channel = 0; channel < numChannels; channel++)
+                            spanOutput.copyFrom(channel, b * blockSize, block, channel, 0, blockSize);
+                    }
+                };
+                auto renderCloud = [&]
+                {
+                    cloud.clear();
+                    for (auto& spawn : spawns)
+                        cloud.add(region.offset + spawn.start, spawn.length, spawn.pitch, envelope, spawn.delay, spawn.pan);
+                    for (int b = 0; b < numBlocks; b++)
+                    {
+                        block.clear();
+                        cloud.render(storage, block, blockSize);
+                        for (int channel = 0; channel < numChannels; channel++)
+                            cloudOutput.copyFrom(channel, b * blockSize, block, channel, 0, blockSize);
+                    }
+                };
+
+                BenchResult result;
+                result.speedup = timeRender([&] { for (int r = 0; r < rounds; r++) renderSpans(); })
+                               / timeRender([&] { for (int r = 0; r < rounds; r++) renderCloud(); });
+                compareOutputs(spanOutput, cloudOutput, result);
+                results.push_back(result);
+            }
+        return results;
+    }
+
+    // Eight unison streams of 1024-sample grains in one voice, rendered side by side, against eight
+    // single-stream voices playing neighbouring notes
+    BenchResult benchmarkUnison(SampleArena::Ptr arena)
+    {
+        constexpr int blockSize = 512;
+        constexpr int numBlocks = 200;
+        constexpr int numStreams = 8;
+
+        GranularEngine::Parameters parameters;
+        parameters.grainSize = 1024;
+        parameters.grainOverlap = parameters.grainSize / 2;
+        parameters.grainSpacing = 1;
+        parameters.grainEnvelope = { GrainEnvelope::Shape::hann, 20.0f, 20.0f };
+        parameters.interpolation = GrainKernels::Interpolation::linear;
+
+        auto timeEngine = [&](int numVoices, int streams)
+        {
+            auto voiceParameters = parameters;
+            voiceParameters.unison.streams = streams;
+            voiceParameters.unison.detuneCents = 20.0f;
+            voiceParameters.unison.stereoSpread = 1.0f;
+            GranularEngine engine;
+            engine.prepare(blockSize, sampleRate, maxGrains, numVoices);
+            engine.setParameters(voiceParameters);
+            engine.setSource(arena, nullptr, nullptr);
+
+            juce::AudioBuffer<float> output(2, blockSize);
+            std::vector<GranularEngine::Event> notes;
+            for (int v = 0; v < numVoices; v++)
+                notes.push_back({ GranularEngine::Event::Type::noteOn, GranSynth::rootNote + v, 1.0f });
+            engine.render(output.getArrayOfWritePointers(), 2, blockSize, notes.data(), (int)notes.size());
+            return timeRender([&]
+            {
+                for (int block = 0; block < numBlocks; block++)
+                    engine.render(output.getArrayOfWritePointers(), 2, blockSize, nullptr, 0);
+            });
+        };
+
+        BenchResult result;
+        result.speedup = timeEngine(numStreams, 1) / timeEngine(1, numStreams);
+        return result;
+    }
+
+    // A note played over and over, 50 ms cubic Hann grains four deep, rendered by a voice and mixed
+    // from the grain cache once its background thread has rendered them
+    BenchResult benchmarkCache(SampleArena::Ptr arena)
+    {
+        constexpr int blockSize = 512;
+        constexpr int numBlocks = 40;
+        constexpr int rounds = 10;
+
+        GranularEngine::Parameters parameters;
+        parameters.grainSize = (int)(0.05 * sampleRate);
+        parameters.grainOverlap = parameters.grainSize * 3 / 4;
+        parameters.grainSpacing = 1;
+        parameters.grainEnvelope = { GrainEnvelope::Shape::hann, 20.0f, 20.0f };
+        parameters.interpolation = GrainKernels::Interpolation::cubic;
+
+        struct Player
+        {
+            GranularEngine engine;
+            juce::AudioBuffer<float> output { 2, blockSize * numBlocks };
+
+            Player(SampleArena::Ptr arena, GranularEngine::Parameters parameters, bool cached)
+            {
+                parameters.cacheGrains = cached;
+                engine.prepare(blockSize, sampleRate, maxGrains, 1);
+                engine.setParameters(parameters);
+                engine.setSource(arena, nullptr, nullptr);
+            }
+
+            void playNote()
+            {
+                engine.reset();
+                GranularEngine::Event noteOn { GranularEngine::Event::Type::noteOn, GranSynth::rootNote, 1.0f };
+                for (int block = 0; block < numBlocks; block++)
+                {
+                    float* channels[] = { output.getWritePointer(0, block * blockSize), output.getWritePointer(1, block * blockSize) };
+                    engine.render(channels, 2, blockSize, &noteOn, block == 0 ? 1 : 0);
+                }
+            }
+        };
+
+        Player direct(arena, parameters, false), cached(arena, parameters, true);
+
+        //grains are rendered the second time they are missed, on the cache's own thread
+        for (int warmUp = 0; warmUp < 3; warmUp++)
+        {
+            cached.playNote();
+            juce::Thread::sleep(200);
+        }
+
+        BenchResult result;
+        result.speedup = timeRender([&] { for (int r = 0; r < rounds; r++) direct.playNote(); })
+                       / timeRender([&] { for (int r = 0; r < rounds; r++) cached.playNote(); });
+        compareOutputs(direct.output, cached.output, result);
+        return result;
+    }
+
+    // The render paths that take over from simpler ones when they are faster, each timed against the
+    // path it replaces and checked to sound the same
+    int runBenchmarks(juce::Random& random)
+    {
+        auto arenas = generateArenas(random);
+        int failures = 0;
+        auto report = [&](const juce::String& name, const BenchResult& result, double maxError)
+        {
+            std::cout << name << ": " << result.speedup << "x as fast";
+            if (result.error >= 0.0)
+            {
+                bool passed = result.error <= maxError;
+                failures += passed ? 0 : 1;
+                std::cout << ", worst error " << result.error << " of the peak of " << result.peak
+                          << ", bound " << maxError << (passed ? "" : " FAILED");
+            }
+            std::cout << std::endl;
+        };
+
+        auto cloudResults = benchmarkCloud(arenas[0], random);
+        const char* cloudNames[] = { "cloud, trapezoid, stereo", "cloud, trapezoid, mono", "cloud, hann, stereo", "cloud, hann, mono" };
+        for (size_t i = 0; i < cloudResults.size(); i++)
+            report(cloudNames[i], cloudResults[i], 1.0e-4);
+        report("8 unison streams against 8 voices", benchmarkUnison(arenas[0]), 0.0);
+        report("grain cache, repeated note", benchmarkCache(arenas[0]), 1.0e-4);
+
+        return failures == 0 ? 0 : 1;
+    }
+
+    void printReport(juce::int64 blocks, const LatencyHistogram& histogram, int violations)
+    {
+        std::cout << blocks << " blocks, render us p50 " << histogram.getPercentile(0.5)
+                  << " p99 " << histogram.getPercentile(0.99) << " p99.9 " << histogram.getPercentile(0.999)
+                  << " max " << histogram.getMaximum() << ", " << violations << " over budget" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    return juce::ConsoleApplication::invokeCatchingFailures([&]
+    {
+        juce::ArgumentList args(argc, argv);
+        if (args.containsOption("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        auto option = [&](const char* name, double fallback)
+        {
+            return args.containsOption(name) ? args.getValueForOption(name).getDoubleValue() : fallback;
+        };
+        double minutes = option("--minutes", 60.0);
+        auto maxBlocks = (juce::int64)option("--blocks", 0.0);
+        auto seed = (juce::int64)option("--seed", (double)juce::Time::currentTimeMillis());
+        int blockSize = juce::jlimit(1, 8192, (int)option("--block-size", 512.0));
+        double budget = option("--budget", 1.0);
+        int maxViolations = (int)option("--max-violations", 0.0);
+        auto governorMode = args.getValueForOption("--governor");
+        auto mode = governorMode == "off" ? CpuGovernor::Mode::off
+                  : governorMode == "linear" ? CpuGovernor::Mode::grainsAndInterpolation : CpuGovernor::Mode::grains;
+
+        TraceRecorder tracer;
+        if (args.containsOption("--trace"))
+        {
+            auto traceFile = args.getFileForOption("--trace");
+            if (! tracer.start(traceFile))
+                juce::ConsoleApplication::fail(traceFile.getFullPathName() + ": could not be written");
+        }
+
+        std::cout << "Seed " << seed << ", " << SimdKernels::get().name << " grain kernels" << std::endl;
+        juce::Random random(seed);
+        if (args.containsOption("--formats"))
+            return checkFormats(random);
+        if (args.containsOption("--bench"))
+            return runBenchmarks(random);
+
+        juce::Array<juce::File> missing;
+        auto files = CommandLine::findAudioFiles(args, optionsWithValues, missing);
+        for (auto& file : missing)
+            std::cerr << "Skipping " << file.getFullPathName() << ": not found" << std::endl;
+        std::vector<SampleArena::Ptr> arenas;
+        if (files.isEmpty())
+            arenas = generateArenas(random);
+        else
+            for (auto format : { SampleArena::Format::float32, SampleArena::Format::int16 })
+                if (auto arena = SampleArena::loadFiles(files, format))
+                    arenas.push_back(arena);
+        if (arenas.empty())
+            juce::ConsoleApplication::fail("No sources could be decoded");
+
+        std::vector<Source> sources;
+        for (auto& arena : arenas)
+            sources.push_back(prepareSource(arena, random));
+
+        //everything the loop touches exists before the clock starts
+        GranularEngine engine;
+        engine.setTracer(&tracer);
+        engine.prepare(blockSize, sampleRate, maxGrains, maxVoices);
+        LiveInputBuffer liveInput;
+        liveInput.prepare(sampleRate, blockSize);
+        engine.setLiveInput(&liveInput);
+        CpuGovernor cpuGovernor;
+        cpuGovernor.prepare(sampleRate, maxVoices);
+        cpuGovernor.setMode(mode);
+
+        juce::AudioBuffer<float> output(2, blockSize);
+        juce::AudioBuffer<float> input(2, blockSize);
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < blockSize; i++)
+                input.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+        std::array<GranularEngine::Event, maxEventsPerBlock> events;
+
+        GranularEngine::Parameters parameters;
+        randomiseParameters(parameters, random);
+        const auto& first = sources.front();
+        engine.setSource(first.arena, first.sampleIndex, first.corpus, first.loops[1]);
+
+        LatencyHistogram histogram;
+        int violations = 0;
+        auto endTime = juce::Time::getMillisecondCounterHiRes() + minutes * 60000.0;
+        auto nextReport = juce::Time::getMillisecondCounterHiRes() + 10000.0;
+        double secondsPerTick = 1.0 / (double)juce::Time::getHighResolutionTicksPerSecond();
+
+        for (juce::int64 block = 0; maxBlocks > 0 ? block < maxBlocks : juce::Time::getMillisecondCounterHiRes() < endTime; block++)
+        {
+            //hosts mostly send full blocks, sometimes shorter ones, very rarely empty ones
+            int numSamples = random.nextInt(4) != 0 ? blockSize : random.nextInt(blockSize + 1);
+
+            if (random.nextInt(50) == 0)
+                randomiseParameters(parameters, random);
+            else if (random.nextInt(4) == 0)
+            {
+                //a single automated control moving a little
+                auto jumped = parameters;
+                randomiseParameters(jumped, random);
+                switch (random.nextInt(4))
+                {
+                    case 0: parameters.grainSize = jumped.grainSize; break;
+                    case 1: parameters.grainOverlap = jumped.grainOverlap; break;
+                    case 2: parameters.grainSpacing = jumped.grainSpacing; break;
+                    default: parameters.unison.streams = jumped.unison.streams; break;
+                }
+            }
+
+            //the same budget keeping as the plugin's processBlock
+            cpuGovernor.beginBlock();
+            auto blockParameters = parameters;
+            if (cpuGovernor.shouldUseLinearInterpolation())
+                blockParameters.interpolation = GrainKernels::Interpolation::linear;
+            engine.setParameters(blockParameters);
+            engine.setGrainCap(cpuGovernor.getGrainCap());
+            engine.setVoiceCap(cpuGovernor.getVoiceCap());
+
+            if (random.nextInt(200) == 0)
+            {
+                //the loader publishes a new arena, sometimes before its analysis is done
+                const auto& source = sources[(size_t)random.nextInt((int)sources.size())];
+                bool analysed = random.nextBool();
+                engine.setSource(source.arena, analysed ? source.sampleIndex : nullptr, analysed ? source.corpus : nullptr,
+                                 source.loops[(size_t)random.nextInt((int)source.loops.size())]);
+            }
+
+            liveInput.setFrozen(random.nextInt(20) == 0);
+            liveInput.write(input, 2, 0, numSamples);
+            int numEvents = makeEvents(events.data(), random);
+
+            auto start = juce::Time::getHighResolutionTicks();
+            engine.render(output.getArrayOfWritePointers(), 2, numSamples, events.data(), numEvents);
+            double micros = (double)(juce::Time::getHighResolutionTicks() - start) * secondsPerTick * 1.0e6;
+            cpuGovernor.endBlock(numSamples, engine.getNumGrains());
+            engine.releasePending(); //the plugin's timer does this on the message thread
+
+            //a short block still has the whole callback's deadline, and an empty one has no duration at all
+            histogram.add(micros);
+            if (numSamples > 0 && micros > budget * blockSize / sampleRate * 1.0e6)
+            {
+                violations++;
+                tracer.addInstant("over budget", (int)micros);
+            }
+
+            for (int channel = 0; channel < 2; channel++)
+            {
+                const float* samples = output.getReadPointer(channel);
+                for (int i = 0; i < numSamples; i++)
+                    if (! std::isfinite(samples[i]))
+                        juce::ConsoleApplication::fail("Block " + juce::String(block) + ": non-finite output (seed "
+                                                       + juce::String(seed) + ")");
+            }
+
+            if (maxBlocks == 0 && juce::Time::getMillisecondCounterHiRes() >= nextReport)
+            {
+                printReport(block + 1, histogram, violations);
+                nextReport += 10000.0;
+            }
+        }
+
+        tracer.stop();
+        printReport(histogram.getCount(), histogram, violations);
+        if (violations > maxViolations)
+        {
+            std::cerr << violations << " blocks took longer than " << budget << " of a full block's duration (seed " << seed << ")" << std::endl;
+            return 1;
+        }
+        return 0;
+    });
+}
@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.cpp
+    Created: 26 Oct 2026 9:12:05am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "TraceRecorder.h"
+#include "SimdKernels.h"
+
+#if JUCE_WINDOWS
+ #include <process.h>
+#else
+ #include <unistd.h>
+#endif
+
+TraceRecorder::TraceRecorder(int capacity)
+    : juce::Thread("Trace writer"),
+      events(new Event[(size_t)juce::nextPowerOfTwo(juce::jmax(2, capacity))]),
+      mask((juce::uint64)juce::nextPowerOfTwo(juce::jmax(2, capacity)) - 1)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const juce::File& file)
+{
+    stop();
+
+    auto newStream = std::make_unique<juce::FileOutputStream>(file);
+    if (! newStream->openedOk())
+        return false;
+    newStream->setPosition(0);
+    newStream->truncate();
+    *newStream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    {
+        const juce::ScopedLock lock(fileLock);
+        stream = std::move(newStream);
+        originTicks = now();
+        firstEvent = true;
+    }
+
+    dropped = 0;
+    recording = true;
+    startThread();
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    recording = false;
+    stopThread(-1);
+
+    //whatever was published before recording stopped still goes in
+    drain();
+
+    const juce::ScopedLock lock(fileLock);
+    if (stream != nullptr)
+    {
+        *stream << "\n],\"otherData\":{\"grainKernels\":\"" << SimdKernels::get().name
+                << "\",\"droppedEvents\":" << getNumDropped() << "}}\n";
+        stream->flush();
+        stream.reset();
+    }
+}
+
+void TraceRecorder::addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks, int value) noexcept
+{
+    if (isRecording())
+        push(name, startTicks, juce::jmax(startTicks, endTicks), value);
+}
+
+void TraceRecorder::addInstant(const char* name, int value) noexcept
+{
+    if (isRecording())
+        push(name, now(), -1, value);
+}
+
+void TraceRecorder::push(const char* name, juce::int64 startTicks, juce::int64 endTicks, int value) noexcept
+{
+    //a slot is claimed only while the writer has not fallen a whole ring behind, so no two events share one
+    auto index = writeIndex.load(std::memory_order_relaxed);
+    do
+    {
+        if (index - readIndex.load(std::memory_order_acquire) > mask)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    while (! writeIndex.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+
+    auto& event = events[(size_t)(index & mask)];
+    event.name = name;
+    event.startTicks = startTicks;
+    event.endTicks = endTicks;
+    event.thread = getThreadIndex();
+    event.value = value;
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+void TraceRecorder::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(100);
+        drain();
+    }
+}
+
+void TraceRecorder::drain()
+{
+    const juce::ScopedLock lock(fileLock);
+    double microsPerTick = 1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond();
+
+    //events are written in the order they were claimed, stopping at the first one still being filled in
+    auto index = readIndex.load(std::memory_order_relaxed);
+    for (;; index++)
+    {
+        auto& event = events[(size_t)(index & mask)];
+        if (event.sequence.load(std::memory_order_acquire) != index + 1)
+            break;
+
+        //left over from a trace that has already been closed
+        if (stream != nullptr && event.startTicks >= originTicks)
+        {
+            *stream << (firstEvent ? "" : ",\n")
+                    << "{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << event.thread
+                    << ",\"ts\":" << juce::String((double)(event.startTicks - originTicks) * microsPerTick, 3);
+            if (event.endTicks < 0)
+                *stream << ",\"ph\":\"i\",\"s\":\"t\"";
+            else
+                *stream << ",\"ph\":\"X\",\"dur\":" << juce::String((double)(event.endTicks - event.startTicks) * microsPerTick, 3);
+            *stream << ",\"args\":{\"value\":" << event.value << "}}";
+            firstEvent = false;
+        }
+
+        readIndex.store(index + 1, std::memory_order_release);
+    }
+
+    if (stream != nullptr)
+        stream->flush();
+}
+
+juce::File TraceRecorder::getInstanceFile(const juce::File& file)
+{
+   #if JUCE_WINDOWS
+    int processId = _getpid();
+   #else
+    int processId = (int)getpid();
+   #endif
+    static std::atomic<int> numFiles { 0 };
+    return file.getSiblingFile(file.getFileNameWithoutExtension() + "-" + juce::String(processId)
+                               + "-" + juce::String(++numFiles) + file.getFileExtension());
+}
+
+int TraceRecorder::getThreadIndex() noexcept
+{
+    //small stable numbers read better in the trace viewer than native thread ids; a table rather than
+    //thread_local storage, which a plugin loaded at run time may allocate on the audio thread's first use
+    auto id = juce::Thread::getCurrentThreadId();
+    int known = juce::jmin(numThreads.load(std::memory_order_acquire), maxThreads);
+    for (int i = 0; i < known; i++)
+        if (threadIds[i].load(std::memory_order_acquire) == id)
+            return i + 1;
+
+    //only this thread adds its own id, so it can't be added twice; past the table threads share id 0
+    if (known == maxThreads)
+        return 0;
+    int slot = numThreads.fetch_add(1, std::memory_order_acq_rel);
+    if (slot >= maxThreads)
+        return 0;
+    threadIds[slot].store(id, std::memory_order_release);
+    return slot + 1;
+}
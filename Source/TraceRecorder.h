@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+    Created: 26 Oct 2026 9:12:05am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// Timestamped spans from the render threads, written out as a Chrome trace
+// (load it in Perfetto or chrome://tracing). Any number of threads record into
+// one preallocated ring without locks or allocation; a background thread
+// drains it to the file a few times a second. A full ring drops the newest
+// events and counts them; the count and the grain kernels picked for this
+// machine go in the file's metadata. Names must be string literals, they are
+// stored as pointers and written out as they are.
+class TraceRecorder : private juce::Thread
+{
+public:
+
+    explicit TraceRecorder(int capacity = 1 << 16);
+    ~TraceRecorder() override;
+
+    // Starts a new trace file, replacing any trace being written; returns false if the file can't be opened
+    bool start(const juce::File& file);
+    // Writes what is left in the ring and the metadata, then closes the file
+    void stop();
+    bool isRecording() const noexcept { return recording.load(std::memory_order_relaxed); }
+
+    static juce::int64 now() noexcept { return juce::Time::getHighResolutionTicks(); }
+
+    // The file with the process id and a count of the calls in this process added to its name,
+    // e.g. trace-4121-2.json, so plugin instances given the same path each write their own trace
+    static juce::File getInstanceFile(const juce::File& file);
+
+    // A span from startTicks to endTicks on the calling thread, value shows up in its arguments
+    void addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks, int value = 0) noexcept;
+    // A point in time on the calling thread
+    void addInstant(const char* name, int value = 0) noexcept;
+
+    // Events dropped because the ring was full, since the trace started
+    int getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+    // Records its own lifetime as a span; does nothing without a recording tracer
+    class Span
+    {
+    public:
+        Span(TraceRecorder* tracer, const char* spanName, int spanValue = 0) noexcept
+            : recorder(tracer != nullptr && tracer->isRecording() ? tracer : nullptr),
+              name(spanName), value(spanValue), startTicks(recorder != nullptr ? now() : 0)
+        {
+        }
+
+        ~Span()
+        {
+            if (recorder != nullptr)
+                recorder->addSpan(name, startTicks, now(), value);
+        }
+
+        // For values only known once the work is done, e.g. how many grains were spawned
+        void setValue(int newValue) noexcept { value = newValue; }
+
+    private:
+        TraceRecorder* recorder;
+        const char* name;
+        int value;
+        juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (Span)
+    };
+
+private:
+
+    struct Event
+    {
+        std::atomic<juce::uint64> sequence { 0 }; // index + 1 once the event at index is written
+        const char* name = nullptr;
+        juce::int64 startTicks = 0;
+        juce::int64 endTicks = 0; // -1 for an instant
+        int thread = 0;
+        int value = 0;
+    };
+
+    void run() override;
+    void push(const char* name, juce::int64 startTicks, juce::int64 endTicks, int value) noexcept;
+    // Writes every event published so far, background thread or stop only
+    void drain();
+    int getThreadIndex() noexcept;
+
+    std::unique_ptr<Event[]> events;
+    juce::uint64 mask;
+    std::atomic<juce::uint64> writeIndex { 0 };
+    std::atomic<juce::uint64> readIndex { 0 };
+    std::atomic<bool> recording { false };
+    std::atomic<int> dropped { 0 };
+
+    // threads that have recorded, their trace ids are their places here plus one
+    static constexpr int maxThreads = 64;
+    std::atomic<juce::Thread::ThreadID> threadIds[maxThreads] {};
+    std::atomic<int> numThreads { 0 };
+
+    juce::CriticalSection fileLock; // between drain on the background thread and start / stop
+    std::unique_ptr<juce::FileOutputStream> stream;
+    juce::int64 originTicks = 0;
+    bool firstEvent = true;
+
+    JUCE_DECLARE_NON_COPYABLE (TraceRecorder)
+};
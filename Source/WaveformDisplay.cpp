@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    WaveformDisplay.cpp
+    Created: 23 Oct 2026 10:54:07am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "WaveformDisplay.h"
+
+WaveformDisplay::WaveformDisplay(std::function<PeakPyramid::Ptr()> newPeakSource, GrainPositionFifo& fifo)
+    : peakSource(std::move(newPeakSource)), grainPositions(fifo)
+{
+    pulled.resize(GrainPositionFifo::capacity);
+    grainMarks.reserve(GrainPositionFifo::capacity);
+    startTimerHz(60);
+}
+
+WaveformDisplay::~WaveformDisplay()
+{
+    stopTimer();
+}
+
+void WaveformDisplay::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    g.fillAll(juce::Colours::black.withAlpha(0.6f));
+
+    if (peaks == nullptr || peaks->getNumSamples() == 0)
+    {
+        g.setColour(juce::Colours::grey);
+        g.drawText("No sample loaded", getLocalBounds(), juce::Justification::centred);
+        return;
+    }
+
+    //peaks are drawn around the centre line, the RMS inside the min / max range
+    float centre = bounds.getCentreY();
+    float scale = bounds.getHeight() * 0.5f;
+    for (size_t x = 0; x < pixelPeaks.size(); x++)
+    {
+        const auto& peak = pixelPeaks[x];
+        g.setColour(juce::Colours::lightblue.withAlpha(0.6f));
+        g.drawVerticalLine((int)x, centre - peak.max * scale, centre - peak.min * scale + 1.0f);
+        g.setColour(juce::Colours::lightblue);
+        g.drawVerticalLine((int)x, centre - peak.rms * scale, centre + peak.rms * scale + 1.0f);
+    }
+
+    //grains that played since the last frame
+    double samplesPerPixel = (visibleEnd - visibleStart) / juce::jmax(1, getWidth());
+    g.setColour(juce::Colours::orange.withAlpha(0.5f));
+    for (auto position : grainMarks)
+    {
+        double x = (position - visibleStart) / samplesPerPixel;
+        if (x >= 0.0 && x < getWidth())
+            g.drawVerticalLine((int)x, bounds.getY(), bounds.getBottom());
+    }
+}
+
+void WaveformDisplay::resized()
+{
+    updatePeaks();
+}
+
+void WaveformDisplay::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel)
+{
+    if (peaks == nullptr || peaks->getNumSamples() == 0 || getWidth() == 0)
+        return;
+
+    //the sample under the pointer stays put, zoomed in as far as four pixels per sample
+    double length = visibleEnd - visibleStart;
+    double anchor = visibleStart + event.position.x / getWidth() * length;
+    double minimumLength = juce::jmax(16.0, getWidth() * 0.25);
+    double newLength = juce::jlimit(minimumLength, juce::jmax(minimumLength, (double)peaks->getNumSamples()),
+                                    length * std::pow(2.0, -wheel.deltaY * 4.0));
+
+    visibleStart = anchor - (anchor - visibleStart) * newLength / length;
+    visibleStart = juce::jlimit(0.0, juce::jmax(0.0, peaks->getNumSamples() - newLength), visibleStart);
+    visibleEnd = visibleStart + newLength;
+
+    updatePeaks();
+    repaint();
+}
+
+void WaveformDisplay::mouseDoubleClick(const juce::MouseEvent&)
+{
+    visibleStart = 0.0;
+    visibleEnd = peaks != nullptr ? peaks->getNumSamples() : 0.0;
+    updatePeaks();
+    repaint();
+}
+
+void WaveformDisplay::timerCallback()
+{
+    auto newPeaks = peakSource();
+    if (newPeaks != peaks)
+    {
+        peaks = newPeaks;
+        visibleStart = 0.0;
+        visibleEnd = peaks != nullptr ? peaks->getNumSamples() : 0.0;
+        updatePeaks();
+        repaint();
+    }
+
+    //only repaints while grains are playing, and once more to clear the last marks
+    int numPulled = grainPositions.pull(pulled.data(), (int)pulled.size());
+    if (numPulled > 0 || ! grainMarks.empty())
+    {
+        grainMarks.assign(pulled.begin(), pulled.begin() + numPulled);
+        repaint();
+    }
+}
+
+void WaveformDisplay::updatePeaks()
+{
+    pixelPeaks.resize((size_t)juce::jmax(0, getWidth()));
+    if (peaks != nullptr)
+        peaks->getPeaks(visibleStart, visibleEnd, pixelPeaks.data(), (int)pixelPeaks.size());
+}
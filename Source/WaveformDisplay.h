@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    WaveformDisplay.h
+    Created: 23 Oct 2026 10:54:07am
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "PeakPyramid.h"
+#include "GrainPositionFifo.h"
+
+
+// The loaded sample drawn from its peak pyramid, with a mark wherever a grain
+// has played since the last frame. Never touches audio data: the overview
+// comes from the pyramid and the grain positions from the FIFO. The mouse
+// wheel zooms around the pointer, double click shows everything again.
+class WaveformDisplay : public juce::Component, private juce::Timer
+{
+public:
+
+    // peakSource is polled every frame, so a newly loaded sample shows up on its own
+    WaveformDisplay(std::function<PeakPyramid::Ptr()> peakSource, GrainPositionFifo& grainPositions);
+    ~WaveformDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    void mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel) override;
+    void mouseDoubleClick(const juce::MouseEvent& event) override;
+
+private:
+
+    void timerCallback() override;
+    void updatePeaks();
+
+    std::function<PeakPyramid::Ptr()> peakSource;
+    GrainPositionFifo& grainPositions;
+
+    PeakPyramid::Ptr peaks;
+    double visibleStart = 0.0, visibleEnd = 0.0;
+    std::vector<PeakPyramid::Peak> pixelPeaks; // one per pixel column, redone only on zoom or resize
+    std::vector<int> grainMarks;               // what was pulled from the FIFO for this frame
+    std::vector<int> pulled;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformDisplay)
+};
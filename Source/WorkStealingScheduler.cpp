@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+    WorkStealingScheduler.cpp
+    Created: 23 Oct 2026 4:12:48pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#include "WorkStealingScheduler.h"
+
+namespace
+{
+    // Which scheduler and worker the calling thread belongs to, if any
+    thread_local const void* currentScheduler = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+class WorkStealingScheduler::Worker : public juce::Thread
+{
+public:
+
+    Worker(WorkStealingScheduler& owner, int workerIndex)
+        : juce::Thread("Work stealing worker " + juce::String(workerIndex)), scheduler(owner), index(workerIndex)
+    {
+    }
+
+    void run() override
+    {
+        currentScheduler = &scheduler;
+        currentWorker = index;
+        juce::Random random(index + 1);
+
+        while (! threadShouldExit())
+        {
+            //idle workers sleep until something is submitted, waking now and then to look for work to steal
+            if (! scheduler.runNextTask(index, random))
+                scheduler.workAvailable.wait(5);
+        }
+    }
+
+private:
+
+    WorkStealingScheduler& scheduler;
+    int index;
+};
+
+WorkStealingScheduler::WorkStealingScheduler(int numWorkers)
+{
+    if (numWorkers <= 0)
+        numWorkers = juce::SystemStats::getNumCpus();
+
+    for (int i = 0; i < numWorkers; i++)
+        queues.push_back(std::make_unique<Queue>());
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        workers.add(new Worker(*this, i));
+        workers.getLast()->startThread();
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+
+    workAvailable.signal();
+    for (auto* worker : workers)
+        worker->stopThread(-1);
+}
+
+void WorkStealingScheduler::submit(Task task)
+{
+    pendingTasks++;
+
+    //a running task keeps its children local, they are still warm in its cache
+    int queueIndex = currentScheduler == this ? currentWorker
+                                              : (int)(nextQueue++ % (unsigned int)queues.size());
+    auto& queue = *queues[(size_t)queueIndex];
+    {
+        const juce::SpinLock::ScopedLockType lock(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    workAvailable.signal();
+}
+
+void WorkStealingScheduler::waitUntilDone()
+{
+    while (pendingTasks.load() > 0)
+        allDone.wait(50);
+}
+
+bool WorkStealingScheduler::runNextTask(int workerIndex, juce::Random& random)
+{
+    Task task;
+    int numQueues = (int)queues.size();
+    int firstVictim = random.nextInt(numQueues);
+
+    for (int i = -1; i < numQueues && task == nullptr; i++)
+    {
+        //newest from the own queue, oldest from a victim's
+        bool own = i < 0;
+        int queueIndex = own ? workerIndex : (firstVictim + i) % numQueues;
+        if (! own && queueIndex == workerIndex)
+            continue;
+
+        auto& queue = *queues[(size_t)queueIndex];
+        const juce::SpinLock::ScopedLockType lock(queue.lock);
+        if (queue.tasks.empty())
+            continue;
+
+        if (own)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (task == nullptr)
+        return false;
+
+    //another sleeper may find more to steal while this one is busy
+    workAvailable.signal();
+    task();
+
+    if (--pendingTasks == 0)
+        allDone.signal();
+
+    return true;
+}
@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    WorkStealingScheduler.h
+    Created: 23 Oct 2026 4:12:48pm
+    Author:  Hanzhi Zhang / Zi Meng
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+
+// A fixed set of worker threads, each with its own task queue. A worker runs
+// the newest task of its own queue and, once that is empty, steals the oldest
+// task of another worker's, so one long job never leaves the other cores idle.
+// Tasks submitted from inside a task go onto the running worker's own queue.
+class WorkStealingScheduler
+{
+public:
+
+    using Task = std::function<void()>;
+
+    // numWorkers <= 0 uses one worker per core
+    explicit WorkStealingScheduler(int numWorkers = 0);
+    ~WorkStealingScheduler();
+
+    // Any thread, including a running task
+    void submit(Task task);
+
+    // Blocks until every submitted task, and everything those submitted, has run
+    void waitUntilDone();
+
+    int getNumWorkers() const noexcept { return (int)queues.size(); }
+
+private:
+
+    class Worker;
+
+    struct Queue
+    {
+        juce::SpinLock lock;
+        std::deque<Task> tasks;
+    };
+
+    // Own queue first, then the other queues starting from a random one; false if nothing was found
+    bool runNextTask(int workerIndex, juce::Random& random);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    juce::OwnedArray<Worker> workers;
+    std::atomic<int> pendingTasks { 0 };
+    std::atomic<unsigned int> nextQueue { 0 }; // round robin for tasks submitted from outside the workers
+    juce::WaitableEvent workAvailable, allDone;
+
+    JUCE_DECLARE_NON_COPYABLE (WorkStealingScheduler)
+};